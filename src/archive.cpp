@@ -0,0 +1,476 @@
+/**
+ * @file archive.cpp
+ * @brief 历史归档模块 - 列式探测历史存储与查询
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --archive 选项和 qping query 子命令，包括：
+ * - 按目标分列的内存编码（增量 varint 时间戳、varint RTT、成败位图）
+ * - 按 ARCHIVE_SEGMENT_MS 对齐切分的不可变分段文件
+ * - 分段尾部的目标块索引和归档目录中的分段时间索引
+ * - 按目标和时间范围读取记录，只访问相关分段中的单个数据块
+ */
+
+#include "qping.h"
+
+#include <ctime>
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/** @brief 分段文件头 magic */
+static const char SEGMENT_MAGIC[4] = {'Q', 'P', 'S', 'G'};
+
+/** @brief 分段块索引尾部 magic */
+static const char INDEX_MAGIC[4] = {'Q', 'P', 'I', 'X'};
+
+/** @brief 分段格式版本 */
+static const uint32_t SEGMENT_VERSION = 1;
+
+/** @brief 分段头部大小：magic、版本、起始、结束、目标数 */
+static const size_t SEGMENT_HEADER_SIZE = 4 + 4 + 8 + 8 + 4;
+
+/** @brief 分段尾部大小：块索引偏移、magic */
+static const size_t SEGMENT_FOOTER_SIZE = 8 + 4;
+
+/**
+ * @brief 以小端序追加整数
+ */
+static void put_le(std::string& buf, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        buf.push_back((char)(v >> (8 * i)));
+    }
+}
+
+/**
+ * @brief 读取小端序整数
+ */
+static uint64_t get_le(const unsigned char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+/**
+ * @brief 当前时刻（自 1970-01-01 起的毫秒数）
+ */
+static uint64_t archive_now_ms() {
+    return PcapWriter::now_ns() / 1000000;
+}
+
+/**
+ * @brief 拼接归档目录和文件名
+ */
+static std::string archive_path(const std::string& dir, const std::string& name) {
+    if (dir.empty()) {
+        return name;
+    }
+    char last = dir[dir.size() - 1];
+    return (last == '\\' || last == '/') ? dir + name : dir + "\\" + name;
+}
+
+//=============================================================================
+// 归档写入
+//=============================================================================
+
+/**
+ * @brief 打开（必要时创建）归档目录
+ */
+bool HistoryArchive::open(const std::string& dir, const std::vector<std::string>& targets) {
+    if (!CreateDirectoryA(dir.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        fprintf(stderr, "无法创建归档目录: %s\n", dir.c_str());
+        return false;
+    }
+
+    dir_ = dir;
+    targets_ = targets;
+    columns_.assign(targets.size(), Column());
+    segment_empty_ = true;
+    open_ = true;
+    return true;
+}
+
+/**
+ * @brief 写出当前分段并关闭归档
+ */
+void HistoryArchive::close() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!open_) {
+        return;
+    }
+    flush_segment();
+    open_ = false;
+}
+
+/**
+ * @brief 记录一次探测结果
+ *
+ * 时间戳在锁内读取，保证同一目标的记录按时间递增，增量编码不会出现
+ * 负数；系统时间回拨时沿用上一条记录的时间戳。跨过分段边界时先写出
+ * 当前分段。
+ */
+void HistoryArchive::record(size_t target, bool success, uint32_t rtt_us) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (!open_ || target >= columns_.size()) {
+        return;
+    }
+
+    uint64_t now = std::max(archive_now_ms(), segment_last_);
+    if (!segment_empty_ && now >= segment_start_ + ARCHIVE_SEGMENT_MS) {
+        flush_segment();
+    }
+    if (segment_empty_) {
+        segment_start_ = now - now % ARCHIVE_SEGMENT_MS;
+        segment_first_ = now;
+        segment_empty_ = false;
+    }
+    segment_last_ = now;
+
+    Column& c = columns_[target];
+    uint64_t prev = c.count ? c.last_ts : segment_start_;
+    if (c.count == 0) {
+        c.first_ts = now;
+    }
+    put_varint(c.ts, now - prev);
+    if ((c.count & 7) == 0) {
+        c.loss.push_back(0);
+    }
+    if (success) {
+        c.loss[c.loss.size() - 1] |= (char)(1 << (c.count & 7));
+        put_varint(c.rtt, rtt_us);
+    }
+    c.last_ts = now;
+    c.count++;
+    records_++;
+}
+
+/**
+ * @brief 把当前分段写成文件并追加到分段索引（调用方持有锁）
+ *
+ * 先写入临时文件再重命名，索引行在分段文件完整落盘后才追加，
+ * 因此中途退出不会留下被索引引用的残缺分段。
+ */
+bool HistoryArchive::flush_segment() {
+    if (segment_empty_) {
+        return true;
+    }
+
+    // 块索引按目标名排序，查询时二分查找
+    std::vector<size_t> order;
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        if (columns_[i].count > 0) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return targets_[a] < targets_[b];
+    });
+
+    std::string data;
+    data.append(SEGMENT_MAGIC, 4);
+    put_le(data, SEGMENT_VERSION, 4);
+    put_le(data, segment_start_, 8);
+    put_le(data, segment_last_, 8);
+    put_le(data, order.size(), 4);
+
+    std::string index;
+    for (size_t i : order) {
+        const Column& c = columns_[i];
+        const std::string& name = targets_[i];
+        put_le(index, name.size(), 2);
+        index.append(name);
+        put_le(index, c.first_ts, 8);
+        put_le(index, c.last_ts, 8);
+        put_le(index, c.count, 4);
+        put_le(index, data.size(), 8);
+        put_le(index, c.ts.size(), 4);
+        put_le(index, c.loss.size(), 4);
+        put_le(index, c.rtt.size(), 4);
+        data.append(c.ts);
+        data.append(c.loss);
+        data.append(c.rtt);
+    }
+    uint64_t index_offset = data.size();
+    data.append(index);
+    put_le(data, index_offset, 8);
+    data.append(INDEX_MAGIC, 4);
+
+    // 写入临时文件后重命名
+    char name[64];
+    snprintf(name, sizeof(name), "%llu-%lu-%llu.qseg", (unsigned long long)segment_first_,
+             (unsigned long)GetCurrentProcessId(), (unsigned long long)segments_);
+    std::string path = archive_path(dir_, name);
+    std::string tmp = path + ".tmp";
+
+    bool ok = false;
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (f) {
+        ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        ok = (fclose(f) == 0) && ok;
+    }
+    if (ok) {
+        ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    }
+    if (ok) {
+        FILE* idx = fopen(archive_path(dir_, ARCHIVE_INDEX_FILE).c_str(), "a");
+        ok = idx && fprintf(idx, "%llu %llu %s\n", (unsigned long long)segment_first_,
+                            (unsigned long long)segment_last_, name) > 0;
+        if (idx) {
+            ok = (fclose(idx) == 0) && ok;
+        }
+    }
+    if (!ok) {
+        fprintf(stderr, "写入归档分段失败: %s\n", path.c_str());
+    } else {
+        segments_++;
+    }
+
+    columns_.assign(columns_.size(), Column());
+    segment_empty_ = true;
+    return ok;
+}
+
+//=============================================================================
+// 归档查询
+//=============================================================================
+
+/**
+ * @brief 从一个分段中读取目标的记录
+ *
+ * 先读尾部得到块索引位置，读入块索引后二分查找目标名，
+ * 再只读取该目标的数据块并解码。
+ */
+static bool read_segment(const std::string& path, const std::string& target,
+                         uint64_t from_ms, uint64_t to_ms,
+                         std::vector<HistorySample>& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return false;
+    }
+
+    unsigned char header[SEGMENT_HEADER_SIZE];
+    unsigned char footer[SEGMENT_FOOTER_SIZE];
+    bool ok = fread(header, 1, sizeof(header), f) == sizeof(header) &&
+              memcmp(header, SEGMENT_MAGIC, 4) == 0 &&
+              get_le(header + 4, 4) == SEGMENT_VERSION &&
+              fseek(f, -(long)SEGMENT_FOOTER_SIZE, SEEK_END) == 0;
+    long footer_pos = ok ? ftell(f) : -1;
+    ok = ok && footer_pos > 0 &&
+         fread(footer, 1, sizeof(footer), f) == sizeof(footer) &&
+         memcmp(footer + 8, INDEX_MAGIC, 4) == 0;
+
+    uint64_t index_offset = ok ? get_le(footer, 8) : 0;
+    if (!ok || index_offset > (uint64_t)footer_pos) {
+        fclose(f);
+        return false;
+    }
+    uint64_t segment_start = get_le(header + 8, 8);
+    uint32_t target_count = (uint32_t)get_le(header + 24, 4);
+
+    std::vector<unsigned char> index((size_t)(footer_pos - index_offset));
+    ok = fseek(f, (long)index_offset, SEEK_SET) == 0 &&
+         fread(index.data(), 1, index.size(), f) == index.size();
+    if (!ok) {
+        fclose(f);
+        return false;
+    }
+
+    // 索引项为变长（目标名），先建立各项起始位置再二分查找
+    const size_t fixed = 8 + 8 + 4 + 8 + 4 + 4 + 4;
+    std::vector<size_t> entries;
+    entries.reserve(target_count);
+    size_t pos = 0;
+    for (uint32_t i = 0; i < target_count; ++i) {
+        if (pos + 2 > index.size()) {
+            fclose(f);
+            return false;
+        }
+        size_t len = (size_t)get_le(&index[pos], 2);
+        if (pos + 2 + len + fixed > index.size()) {
+            fclose(f);
+            return false;
+        }
+        entries.push_back(pos);
+        pos += 2 + len + fixed;
+    }
+    auto name_at = [&](size_t e) {
+        return std::string((const char*)&index[e + 2], (size_t)get_le(&index[e], 2));
+    };
+    auto it = std::lower_bound(entries.begin(), entries.end(), target,
+                               [&](size_t e, const std::string& t) { return name_at(e) < t; });
+    if (it == entries.end() || name_at(*it) != target) {
+        fclose(f);
+        return true;  // 该分段中没有此目标
+    }
+
+    const unsigned char* e = &index[*it + 2 + get_le(&index[*it], 2)];
+    uint64_t first_ts = get_le(e, 8);
+    uint64_t last_ts = get_le(e + 8, 8);
+    uint32_t count = (uint32_t)get_le(e + 16, 4);
+    uint64_t offset = get_le(e + 20, 8);
+    size_t ts_len = (size_t)get_le(e + 28, 4);
+    size_t loss_len = (size_t)get_le(e + 32, 4);
+    size_t rtt_len = (size_t)get_le(e + 36, 4);
+    if (last_ts < from_ms || first_ts > to_ms) {
+        fclose(f);
+        return true;
+    }
+
+    std::vector<unsigned char> block(ts_len + loss_len + rtt_len);
+    ok = offset + block.size() <= index_offset &&
+         fseek(f, (long)offset, SEEK_SET) == 0 &&
+         fread(block.data(), 1, block.size(), f) == block.size();
+    fclose(f);
+    if (!ok || loss_len < ((size_t)count + 7) / 8) {
+        return false;
+    }
+
+    // 按列解码
+    const unsigned char* ts = block.data();
+    const unsigned char* ts_end = ts + ts_len;
+    const unsigned char* loss = ts_end;
+    const unsigned char* rtt = loss + loss_len;
+    const unsigned char* rtt_end = rtt + rtt_len;
+    uint64_t t = segment_start;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t delta, r = 0;
+        if (!get_varint(ts, ts_end, delta)) {
+            return false;
+        }
+        t += delta;
+        bool success = (loss[i / 8] >> (i % 8)) & 1;
+        if (success && !get_varint(rtt, rtt_end, r)) {
+            return false;
+        }
+        if (t >= from_ms && t <= to_ms) {
+            HistorySample s;
+            s.timestamp_ms = t;
+            s.success = success;
+            s.rtt_us = (uint32_t)r;
+            out.push_back(s);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 从归档中读取一个目标在时间范围内的记录
+ */
+bool query_archive(const std::string& dir, const std::string& target,
+                   uint64_t from_ms, uint64_t to_ms,
+                   std::vector<HistorySample>& out, size_t& segments_read) {
+    segments_read = 0;
+    FILE* idx = fopen(archive_path(dir, ARCHIVE_INDEX_FILE).c_str(), "r");
+    if (!idx) {
+        fprintf(stderr, "无法读取归档索引: %s\n", archive_path(dir, ARCHIVE_INDEX_FILE).c_str());
+        return false;
+    }
+
+    // 分段索引：每行 "首条时刻 末条时刻 文件名"
+    struct Entry {
+        uint64_t first;
+        uint64_t last;
+        std::string name;
+    };
+    std::vector<Entry> selected;
+    char line[256];
+    while (fgets(line, sizeof(line), idx)) {
+        unsigned long long first, last;
+        char name[200];
+        if (sscanf(line, "%llu %llu %199s", &first, &last, name) != 3) {
+            continue;
+        }
+        if (last >= from_ms && first <= to_ms) {
+            selected.push_back(Entry{first, last, name});
+        }
+    }
+    fclose(idx);
+
+    std::sort(selected.begin(), selected.end(), [](const Entry& a, const Entry& b) {
+        return a.first < b.first;
+    });
+
+    size_t before = out.size();
+    for (const auto& seg : selected) {
+        if (!read_segment(archive_path(dir, seg.name), target, from_ms, to_ms, out)) {
+            fprintf(stderr, "跳过损坏的归档分段: %s\n", seg.name.c_str());
+            continue;
+        }
+        segments_read++;
+    }
+
+    // 多个进程同时归档时分段的时间范围可能重叠
+    std::stable_sort(out.begin() + before, out.end(),
+                     [](const HistorySample& a, const HistorySample& b) {
+                         return a.timestamp_ms < b.timestamp_ms;
+                     });
+    return true;
+}
+
+//=============================================================================
+// 时间格式
+//=============================================================================
+
+/**
+ * @brief 解析查询时间参数
+ */
+bool parse_time_arg(const std::string& s, uint64_t& ms) {
+    bool digits = !s.empty();
+    for (char c : s) {
+        if (c < '0' || c > '9') {
+            digits = false;
+            break;
+        }
+    }
+    if (digits) {
+        ms = strtoull(s.c_str(), nullptr, 10) * 1000;
+        return true;
+    }
+
+    int year, mon, day, hour = 0, min = 0, sec = 0;
+    char sep = ' ';
+    int n = sscanf(s.c_str(), "%d-%d-%d%c%d:%d:%d", &year, &mon, &day, &sep, &hour, &min, &sec);
+    if (n != 3 && n != 6 && n != 7) {
+        return false;
+    }
+    if (n > 3 && sep != ' ' && sep != 'T') {
+        return false;
+    }
+
+    struct tm tmv = {};
+    tmv.tm_year = year - 1900;
+    tmv.tm_mon = mon - 1;
+    tmv.tm_mday = day;
+    tmv.tm_hour = hour;
+    tmv.tm_min = min;
+    tmv.tm_sec = sec;
+    tmv.tm_isdst = -1;
+    time_t t = mktime(&tmv);
+    if (t == (time_t)-1) {
+        return false;
+    }
+    ms = (uint64_t)t * 1000;
+    return true;
+}
+
+/**
+ * @brief 将毫秒时间戳格式化为本地时间
+ */
+std::string format_time_ms(uint64_t ms) {
+    time_t t = (time_t)(ms / 1000);
+    struct tm tmv;
+    localtime_s(&tmv, &t);
+    char buf[32];
+    size_t n = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tmv);
+    snprintf(buf + n, sizeof(buf) - n, ".%03u", (unsigned)(ms % 1000));
+    return buf;
+}
+
+} // namespace qping
@@ -0,0 +1,152 @@
+/**
+ * @file cache.cpp
+ * @brief 存活缓存模块 - 跨运行复用最近的探测结论
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --cache 和 --max-age 选项，包括：
+ * - 地址到最近一次结论（是否在线）和探测时刻的持久化映射
+ * - 按新鲜度查询，只有过期的目标需要重新探测
+ * - 结束时合并本次结果并原子地替换缓存文件
+ *
+ * 每隔几分钟对大量重叠的范围询问“哪些主机在线”时，大部分目标可以直接
+ * 使用缓存结论，只发送一小部分数据包。
+ */
+
+#include "qping.h"
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/**
+ * @struct LivenessFileHeader
+ * @brief 缓存文件头部，其后是 count 条变长记录：
+ *        uint64 探测时刻、uint8 是否在线、uint8 地址长度、地址文本
+ */
+struct LivenessFileHeader {
+    uint32_t magic;                          ///< LIVENESS_MAGIC
+    uint32_t version;                        ///< LIVENESS_VERSION
+    uint64_t count;                          ///< 记录数
+};
+
+/** @brief 每条记录的定长部分（字节） */
+static const size_t LIVENESS_RECORD_FIXED = 10;
+
+//=============================================================================
+// 公共接口
+//=============================================================================
+
+/**
+ * @brief 读取缓存文件
+ *
+ * 文件整体读入后逐条解析；任何一条越界都视为损坏，不使用部分内容。
+ */
+bool LivenessCache::load(const std::string& path) {
+    path_ = path;
+    entries_.clear();
+
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        return true;
+    }
+    std::vector<char> data;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    LivenessFileHeader header;
+    bool ok = data.size() >= sizeof(header);
+    if (ok) {
+        memcpy(&header, data.data(), sizeof(header));
+        ok = header.magic == LIVENESS_MAGIC && header.version == LIVENESS_VERSION;
+    }
+    size_t pos = sizeof(header);
+    if (ok) {
+        entries_.reserve((size_t)std::min<uint64_t>(header.count, data.size() / LIVENESS_RECORD_FIXED));
+    }
+    for (uint64_t i = 0; ok && i < header.count; ++i) {
+        if (data.size() - pos < LIVENESS_RECORD_FIXED) {
+            ok = false;
+            break;
+        }
+        LivenessEntry entry;
+        memcpy(&entry.time_ms, &data[pos], 8);
+        entry.alive = data[pos + 8] != 0;
+        size_t len = (unsigned char)data[pos + 9];
+        pos += LIVENESS_RECORD_FIXED;
+        if (data.size() - pos < len) {
+            ok = false;
+            break;
+        }
+        entries_[std::string(&data[pos], len)] = entry;
+        pos += len;
+    }
+    if (!ok) {
+        fprintf(stderr, "存活缓存格式无效: %s\n", path.c_str());
+        entries_.clear();
+    }
+    return ok;
+}
+
+/**
+ * @brief 查询不早于 min_time_ms 的缓存结论
+ */
+bool LivenessCache::lookup(const std::string& addr, uint64_t min_time_ms, LivenessEntry& entry) const {
+    auto it = entries_.find(addr);
+    if (it == entries_.end() || it->second.time_ms < min_time_ms) {
+        return false;
+    }
+    entry = it->second;
+    return true;
+}
+
+/**
+ * @brief 记录一个地址的最新结论
+ */
+void LivenessCache::update(const std::string& addr, bool alive, uint64_t time_ms) {
+    LivenessEntry& entry = entries_[addr];
+    entry.time_ms = time_ms;
+    entry.alive = alive;
+}
+
+/**
+ * @brief 写回缓存文件
+ *
+ * 超过 LIVENESS_RETAIN_MS 的条目不再写出，缓存大小随常用范围而不是
+ * 历史上探测过的全部地址增长。
+ */
+bool LivenessCache::save(uint64_t now_ms) {
+    const uint64_t min_time = (now_ms > LIVENESS_RETAIN_MS) ? now_ms - LIVENESS_RETAIN_MS : 0;
+    std::string data(sizeof(LivenessFileHeader), '\0');
+    uint64_t count = 0;
+    for (const auto& kv : entries_) {
+        if (kv.second.time_ms < min_time || kv.first.size() > 255) {
+            continue;
+        }
+        char fixed[LIVENESS_RECORD_FIXED];
+        memcpy(fixed, &kv.second.time_ms, 8);
+        fixed[8] = kv.second.alive ? 1 : 0;
+        fixed[9] = (char)kv.first.size();
+        data.append(fixed, sizeof(fixed));
+        data += kv.first;
+        count++;
+    }
+    LivenessFileHeader header = {LIVENESS_MAGIC, LIVENESS_VERSION, count};
+    memcpy(&data[0], &header, sizeof(header));
+
+    if (!atomic_write_file(path_, data)) {
+        fprintf(stderr, "无法写入存活缓存: %s\n", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace qping
@@ -0,0 +1,164 @@
+/**
+ * @file clock.cpp
+ * @brief 时钟模块 - 基于 TSC 的低开销探测时间戳
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了探测引擎使用的时间戳时钟，包括：
+ * - 通过 CPUID 检测不变 TSC（频率恒定、不随节能状态停止）
+ * - 启动时以两个连续窗口针对 QueryPerformanceCounter 校准并检验一致性
+ * - 运行中按固定周期以更长的基线重新校准换算系数
+ * - TSC 不可用或校准不一致时退回 QueryPerformanceCounter
+ *
+ * 读取 TSC 只需一条指令，QueryPerformanceCounter 在部分虚拟化环境下
+ * 需要陷入内核；每个探测至少读取两次时钟，高速率时差别明显。
+ */
+
+#include "qping.h"
+#include <cmath>
+
+namespace qping {
+
+bool FastClock::tsc_ = false;
+std::atomic<double> FastClock::ns_per_tick_{1.0};
+uint64_t FastClock::frequency_ = 1;
+uint64_t FastClock::qpc_freq_ = 1;
+uint64_t FastClock::anchor_tsc_ = 0;
+uint64_t FastClock::anchor_qpc_ = 0;
+std::atomic<uint64_t> FastClock::next_calibration_{UINT64_MAX};
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/**
+ * @brief CPU 是否支持不变 TSC（CPUID 0x80000007 EDX 第 8 位），非 x86 架构恒为 false
+ */
+static bool has_invariant_tsc() {
+#if !QPING_HAS_TSC
+    return false;
+#else
+    int info[4] = {};
+    __cpuid(info, 0x80000000);
+    if ((unsigned)info[0] < 0x80000007u) {
+        return false;
+    }
+    __cpuid(info, 0x80000007);
+    return (info[3] & (1 << 8)) != 0;
+#endif
+}
+
+/**
+ * @brief 读取性能计数器
+ */
+uint64_t FastClock::qpc() {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)now.QuadPart;
+}
+
+/**
+ * @brief 读取一对同时刻的 TSC 和性能计数器值
+ *
+ * 用两次 TSC 读数夹住一次性能计数器读数，取间隔最短的一次并以中点作为
+ * 对应的 TSC 值，减小读取本身带来的偏差。
+ */
+void FastClock::read_pair(uint64_t& tsc, uint64_t& qpc_value) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < CLOCK_PAIR_TRIES; ++i) {
+        uint64_t a = read_tsc();
+        uint64_t q = qpc();
+        uint64_t b = read_tsc();
+        if (b >= a && b - a < best) {
+            best = b - a;
+            tsc = a + (b - a) / 2;
+            qpc_value = q;
+        }
+    }
+}
+
+/**
+ * @brief 两对读数之间每个 TSC 计数对应的纳秒数
+ */
+double FastClock::rate_between(uint64_t tsc0, uint64_t qpc0, uint64_t tsc1, uint64_t qpc1) {
+    if (tsc1 <= tsc0 || qpc1 <= qpc0) {
+        return 0;
+    }
+    return (double)(qpc1 - qpc0) * 1e9 / (double)qpc_freq_ / (double)(tsc1 - tsc0);
+}
+
+//=============================================================================
+// 公共接口
+//=============================================================================
+
+/**
+ * @brief 检测并校准时钟（只执行一次）
+ *
+ * 连续两个 CLOCK_CALIBRATE_MS 窗口各自得到的 TSC 速率相差超过
+ * CLOCK_TSC_MAX_DRIFT 时认为 TSC 不可靠；采用时使用两个窗口合计的
+ * 基线作为初始换算系数。
+ */
+void FastClock::init() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        LARGE_INTEGER freq;
+        QueryPerformanceFrequency(&freq);
+        qpc_freq_ = (uint64_t)freq.QuadPart;
+        frequency_ = qpc_freq_;
+        ns_per_tick_.store(1e9 / (double)qpc_freq_);
+
+        if (!has_invariant_tsc()) {
+            return;
+        }
+
+        uint64_t t0 = 0, q0 = 0, t1 = 0, q1 = 0, t2 = 0, q2 = 0;
+        read_pair(t0, q0);
+        Sleep(CLOCK_CALIBRATE_MS);
+        read_pair(t1, q1);
+        Sleep(CLOCK_CALIBRATE_MS);
+        read_pair(t2, q2);
+
+        double r1 = rate_between(t0, q0, t1, q1);
+        double r2 = rate_between(t1, q1, t2, q2);
+        if (r1 <= 0 || r2 <= 0 || std::fabs(r1 - r2) / r1 > CLOCK_TSC_MAX_DRIFT) {
+            return;
+        }
+
+        double rate = rate_between(t0, q0, t2, q2);
+        anchor_tsc_ = t0;
+        anchor_qpc_ = q0;
+        ns_per_tick_.store(rate);
+        frequency_ = (uint64_t)(1e9 / rate);
+        next_calibration_.store(t2 + (uint64_t)((double)CLOCK_RECALIBRATE_MS * 1e6 / rate));
+        tsc_ = true;
+    });
+}
+
+/**
+ * @brief 到期时重新校准换算系数
+ *
+ * 基线从启动时的锚点一直延伸到当前时刻，越往后精度越高。多个线程同时
+ * 到期时只有成功推进下一次校准时刻的线程执行校准。
+ */
+void FastClock::maybe_recalibrate(uint64_t now_ticks) {
+    uint64_t due = next_calibration_.load(std::memory_order_relaxed);
+    if (now_ticks < due) {
+        return;
+    }
+    double rate = ns_per_tick_.load(std::memory_order_relaxed);
+    uint64_t next = now_ticks + (uint64_t)((double)CLOCK_RECALIBRATE_MS * 1e6 / rate);
+    if (!next_calibration_.compare_exchange_strong(due, next)) {
+        return;
+    }
+
+    uint64_t t = 0, q = 0;
+    read_pair(t, q);
+    double updated = rate_between(anchor_tsc_, anchor_qpc_, t, q);
+    if (updated > 0) {
+        ns_per_tick_.store(updated, std::memory_order_relaxed);
+    }
+}
+
+} // namespace qping
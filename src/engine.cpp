@@ -0,0 +1,1773 @@
+/**
+ * @file engine.cpp
+ * @brief 探测引擎模块 - 每目标多在途探测的异步调度
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --window 模式使用的探测引擎，包括：
+ * - 基于 IcmpSendEcho2 / Icmp6SendEcho2 事件通知的异步请求
+ * - 每目标最多 window 个在途探测，按序列号区分
+ * - 按 --interval 控制同一目标的发送节奏
+ * - 迟到回复（超过 -w 但在宽限期内到达）的单独统计
+ * - --flood 使用的全局令牌桶限速和分级递增速率
+ * - --size-sweep 使用的按发送次序轮换的负载大小
+ * - --cpus 线程绑核和 --scaling 多核扩展性测试
+ * - --busy-poll 忙轮询完成事件和 --rtt-floor 本机 RTT 下限测量
+ * - 以 FastClock 原始计数记录发送和完成时刻，完成时才换算为微秒
+ * - --send-timing 将实测时间分解为发送延迟和网络往返
+ * - --simulate-ecmp 在发送路径上模拟按负载散列的负载均衡和一条故障链路
+ *
+ * 与传统工作线程模型（每线程一个同步请求）相比，单个线程即可维持
+ * 数十个在途探测，使高频采样不再受限于 RTT。
+ */
+
+#include "qping.h"
+#include <cmath>
+
+namespace qping {
+
+//=============================================================================
+// 速率计划
+//=============================================================================
+
+/**
+ * @brief 计算引擎启动后指定时刻的目标发送速率
+ *
+ * 启用递增时第 k 级（从 0 开始）的速率为 rate_pps × (k + 1) / ramp_steps，
+ * 超过最后一级后保持上限。
+ */
+int engine_rate_at(const EngineConfig& config, uint64_t elapsed_ms) {
+    if (config.rate_pps <= 0) {
+        return 0;
+    }
+    if (config.ramp_steps <= 1 || config.step_ms <= 0) {
+        return config.rate_pps;
+    }
+    uint64_t step = elapsed_ms / (uint64_t)config.step_ms;
+    if (step + 1 >= (uint64_t)config.ramp_steps) {
+        return config.rate_pps;
+    }
+    return std::max(1, (int)((uint64_t)config.rate_pps * (step + 1) / config.ramp_steps));
+}
+
+/**
+ * @brief 把一次成功回复计入目标统计
+ *
+ * 超过 -w 才到达的回复计为迟到，不计入接收。
+ */
+bool record_reply(TargetStat& stat, uint64_t elapsed_us, int timeout_ms) {
+    if (elapsed_us > (uint64_t)timeout_ms * 1000) {
+        stat.late.fetch_add(1);
+        return true;
+    }
+    stat.recv.fetch_add(1);
+    return false;
+}
+
+//=============================================================================
+// 构造与启动
+//=============================================================================
+
+/**
+ * @brief 构造函数
+ *
+ * 预先解析所有目标地址并生成共享的负载数据，探测路径上不再进行
+ * 字符串解析和内存分配。
+ */
+ProbeEngine::ProbeEngine(const std::vector<std::string>& targets,
+                         std::vector<TargetStat>& stats,
+                         const PingOptions& opts,
+                         const EngineConfig& config)
+    : targets_(targets), stats_(stats), opts_(opts), config_(config), retired_(targets.size()) {
+
+    state_.resize(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        TargetState& t = state_[i];
+        t.af = get_address_family(targets[i]);
+        if (t.af == AF_INET) {
+            InetPtonA(AF_INET, targets[i].c_str(), &t.addr4);
+        } else if (t.af == AF_INET6) {
+            t.addr6.sin6_family = AF_INET6;
+            InetPtonA(AF_INET6, targets[i].c_str(), &t.addr6.sin6_addr);
+        }
+    }
+
+    // 所有大小共用一份按最大大小生成的负载，发送时取前缀
+    int max_payload = opts.payload_size;
+    for (int size : config.payload_sizes) {
+        max_payload = std::max(max_payload, size);
+    }
+    // 每个流一份负载，开头两个字节为流序号，使按负载散列的负载均衡区分各流
+    payload_stride_ = (size_t)max_payload;
+    std::vector<char> base = build_payload(max_payload);
+    int flows = std::max(1, config.flows);
+    for (int f = 0; f < flows; ++f) {
+        if (flows > 1 && max_payload >= FLOW_KEY_BYTES) {
+            base[0] = (char)(f >> 8);
+            base[1] = (char)f;
+        }
+        payload_.insert(payload_.end(), base.begin(), base.end());
+    }
+
+    // IPv6 源地址：指定且有效时使用，否则由系统选择
+    source6_.sin6_family = AF_INET6;
+    if (opts.source_address.empty() ||
+        InetPtonA(AF_INET6, opts.source_address.c_str(), &source6_.sin6_addr) != 1) {
+        source6_.sin6_addr = in6addr_any;
+    }
+
+    FastClock::init();
+    freq_ = (LONGLONG)FastClock::frequency();
+
+    // 前缀限速：只为实际出现的前缀建立令牌桶；目标按地址有序时相邻目标
+    // 通常属于同一前缀，直接沿用上一个桶序号
+    if (config.prefix_rate_pps > 0) {
+        std::unordered_map<uint64_t, uint32_t> ids4, ids6;
+        uint32_t mask4 = (config.prefix_len <= 0) ? 0 : 0xFFFFFFFFu << (32 - std::min(32, config.prefix_len));
+        uint64_t last_key = UINT64_MAX;
+        uint32_t last_id = 0, next_id = 0;
+        bool last_v6 = false;
+        prefix_of_.resize(targets.size());
+        for (size_t i = 0; i < targets.size(); ++i) {
+            const TargetState& t = state_[i];
+            uint64_t key = 0;
+            bool v6 = t.af == AF_INET6;
+            if (v6) {
+                memcpy(&key, &t.addr6.sin6_addr, PREFIX_IPV6_LEN / 8);
+            } else {
+                key = ntohl(t.addr4.S_un.S_addr) & mask4;
+            }
+            if (key != last_key || v6 != last_v6) {
+                auto ins = (v6 ? ids6 : ids4).emplace(key, next_id);
+                next_id += ins.second ? 1 : 0;
+                last_key = key;
+                last_v6 = v6;
+                last_id = ins.first->second;
+            }
+            prefix_of_[i] = last_id;
+        }
+        std::vector<std::atomic<LONGLONG>>(next_id).swap(prefix_tat_);
+        prefix_interval_ = std::max<LONGLONG>(1, freq_ / config.prefix_rate_pps);
+    }
+}
+
+/**
+ * @brief 读取引擎时钟（TSC 或性能计数器的原始计数）
+ */
+LONGLONG ProbeEngine::ticks_now() const {
+    return (LONGLONG)FastClock::now();
+}
+
+/**
+ * @brief 启动引擎线程
+ *
+ * 在途探测总数取 min(目标数 × window, max(concurrency, window))，
+ * 按每线程 ENGINE_SLOTS_PER_THREAD 个槽位划分线程数。指定了 threads 时
+ * 使用该线程数，指定了 cpus 时线程数至少为 CPU 数，使每个核心都有
+ * 一个线程；线程数不超过目标数。
+ * 发送间隔小于系统默认定时器精度时临时将其提高到 1ms。
+ */
+bool ProbeEngine::start(std::atomic<bool>& stop_flag) {
+    if (!build_ip_options(opts_, options_buffer_, ipopt_)) {
+        return false;
+    }
+    stop_ = &stop_flag;
+
+    size_t n = targets_.size();
+    size_t window = (size_t)std::max(1, config_.window);
+    size_t cap = (size_t)std::max(config_.max_in_flight, config_.window);
+    size_t total_slots = std::max<size_t>(1, std::min(n * window, cap));
+    size_t thread_count = (total_slots + ENGINE_SLOTS_PER_THREAD - 1) / ENGINE_SLOTS_PER_THREAD;
+    if (config_.threads > 0) {
+        thread_count = (size_t)config_.threads;
+    } else {
+        thread_count = std::max(thread_count, config_.cpus.size());
+    }
+    thread_count = std::min(thread_count, std::max<size_t>(1, n));
+    size_t slots_per_thread = (total_slots + thread_count - 1) / thread_count;
+    slots_per_thread = std::min<size_t>(slots_per_thread, ENGINE_SLOTS_PER_THREAD);
+
+    if (config_.interval_ms < 16) {
+        timer_period_set_ = (timeBeginPeriod(1) == TIMERR_NOERROR);
+    }
+
+    start_ticks_ = ticks_now();
+    active_.store(thread_count);
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back(&ProbeEngine::worker, this, i, thread_count, slots_per_thread);
+    }
+    return true;
+}
+
+/**
+ * @brief 等待所有引擎线程结束
+ */
+void ProbeEngine::join() {
+    for (auto& th : threads_) {
+        if (th.joinable()) {
+            th.join();
+        }
+    }
+    threads_.clear();
+
+    if (timer_period_set_) {
+        timeEndPeriod(1);
+        timer_period_set_ = false;
+    }
+}
+
+//=============================================================================
+// 发送与完成
+//=============================================================================
+
+/**
+ * @brief 从目标所属前缀的令牌桶取一个令牌
+ *
+ * 以 GCRA 形式实现令牌桶：每个桶只保存一个理论到达时刻，取令牌即
+ * 用 CAS 将其推后一个发送间隔，不需要加锁；同一前缀的目标可能分属
+ * 两个线程，CAS 失败时重试。桶中令牌不足时返回 false，并给出可以
+ * 再次尝试的时刻。
+ */
+bool ProbeEngine::take_prefix(size_t idx, LONGLONG now, LONGLONG& retry_at) {
+    std::atomic<LONGLONG>& tat = prefix_tat_[prefix_of_[idx]];
+    const LONGLONG tolerance = prefix_interval_ * (PREFIX_BURST - 1);
+    LONGLONG current = tat.load(std::memory_order_relaxed);
+    for (;;) {
+        LONGLONG base = std::max(current, now);
+        if (base - now > tolerance) {
+            retry_at = base - tolerance;
+            return false;
+        }
+        if (tat.compare_exchange_weak(current, base + prefix_interval_, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief 模拟按负载散列的负载均衡器是否丢弃该探测（--simulate-ecmp）
+ *
+ * 对目标地址和实际发送的负载做 FNV-1a 散列，按路径数取模选出成员链路，
+ * 与按负载散列的设备一样只看报文内容，因此负载相同的探测总是走同一路径。
+ * 落在故障路径上的探测再按目标、序列号散列决定是否丢弃，结果可复现，
+ * 不需要线程间共享随机数状态。
+ */
+bool ProbeEngine::ecmp_drops(const TargetState& t, const char* payload, const Slot& slot) const {
+    uint64_t h = 0xCBF29CE484222325ull;
+    auto feed = [&h](const void* data, size_t len) {
+        const unsigned char* p = (const unsigned char*)data;
+        for (size_t i = 0; i < len; ++i) {
+            h = (h ^ p[i]) * 0x100000001B3ull;
+        }
+    };
+    if (t.af == AF_INET6) {
+        feed(&t.addr6.sin6_addr, sizeof(t.addr6.sin6_addr));
+    } else {
+        feed(&t.addr4, sizeof(t.addr4));
+    }
+    feed(payload, (size_t)slot.payload_size);
+    if ((int)(h % (uint64_t)config_.ecmp_paths) != config_.ecmp_bad_path) {
+        return false;
+    }
+    uint64_t x = h ^ ((uint64_t)slot.target << 16) ^ slot.seq;
+    x = (x ^ (x >> 31)) * 0x7FB5D329728EA185ull;
+    x = (x ^ (x >> 27)) * 0x81DADEF4BC2DD44Dull;
+    x ^= x >> 33;
+    return (int)(x % 100) < config_.ecmp_loss_pct;
+}
+
+/**
+ * @brief 使用空闲槽位向目标发送一个异步 Echo 请求
+ *
+ * 请求立即返回，完成（回复、超时或错误）时槽位事件被触发。
+ * 若 API 直接返回错误，则标记槽位失败并手动触发事件，统一走完成路径。
+ * 金丝雀探测不计入发送次数，也不推进目标的发送节奏。
+ */
+void ProbeEngine::issue(HANDLE h4, HANDLE h6, Slot& slot, size_t idx, LONGLONG now) {
+    TargetState& t = state_[idx];
+    LONGLONG interval = config_.interval_ms * freq_ / 1000;
+
+    slot.target = idx;
+    slot.queued_at = now;
+    slot.seq = t.next_seq++;
+    slot.failed = false;
+    // 扫描模式下同一目标依次轮换各个大小，使不同大小的探测交错进行
+    const std::vector<int>& sizes = config_.payload_sizes;
+    slot.payload_size = sizes.empty() ? opts_.payload_size : sizes[t.issued % sizes.size()];
+    // 流在每轮大小之后轮换，使每个大小都经过所有流
+    uint64_t round = sizes.empty() ? t.issued : t.issued / sizes.size();
+    slot.flow = (int)(round % (uint64_t)std::max(1, config_.flows));
+    const char* payload = payload_.data() + (size_t)slot.flow * payload_stride_;
+    t.in_flight++;
+    if (!slot.canary) {
+        t.issued++;
+        // 按固定节奏推进；落后时从当前时刻重新开始，避免突发补发
+        t.next_due = std::max(t.next_due + interval, now);
+        stats_[idx].sent.fetch_add(1);
+    }
+
+    DWORD api_timeout = (DWORD)opts_.timeout_ms * (config_.track_late ? LATE_REPLY_GRACE_FACTOR : 1);
+    IP_OPTION_INFORMATION ipopt = ipopt_;
+    DWORD ret;
+
+    if (opts_.pcap) {
+        IN_ADDR local = {};
+        const void* src = (t.af == AF_INET6) ? (const void*)&source6_.sin6_addr : (const void*)&local;
+        const void* dst = (t.af == AF_INET6) ? (const void*)&t.addr6.sin6_addr : (const void*)&t.addr4;
+        opts_.pcap->record_echo(t.af, false, src, dst, slot.seq, opts_.ttl, opts_.tos,
+                                payload, (size_t)slot.payload_size,
+                                ipopt.OptionsData, ipopt.OptionsSize,
+                                PcapWriter::now_ns());
+    }
+
+    slot.sent_at = ticks_now();
+    if (config_.ecmp_paths > 0 && ecmp_drops(t, payload, slot)) {
+        // 模拟的故障成员链路丢弃了该探测：不调用发送 API，直接按失败完成
+        slot.handed_at = slot.sent_at;
+        slot.failed = true;
+        SetEvent(slot.event);
+        return;
+    }
+    if (t.af == AF_INET6) {
+        ret = Icmp6SendEcho2(h6, slot.event, nullptr, nullptr,
+                             &source6_, &t.addr6,
+                             (LPVOID)payload, (WORD)slot.payload_size, &ipopt,
+                             slot.reply.data(), (DWORD)slot.reply.size(), api_timeout);
+    } else {
+        ret = IcmpSendEcho2(h4, slot.event, nullptr, nullptr,
+                            t.addr4.S_un.S_addr,
+                            (LPVOID)payload, (WORD)slot.payload_size, &ipopt,
+                            slot.reply.data(), (DWORD)slot.reply.size(), api_timeout);
+    }
+    slot.handed_at = ticks_now();
+
+    if (ret == 0 && GetLastError() != ERROR_IO_PENDING) {
+        slot.failed = true;
+        SetEvent(slot.event);
+    } else if (ret != 0) {
+        // 已同步完成，确保完成路径被触发
+        SetEvent(slot.event);
+    }
+}
+
+/**
+ * @brief 处理已完成的槽位：解析回复、分类迟到、更新统计并回调
+ *
+ * 已取消的探测撤销其发送计数，不计入丢失，也不产生回调。金丝雀探测
+ * 直接交给速率控制器，不计入统计，也不产生回调。
+ *
+ * @return 是否按时收到回复（金丝雀和已取消的探测返回 false）
+ */
+bool ProbeEngine::complete(Slot& slot, bool cancelled) {
+    TargetState& t = state_[slot.target];
+    t.in_flight--;
+    if (aimd_) {
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (cancelled) {
+        if (!slot.canary) {
+            stats_[slot.target].sent.fetch_sub(1);
+        }
+        return false;
+    }
+
+    ProbeEvent ev;
+    ev.target = slot.target;
+    ev.seq = slot.seq;
+    LONGLONG done = ticks_now();
+    ev.elapsed_us = FastClock::to_us((uint64_t)(done - slot.sent_at));
+    ev.sent_us = FastClock::to_us((uint64_t)(slot.sent_at - start_ticks_));
+    ev.send_delay_us = FastClock::to_us((uint64_t)(slot.handed_at - slot.queued_at));
+    ev.wire_us = FastClock::to_us((uint64_t)(done - slot.handed_at));
+    ev.payload_size = slot.payload_size;
+    ev.flow = slot.flow;
+
+    if (!slot.failed && t.af == AF_INET6) {
+        if (Icmp6ParseReplies(slot.reply.data(), (DWORD)slot.reply.size()) > 0) {
+            PICMPV6_ECHO_REPLY reply = (PICMPV6_ECHO_REPLY)slot.reply.data();
+            if (reply->Status == IP_SUCCESS) {
+                ev.result.success = true;
+                ev.result.rtt_ms = reply->RoundTripTime;
+                ev.result.reply_ttl = (DWORD)opts_.ttl;
+                // ICMPv6 接口每个请求只返回一个回复
+                if (config_.max_replies > 1) {
+                    char buf[INET6_ADDRSTRLEN];
+                    InetNtopA(AF_INET6, &reply->Address.sin6_addr, buf, sizeof(buf));
+                    ReplySource source;
+                    source.addr = buf;
+                    source.rtt_ms = reply->RoundTripTime;
+                    ev.sources.push_back(source);
+                }
+                if (opts_.pcap) {
+                    opts_.pcap->record_echo(AF_INET6, true, reply->Address.sin6_addr,
+                                            &source6_.sin6_addr, slot.seq, opts_.ttl, 0,
+                                            slot.reply.data() + sizeof(ICMPV6_ECHO_REPLY),
+                                            (size_t)slot.payload_size, nullptr, 0,
+                                            PcapWriter::now_ns());
+                }
+            }
+        }
+    } else if (!slot.failed) {
+        DWORD count = IcmpParseReplies(slot.reply.data(), (DWORD)slot.reply.size());
+        if (count > 0) {
+            PICMP_ECHO_REPLY reply = (PICMP_ECHO_REPLY)slot.reply.data();
+            // 广播目标：回复缓冲区中依次是各个回复源的 ICMP_ECHO_REPLY
+            if (config_.max_replies > 1) {
+                for (DWORD i = 0; i < count; ++i) {
+                    if (reply[i].Status == IP_SUCCESS) {
+                        char buf[INET_ADDRSTRLEN];
+                        InetNtopA(AF_INET, &reply[i].Address, buf, sizeof(buf));
+                        ReplySource source;
+                        source.addr = buf;
+                        source.rtt_ms = reply[i].RoundTripTime;
+                        ev.sources.push_back(source);
+                    }
+                }
+            }
+            if (reply->Status == IP_SUCCESS) {
+                ev.result.success = true;
+                ev.result.rtt_ms = reply->RoundTripTime;
+                ev.result.reply_ttl = reply->Options.Ttl;
+                if (reply->Options.OptionsSize > 0 && reply->Options.OptionsData) {
+                    parse_reply_options(reply->Options.OptionsData,
+                                        reply->Options.OptionsSize, opts_, ev.result);
+                }
+                if (opts_.pcap) {
+                    IN_ADDR local = {};
+                    opts_.pcap->record_echo(AF_INET, true, &reply->Address, &local, slot.seq,
+                                            reply->Options.Ttl, reply->Options.Tos,
+                                            reply->Data, reply->DataSize,
+                                            reply->Options.OptionsData,
+                                            reply->Options.OptionsSize,
+                                            PcapWriter::now_ns());
+                }
+            }
+        }
+    }
+
+    if (slot.canary) {
+        ev.late = ev.result.success && ev.elapsed_us > (uint64_t)opts_.timeout_ms * 1000;
+        aimd_->record(ev);
+        return false;
+    }
+    if (ev.result.success) {
+        ev.late = record_reply(stats_[slot.target], ev.elapsed_us, opts_.timeout_ms);
+    }
+
+    if (callback_) {
+        callback_(ev);
+    }
+    return ev.result.success && !ev.late;
+}
+
+//=============================================================================
+// 引擎线程
+//=============================================================================
+
+/**
+ * @brief 引擎线程主循环
+ *
+ * 每轮先从就绪队列（按到期时刻排列的最小堆）取出到期的目标发送请求，
+ * 槽位或令牌用尽即停止；窗口已满的目标不在队列中，完成时才重新入队，
+ * 每轮的开销只与到期目标数有关，与本线程负责的目标总数无关。随后等待
+ * 任一槽位完成或下一个发送时刻到来，醒来后一次收回所有已完成的槽位。
+ * 收到停止标志后不再发送，但会等待所有在途探测完成，保证丢失和迟到
+ * 统计准确；设置了 cancel_on_stop 时改为关闭 ICMP
+ * 句柄取消在途请求，被取消的探测不计入统计。
+ *
+ * 设置了 rate_pps 时，线程按 1/thread_count 的份额维护令牌桶，每轮把
+ * 已积累的令牌一次性用于批量发送；超过 duration_ms 后停止发送。
+ * 设置了速率控制器时，速率每轮从控制器读取，同样按线程平分；全局
+ * 在途上限则由所有线程共享一个计数器，发送前预留名额、完成时归还，
+ * 回退可以一直降到 AIMD_MIN_WINDOW，不受线程数限制；探测次数用完且按时
+ * 回复过的目标中，所有线程合计留下 AIMD_CANARY_TARGETS 个作为金丝雀，
+ * 在还有目标待发送时每个周期重新探测一次（不占用令牌），结果只交给控制器。设置了 prefix_rate_pps
+ * 时每次发送还需从目标所属前缀的令牌桶取得令牌，取不到时该目标推迟到
+ * 令牌产生时刻，本轮继续处理其他前缀的目标。
+ *
+ * 启用 busy_poll 时以零超时轮询完成事件代替阻塞等待，线程不进入睡眠，
+ * 回复完成到被处理之间没有调度唤醒延迟，代价是占满一个核心。
+ *
+ * 每个线程拥有独立的 ICMP 句柄、槽位和一段连续的目标（及其统计项），
+ * 回复在发出请求的线程上处理；指定 cpus 时线程绑定到对应核心，
+ * 发送、完成处理和统计更新都留在同一核心上。
+ *
+ * @param index 线程序号，负责第 index 段连续的目标
+ * @param thread_count 线程总数
+ * @param slot_count 本线程的槽位数
+ */
+void ProbeEngine::worker(size_t index, size_t thread_count, size_t slot_count) {
+    // 先绑核再创建句柄和缓冲区，使其内存分配在本核心所在的节点上
+    if (!config_.cpus.empty()) {
+        int cpu = config_.cpus[index % config_.cpus.size()];
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+    }
+    // 忙轮询线程提高优先级，减少被其他线程抢占造成的测量抖动
+    if (config_.busy_poll) {
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+    }
+
+    IcmpHandle h4(IcmpCreateFile());
+    IcmpHandle h6(Icmp6CreateFile());
+
+    // 本线程负责的目标：连续分段，使各线程更新的统计项不共享缓存行
+    std::vector<size_t> mine;
+    size_t first = targets_.size() * index / thread_count;
+    size_t last = targets_.size() * (index + 1) / thread_count;
+    for (size_t i = first; i < last; ++i) {
+        if (state_[i].af != AF_UNSPEC) {
+            mine.push_back(i);
+        }
+    }
+
+    // 槽位和事件句柄
+    DWORD reply_size = (DWORD)((sizeof(ICMP_ECHO_REPLY) + payload_stride_ + 64) *
+                               (size_t)std::max(1, config_.max_replies));
+    std::vector<Slot> slots(slot_count);
+    std::vector<size_t> free_slots;
+    std::vector<size_t> busy;
+    for (size_t i = 0; i < slot_count; ++i) {
+        slots[i].event = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        slots[i].reply.resize(reply_size);
+        free_slots.push_back(slot_count - 1 - i);
+    }
+    busy.reserve(slot_count);
+
+    std::vector<HANDLE> handles(slot_count);
+    const uint64_t count = (uint64_t)std::max(0, config_.count);
+    const LONGLONG max_wait = (LONGLONG)ENGINE_MAX_WAIT_MS * freq_ / 1000;
+    const LONGLONG duration = (LONGLONG)config_.duration_ms * freq_ / 1000;
+    const bool limited = config_.rate_pps > 0 || aimd_;
+    double tokens = 0;                         // 令牌桶（仅限速时使用）
+    LONGLONG last_refill = start_ticks_;
+    bool cancelled = false;
+
+    // 就绪队列：按到期时刻排列的最小堆。窗口已满的目标不在队列中，
+    // 由完成处理重新入队，每轮只触及到期的目标而不是扫描整段
+    std::vector<ReadyEntry> ready;
+    uint64_t ready_order = 0;
+    auto finished = [&](size_t idx) {
+        return (count > 0 && state_[idx].issued >= count) ||
+               retired_[idx].load(std::memory_order_relaxed);
+    };
+    auto enqueue = [&](size_t idx, LONGLONG due) {
+        state_[idx].queued = true;
+        ready.push_back({due, ready_order++, idx});
+        std::push_heap(ready.begin(), ready.end(), std::greater<ReadyEntry>());
+    };
+    for (size_t idx : mine) {
+        enqueue(idx, state_[idx].next_due);
+    }
+
+    // 金丝雀（仅 --aimd）：探测次数用完且按时回复过的目标，每个周期重新探测一次；
+    // 各线程从全局名额中领取，总数不超过 AIMD_CANARY_TARGETS
+    std::vector<std::pair<size_t, LONGLONG>> canaries;   // 目标序号、下一次探测时刻
+    const LONGLONG canary_period = (LONGLONG)AIMD_EPOCH_MS * freq_ / 1000;
+    auto add_canary = [&](size_t idx) {
+        for (const auto& c : canaries) {
+            if (c.first == idx) {
+                return;
+            }
+        }
+        if (canary_count_.fetch_add(1, std::memory_order_relaxed) < AIMD_CANARY_TARGETS) {
+            canaries.push_back(std::make_pair(idx, ticks_now() + canary_period));
+        } else {
+            canary_count_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+    // 处理 busy 中第 pos 个槽位的完成，handles 与 busy 同步交换删除
+    auto finish = [&](size_t pos) {
+        size_t s = busy[pos];
+        busy[pos] = busy.back();
+        handles[pos] = handles[busy.size() - 1];
+        busy.pop_back();
+        bool replied = complete(slots[s], cancelled);
+        free_slots.push_back(s);
+        size_t idx = slots[s].target;
+        if (!state_[idx].queued && !finished(idx)) {
+            enqueue(idx, state_[idx].next_due);
+        } else if (replied && aimd_ && count > 0 && state_[idx].issued >= count &&
+                   canary_count_.load(std::memory_order_relaxed) < AIMD_CANARY_TARGETS) {
+            add_canary(idx);
+        }
+    };
+
+    for (;;) {
+        bool stopping = stop_->load();
+        if (stopping && config_.cancel_on_stop && !cancelled && !busy.empty()) {
+            // 关闭句柄使挂起的请求立即完成，下面的等待很快收回所有槽位
+            h4.close();
+            h6.close();
+            cancelled = true;
+        }
+        LONGLONG now = ticks_now();
+        LONGLONG next_due = now + max_wait;
+        FastClock::maybe_recalibrate((uint64_t)now);
+        bool expired = duration > 0 && now - start_ticks_ >= duration;
+        bool capped = false;                   // 全局在途上限已满（仅 --aimd）
+
+        // 按当前级别速率补充令牌，桶容量不超过槽位数以限制突发
+        double rate = 0;
+        if (limited) {
+            uint64_t elapsed_ms = (uint64_t)((now - start_ticks_) * 1000 / freq_);
+            rate = (double)(aimd_ ? aimd_->rate() : engine_rate_at(config_, elapsed_ms)) / thread_count;
+            tokens = std::min(tokens + rate * (now - last_refill) / freq_, (double)slot_count);
+            last_refill = now;
+        }
+
+        //---------------------------------------------------------------------
+        // 从就绪队列取出到期的目标发送请求，槽位或令牌用尽即停止
+        //---------------------------------------------------------------------
+        if (!stopping && !expired) {
+            // 金丝雀先于普通目标发送，且不占用令牌：线程多时每个线程分到的
+            // 速率很低，占用令牌会让金丝雀错过周期。额外流量固定为每周期
+            // AIMD_CANARY_TARGETS 个。没有待发送的目标时不再探测，避免金丝雀
+            // 本身让线程无法结束
+            for (auto& c : canaries) {
+                if (ready.empty() || free_slots.empty()) {
+                    break;
+                }
+                if (c.second > now) {
+                    continue;
+                }
+                if (state_[c.first].in_flight >= config_.window) {
+                    // 上一次探测仍在途（-w 长于周期），跳过本周期
+                    c.second = now + canary_period;
+                    continue;
+                }
+                if (in_flight_.fetch_add(1, std::memory_order_relaxed) >= aimd_->window()) {
+                    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+                    capped = true;
+                    break;
+                }
+                LONGLONG prefix_retry = 0;
+                if (!prefix_tat_.empty() && !take_prefix(c.first, now, prefix_retry)) {
+                    in_flight_.fetch_sub(1, std::memory_order_relaxed);
+                    c.second = prefix_retry;
+                    continue;
+                }
+                size_t s = free_slots.back();
+                free_slots.pop_back();
+                slots[s].canary = true;
+                issue(h4.get(), h6.get(), slots[s], c.first, now);
+                busy.push_back(s);
+                c.second = now + canary_period;
+            }
+            if (capped) {
+                next_due = std::min(next_due, now + (LONGLONG)AIMD_CAP_POLL_MS * freq_ / 1000);
+            }
+
+            while (!capped && !ready.empty() && ready.front().due <= now &&
+                   !free_slots.empty() && (!limited || tokens >= 1.0)) {
+                size_t idx = ready.front().target;
+                std::pop_heap(ready.begin(), ready.end(), std::greater<ReadyEntry>());
+                ready.pop_back();
+                TargetState& t = state_[idx];
+                t.queued = false;
+                if (finished(idx)) {
+                    continue;
+                }
+
+                // 前缀令牌不足时该目标推迟到令牌产生，继续处理其他前缀的目标
+                LONGLONG prefix_retry = 0;
+                bool prefix_blocked = false;
+                while (!free_slots.empty() && t.in_flight < config_.window &&
+                       t.next_due <= now && (count == 0 || t.issued < count) &&
+                       (!limited || tokens >= 1.0)) {
+                    // 先预留全局在途名额，各线程争用同一个计数器，上限不随线程数取整
+                    if (aimd_ && in_flight_.fetch_add(1, std::memory_order_relaxed) >= aimd_->window()) {
+                        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+                        capped = true;
+                        break;
+                    }
+                    if (!prefix_tat_.empty() && !take_prefix(idx, now, prefix_retry)) {
+                        if (aimd_) {
+                            in_flight_.fetch_sub(1, std::memory_order_relaxed);
+                        }
+                        prefix_blocked = true;
+                        break;
+                    }
+                    size_t s = free_slots.back();
+                    free_slots.pop_back();
+                    slots[s].canary = false;
+                    issue(h4.get(), h6.get(), slots[s], idx, now);
+                    busy.push_back(s);
+                    tokens -= 1.0;
+                }
+                if (finished(idx)) {
+                    continue;
+                }
+                if (capped) {
+                    // 名额由其他线程的完成归还，收不到通知，短暂等待后重试
+                    enqueue(idx, t.next_due);
+                    next_due = std::min(next_due, now + (LONGLONG)AIMD_CAP_POLL_MS * freq_ / 1000);
+                    break;
+                }
+                if (prefix_blocked) {
+                    enqueue(idx, prefix_retry);
+                } else if (t.in_flight < config_.window) {
+                    enqueue(idx, t.next_due);
+                }
+            }
+            if (!ready.empty() && !capped) {
+                next_due = std::min(next_due, ready.front().due);
+                for (const auto& c : canaries) {
+                    next_due = std::min(next_due, c.second);
+                }
+            }
+
+            // 令牌不足时等到下一个令牌产生
+            if (limited && tokens < 1.0 && rate > 0) {
+                LONGLONG refill = (LONGLONG)((1.0 - tokens) / rate * freq_);
+                next_due = std::min(now + max_wait, std::max(next_due, now + refill));
+            }
+        }
+
+        if (busy.empty()) {
+            if (stopping || expired || ready.empty()) {
+                break;
+            }
+            LONGLONG wait = std::max<LONGLONG>(0, next_due - ticks_now());
+            Sleep((DWORD)(wait * 1000 / freq_));
+            continue;
+        }
+
+        //---------------------------------------------------------------------
+        // 等待任一槽位完成或下一个发送时刻
+        //---------------------------------------------------------------------
+        for (size_t i = 0; i < busy.size(); ++i) {
+            handles[i] = slots[busy[i]].event;
+        }
+        DWORD wait_ms = 0;
+        LONGLONG wait = next_due - ticks_now();
+        if (stopping || expired || (free_slots.empty() && !capped)) {
+            wait_ms = ENGINE_MAX_WAIT_MS;
+        } else if (wait > 0) {
+            wait_ms = (DWORD)((wait * 1000 + freq_ - 1) / freq_);
+        }
+
+        DWORD r;
+        if (config_.busy_poll) {
+            // 忙轮询：以零超时反复检查事件，完成后立即处理，不经过线程唤醒
+            LONGLONG deadline = ticks_now() + (LONGLONG)wait_ms * freq_ / 1000;
+            do {
+                r = WaitForMultipleObjects((DWORD)busy.size(), handles.data(), FALSE, 0);
+                if (r != WAIT_TIMEOUT) {
+                    break;
+                }
+                YieldProcessor();
+            } while (ticks_now() < deadline && !stop_->load());
+        } else {
+            r = WaitForMultipleObjects((DWORD)busy.size(), handles.data(), FALSE, wait_ms);
+        }
+
+        // 收回所有已完成的槽位后再回到发送阶段，一次唤醒处理一批回复
+        while (r != WAIT_TIMEOUT && r != WAIT_FAILED && (size_t)(r - WAIT_OBJECT_0) < busy.size()) {
+            finish((size_t)(r - WAIT_OBJECT_0));
+            if (busy.empty()) {
+                break;
+            }
+            r = WaitForMultipleObjects((DWORD)busy.size(), handles.data(), FALSE, 0);
+        }
+    }
+
+    for (auto& slot : slots) {
+        CloseHandle(slot.event);
+    }
+
+    // 最后一个结束的线程通知主线程
+    if (active_.fetch_sub(1) == 1) {
+        stop_->store(true);
+    }
+}
+
+//=============================================================================
+// 多核扩展性测试
+//=============================================================================
+
+/**
+ * @brief 多核扩展性测试
+ *
+ * 每级的速率按引擎启动到全部线程结束的实际时间计算（含在途探测的
+ * 收尾时间，对本机或局域网目标可以忽略）。
+ */
+void run_scaling_benchmark(const std::vector<std::string>& targets,
+                           const PingOptions& opts,
+                           std::vector<int> cpus,
+                           std::atomic<bool>& stop_flag) {
+    if (cpus.empty()) {
+        parse_cpu_list("all", cpus);
+    }
+
+    std::vector<size_t> levels;
+    for (size_t k = 1; k < cpus.size(); k *= 2) {
+        levels.push_back(k);
+    }
+    levels.push_back(cpus.size());
+
+    printf("\n--- 多核扩展性测试 (每级 %d ms, 每线程 %d 个在途探测) ---\n",
+           SCALING_STEP_MS, ENGINE_SLOTS_PER_THREAD);
+    printf("线程   请求/秒    回复/秒  每线程回复/秒  加速比\n");
+
+    double base = 0;
+    for (size_t k : levels) {
+        if (stop_flag.load()) {
+            break;
+        }
+
+        // 目标不足时重复使用，保证每个线程都分到目标
+        std::vector<std::string> list;
+        while (list.size() < std::max(k, targets.size())) {
+            list.insert(list.end(), targets.begin(), targets.end());
+        }
+        std::vector<TargetStat> stats(list.size());
+
+        EngineConfig cfg;
+        cfg.window = MAX_WINDOW;
+        cfg.interval_ms = 0;
+        cfg.count = 0;
+        cfg.max_in_flight = (int)k * ENGINE_SLOTS_PER_THREAD;
+        cfg.threads = (int)k;
+        cfg.cpus.assign(cpus.begin(), cpus.begin() + k);
+        cfg.duration_ms = SCALING_STEP_MS;
+
+        std::atomic<bool> done{false};
+        auto begin = std::chrono::steady_clock::now();
+        ProbeEngine engine(list, stats, opts, cfg);
+        if (!engine.start(done)) {
+            return;
+        }
+        while (!done.load()) {
+            if (stop_flag.load()) {
+                done.store(true);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(ENGINE_MAX_WAIT_MS));
+        }
+        engine.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        uint64_t sent = 0, recv = 0;
+        for (const auto& st : stats) {
+            sent += st.sent.load();
+            recv += st.recv.load();
+        }
+        double recv_pps = recv / seconds;
+        if (base == 0) {
+            base = recv_pps;
+        }
+        printf("%4zu  %9.0f  %9.0f  %13.0f  %6.2fx\n", k, sent / seconds, recv_pps,
+               recv_pps / k, base > 0 ? recv_pps / base : 0.0);
+    }
+}
+
+//=============================================================================
+// 本机 RTT 下限测量
+//=============================================================================
+
+/**
+ * @brief 以指定等待方式逐个探测本机，返回每次探测的实测 RTT（微秒）
+ */
+static std::vector<uint64_t> measure_loopback(const PingOptions& opts,
+                                              const std::vector<int>& cpus,
+                                              bool busy_poll,
+                                              std::atomic<bool>& stop_flag) {
+    std::vector<std::string> target(1, "127.0.0.1");
+    std::vector<TargetStat> stats(1);
+    std::vector<uint64_t> samples;
+    samples.reserve(RTT_FLOOR_PROBES);
+
+    EngineConfig cfg;
+    cfg.window = 1;
+    cfg.interval_ms = 0;
+    cfg.count = RTT_FLOOR_PROBES;
+    cfg.threads = 1;
+    cfg.busy_poll = busy_poll;
+    if (!cpus.empty()) {
+        cfg.cpus.assign(1, cpus[0]);
+    }
+
+    std::atomic<bool> done{false};
+    ProbeEngine engine(target, stats, opts, cfg);
+    engine.set_callback([&](const ProbeEvent& ev) {
+        if (ev.result.success && !ev.late) {
+            samples.push_back(ev.elapsed_us);
+        }
+    });
+    if (!engine.start(done)) {
+        return samples;
+    }
+    while (!done.load()) {
+        if (stop_flag.load()) {
+            done.store(true);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ENGINE_MAX_WAIT_MS));
+    }
+    engine.join();
+    return samples;
+}
+
+/**
+ * @brief 输出一组 RTT 样本的分布
+ */
+static void print_rtt_distribution(const char* label, std::vector<uint64_t>& samples) {
+    if (samples.empty()) {
+        printf("%s 无回复\n", label);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto pct = [&](double p) {
+        return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))];
+    };
+    printf("%s %6zu  %7llu  %7llu  %7llu  %7llu  %7llu\n", label, samples.size(),
+           (unsigned long long)samples.front(), (unsigned long long)pct(0.5),
+           (unsigned long long)pct(0.9), (unsigned long long)pct(0.99),
+           (unsigned long long)samples.back());
+}
+
+/**
+ * @brief 测量本机回环 RTT 在阻塞等待和忙轮询下的分布
+ *
+ * 两种方式各逐个探测 127.0.0.1 RTT_FLOOR_PROBES 次（窗口为 1，单线程，
+ * 指定 cpus 时绑定到第一个 CPU），输出最小值、分位数和最大值，
+ * 即当前系统上 RTT 测量能达到的下限和抖动。
+ */
+void run_rtt_floor(const PingOptions& opts, const std::vector<int>& cpus,
+                   std::atomic<bool>& stop_flag) {
+    std::vector<uint64_t> blocking = measure_loopback(opts, cpus, false, stop_flag);
+    std::vector<uint64_t> polling = measure_loopback(opts, cpus, true, stop_flag);
+
+    printf("\n--- 本机回环 RTT 分布 (127.0.0.1, 每种方式 %d 次, 微秒) ---\n", RTT_FLOOR_PROBES);
+    printf("时钟: %s, %.3f MHz\n", FastClock::using_tsc() ? "TSC" : "QueryPerformanceCounter",
+           FastClock::frequency() / 1e6);
+    printf("方式       样本     最小      P50      P90      P99     最大\n");
+    print_rtt_distribution("阻塞等待", blocking);
+    print_rtt_distribution("忙轮询  ", polling);
+}
+
+//=============================================================================
+// 洪泛模式统计
+//=============================================================================
+
+/**
+ * @brief 记录一个探测完成事件
+ *
+ * 事件按发送时刻归入级别，因此在级别切换附近发送、稍后才完成的探测
+ * 仍计入其发送时的速率级别。
+ */
+void FloodMonitor::record(const ProbeEvent& ev) {
+    const uint64_t step_us = (uint64_t)std::max(1, config_.step_ms) * 1000;
+    size_t step = (size_t)(ev.sent_us / step_us);
+    // 在截止时刻前一瞬发出的探测归入最后一级
+    if (config_.duration_ms > 0) {
+        size_t last = (size_t)(((uint64_t)config_.duration_ms * 1000 + step_us - 1) / step_us);
+        step = std::min(step, std::max<size_t>(1, last) - 1);
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (step >= steps_.size()) {
+        steps_.resize(step + 1);
+    }
+    Step& st = steps_[step];
+    st.sent++;
+    if (ev.late) {
+        st.late++;
+    } else if (ev.result.success) {
+        st.recv++;
+        st.rtt_us_sum += ev.elapsed_us;
+    }
+}
+
+/**
+ * @brief 输出分级统计和丢包起始点
+ *
+ * 每级的速率按该级实际持续时间计算（最后一级可能因停止而不足一级）。
+ * 迟到回复计为丢失。
+ */
+void FloodMonitor::print_report(uint64_t elapsed_ms) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const uint64_t step_ms = (uint64_t)std::max(1, config_.step_ms);
+
+    printf("\n--- 洪泛统计 ---\n");
+    printf("级别  目标速率   请求/秒   回复/秒  丢失率  平均RTT\n");
+
+    double peak_sent = 0, peak_recv = 0;
+    int onset = -1;
+    for (size_t i = 0; i < steps_.size(); ++i) {
+        const Step& st = steps_[i];
+        if (st.sent == 0) {
+            continue;
+        }
+        uint64_t begin = i * step_ms;
+        uint64_t span = (elapsed_ms > begin) ? std::min(step_ms, elapsed_ms - begin) : step_ms;
+        double seconds = std::max<uint64_t>(1, span) / 1000.0;
+        double sent_pps = st.sent / seconds;
+        double recv_pps = st.recv / seconds;
+        double loss = 100.0 * (st.sent - st.recv) / st.sent;
+        double avg_rtt = st.recv ? st.rtt_us_sum / 1000.0 / st.recv : 0.0;
+
+        printf("%4zu  %8d  %9.0f  %8.0f  %5.1f%%  %6.2fms\n", i + 1,
+               engine_rate_at(config_, begin), sent_pps, recv_pps, loss, avg_rtt);
+
+        peak_sent = std::max(peak_sent, sent_pps);
+        peak_recv = std::max(peak_recv, recv_pps);
+        if (onset < 0 && loss > FLOOD_LOSS_THRESHOLD) {
+            onset = (int)i;
+        }
+    }
+
+    printf("\n峰值速率: 请求=%.0f/秒, 回复=%.0f/秒\n", peak_sent, peak_recv);
+    if (onset >= 0) {
+        const Step& st = steps_[onset];
+        printf("开始丢包: 第 %d 级, 目标速率 %d pps, 丢失率 %.1f%%\n", onset + 1,
+               engine_rate_at(config_, (uint64_t)onset * step_ms),
+               100.0 * (st.sent - st.recv) / st.sent);
+    } else {
+        printf("未观察到丢包 (各级丢失率均不超过 %.1f%%)\n", FLOOD_LOSS_THRESHOLD);
+    }
+}
+
+//=============================================================================
+// 负载大小扫描统计
+//=============================================================================
+
+/**
+ * @brief 构造函数
+ */
+SizeSweepMonitor::SizeSweepMonitor(const std::vector<int>& sizes, size_t target_count)
+    : sizes_(sizes), cells_(sizes.size() * target_count) {
+}
+
+/**
+ * @brief 记录一个探测完成事件
+ *
+ * 迟到回复计为丢失，其往返时间不参与回归。
+ */
+void SizeSweepMonitor::record(const ProbeEvent& ev) {
+    auto it = std::lower_bound(sizes_.begin(), sizes_.end(), ev.payload_size);
+    if (it == sizes_.end() || *it != ev.payload_size) {
+        return;
+    }
+    size_t index = ev.target * sizes_.size() + (size_t)(it - sizes_.begin());
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (index >= cells_.size()) {
+        return;
+    }
+    Cell& c = cells_[index];
+    c.sent++;
+    if (ev.result.success && !ev.late) {
+        c.recv++;
+        c.rtt_us_sum += ev.elapsed_us;
+    }
+}
+
+/**
+ * @brief 输出每个目标的扫描结果
+ *
+ * 对每个有回复的大小取平均 RTT，做最小二乘线性回归。请求和回复都携带
+ * 同样大小的负载，因此每字节经过链路两次，带宽估计为 2 × 8 / 斜率。
+ * 开始丢包的大小取从最大大小向下连续丢失率超过阈值的最小大小。
+ */
+void SizeSweepMonitor::print_report(const std::vector<std::string>& targets) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const size_t n = sizes_.size();
+    const size_t target_count = n ? cells_.size() / n : 0;
+
+    printf("\n--- 负载大小扫描 (%d-%d 字节, %zu 级) ---\n",
+           n ? sizes_.front() : 0, n ? sizes_.back() : 0, n);
+
+    for (size_t t = 0; t < target_count && t < targets.size(); ++t) {
+        const Cell* row = &cells_[t * n];
+
+        if (target_count <= SIZE_SWEEP_TABLE_TARGETS) {
+            printf("\n%s:\n", targets[t].c_str());
+            printf("   大小  已发送  已接收  丢失率  平均RTT\n");
+            for (size_t i = 0; i < n; ++i) {
+                const Cell& c = row[i];
+                if (c.sent == 0) {
+                    continue;
+                }
+                printf("  %5d  %6llu  %6llu  %5.1f%%  %7.2fms\n", sizes_[i],
+                       (unsigned long long)c.sent, (unsigned long long)c.recv,
+                       100.0 * (c.sent - c.recv) / c.sent,
+                       c.recv ? c.rtt_us_sum / 1000.0 / c.recv : 0.0);
+            }
+        }
+
+        // RTT-大小线性回归（每个大小一个点）
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        int points = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (row[i].recv == 0) {
+                continue;
+            }
+            double x = sizes_[i];
+            double y = (double)row[i].rtt_us_sum / row[i].recv;
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+            points++;
+        }
+
+        // 开始持续丢包的大小
+        int loss_from = -1;
+        for (size_t i = n; i-- > 0;) {
+            const Cell& c = row[i];
+            if (c.sent == 0 || 100.0 * (c.sent - c.recv) / c.sent <= SIZE_SWEEP_LOSS_THRESHOLD) {
+                break;
+            }
+            loss_from = sizes_[i];
+        }
+
+        printf("%s : ", targets[t].c_str());
+        double denom = points * sxx - sx * sx;
+        if (points >= 2 && denom > 0) {
+            double slope = (points * sxy - sx * sy) / denom;
+            double intercept = (sy - slope * sx) / points;
+            printf("斜率=%.4fus/字节, 截距=%.2fms", slope, intercept / 1000.0);
+            if (slope > 0) {
+                printf(", 估计带宽=%.1fMbps", 2 * 8 / slope);
+            }
+        } else {
+            printf("有效数据点不足，无法估计斜率");
+        }
+        if (loss_from >= 0) {
+            printf(", 从 %d 字节开始丢包\n", loss_from);
+        } else {
+            printf(", 未出现随大小增加的丢包\n");
+        }
+    }
+}
+
+//=============================================================================
+// 多路径覆盖统计
+//=============================================================================
+
+/**
+ * @brief 构造函数
+ */
+FlowMonitor::FlowMonitor(int flows, size_t target_count)
+    : flows_(flows), cells_((size_t)flows * target_count) {
+}
+
+/**
+ * @brief 记录一个探测完成事件
+ *
+ * 迟到回复计为丢失。
+ */
+void FlowMonitor::record(const ProbeEvent& ev) {
+    size_t index = ev.target * (size_t)flows_ + (size_t)ev.flow;
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (index >= cells_.size()) {
+        return;
+    }
+    Cell& c = cells_[index];
+    c.sent++;
+    if (ev.result.success && !ev.late) {
+        c.recv++;
+        c.rtt_us_sum += ev.elapsed_us;
+    }
+}
+
+/**
+ * @brief 输出每个目标各流的统计
+ *
+ * 流的丢失率与同一目标其余各流合计的丢失率比较，高出 FLOW_LOSS_MARGIN
+ * 个百分点时标记，提示该流所经过的成员链路有问题。
+ */
+void FlowMonitor::print_report(const std::vector<std::string>& targets) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const size_t n = (size_t)flows_;
+    const size_t target_count = n ? cells_.size() / n : 0;
+    size_t suspects = 0;
+
+    printf("\n--- 多路径覆盖 (每目标 %d 个流) ---\n", flows_);
+    for (size_t t = 0; t < target_count && t < targets.size(); ++t) {
+        const Cell* row = &cells_[t * n];
+        uint64_t sent = 0, recv = 0;
+        for (size_t f = 0; f < n; ++f) {
+            sent += row[f].sent;
+            recv += row[f].recv;
+        }
+        if (sent == 0) {
+            continue;
+        }
+
+        printf("\n%s:\n", targets[t].c_str());
+        printf("    流  已发送  已接收  丢失率  平均RTT\n");
+        for (size_t f = 0; f < n; ++f) {
+            const Cell& c = row[f];
+            if (c.sent == 0) {
+                continue;
+            }
+            double loss = 100.0 * (c.sent - c.recv) / c.sent;
+            uint64_t other_sent = sent - c.sent, other_recv = recv - c.recv;
+            double other_loss = other_sent ? 100.0 * (other_sent - other_recv) / other_sent : loss;
+            bool suspect = loss - other_loss > FLOW_LOSS_MARGIN;
+            printf("  %4zu  %6llu  %6llu  %5.1f%%  %7.2fms%s\n", f,
+                   (unsigned long long)c.sent, (unsigned long long)c.recv, loss,
+                   c.recv ? c.rtt_us_sum / 1000.0 / c.recv : 0.0,
+                   suspect ? "  <- 丢失率异常" : "");
+            suspects += suspect ? 1 : 0;
+        }
+    }
+    printf("\n丢失率异常的流: %zu\n", suspects);
+}
+
+//=============================================================================
+// 发送时间分解统计
+//=============================================================================
+
+/**
+ * @brief 微秒值所在的直方图桶
+ *
+ * 小于 2^SEND_TIMING_SUB_BITS 的值各占一桶；更大的值按最高位所在的
+ * 2 的幂区间分组，每组再按其后 SEND_TIMING_SUB_BITS 位细分。
+ */
+static size_t timing_bucket(uint64_t us) {
+    const uint64_t sub = 1ull << SEND_TIMING_SUB_BITS;
+    if (us < sub) {
+        return (size_t)us;
+    }
+    int e = 63;
+    while (!(us >> e)) {
+        e--;
+    }
+    size_t idx = (size_t)(e - SEND_TIMING_SUB_BITS + 1) * sub +
+                 (size_t)((us >> (e - SEND_TIMING_SUB_BITS)) & (sub - 1));
+    return std::min(idx, (size_t)SEND_TIMING_BUCKETS - 1);
+}
+
+/**
+ * @brief 直方图桶的下界（微秒）
+ */
+static uint64_t timing_bucket_floor(size_t idx) {
+    const uint64_t sub = 1ull << SEND_TIMING_SUB_BITS;
+    if (idx < sub) {
+        return idx;
+    }
+    int e = (int)(idx / sub) + SEND_TIMING_SUB_BITS - 1;
+    return (sub + idx % sub) << (e - SEND_TIMING_SUB_BITS);
+}
+
+void SendTimingMonitor::add(Series& s, uint64_t us) {
+    s.count++;
+    s.sum_us += us;
+    s.max_us = std::max(s.max_us, us);
+    s.hist[timing_bucket(us)]++;
+}
+
+/**
+ * @brief 记录一个探测完成事件
+ */
+void SendTimingMonitor::record(const ProbeEvent& ev) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    add(send_, ev.send_delay_us);
+    if (ev.result.success && !ev.late) {
+        add(wire_, ev.wire_us);
+    }
+}
+
+/**
+ * @brief 输出一段时间的分布（分位数取所在桶的下界）
+ */
+void SendTimingMonitor::print_series(const char* label, const Series& s) {
+    if (s.count == 0) {
+        printf("%s %8s\n", label, "无样本");
+        return;
+    }
+    auto pct = [&](double p) {
+        uint64_t rank = (uint64_t)(p * (s.count - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < (size_t)SEND_TIMING_BUCKETS; ++i) {
+            seen += s.hist[i];
+            if (seen > rank) {
+                return timing_bucket_floor(i);
+            }
+        }
+        return s.max_us;
+    };
+    printf("%s %8llu  %8.1f  %7llu  %7llu  %7llu  %7llu\n", label,
+           (unsigned long long)s.count, (double)s.sum_us / s.count,
+           (unsigned long long)pct(0.5), (unsigned long long)pct(0.9),
+           (unsigned long long)pct(0.99), (unsigned long long)s.max_us);
+}
+
+/**
+ * @brief 输出发送延迟和网络往返的分布及发送延迟所占比例
+ */
+void SendTimingMonitor::print_report() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    printf("\n--- 发送时间分解 (微秒) ---\n");
+    printf("阶段         样本      平均      P50      P90      P99     最大\n");
+    print_series("发送延迟", send_);
+    print_series("网络往返", wire_);
+    if (send_.count > 0 && wire_.count > 0) {
+        double send_avg = (double)send_.sum_us / send_.count;
+        double wire_avg = (double)wire_.sum_us / wire_.count;
+        printf("发送延迟占平均往返的 %.1f%%\n", 100.0 * send_avg / (send_avg + wire_avg));
+    }
+}
+
+//=============================================================================
+// 法定数量健康检查
+//=============================================================================
+
+/**
+ * @brief 构造函数
+ */
+QuorumMonitor::QuorumMonitor(size_t target_count, size_t required, int probes_per_target,
+                             size_t known_alive, size_t known_failed)
+    : total_(target_count + known_alive + known_failed), required_(required),
+      probes_(probes_per_target), failures_(target_count),
+      alive_(known_alive), failed_(known_failed) {
+    check();
+}
+
+/**
+ * @brief 根据在线数和失败数确定结论，确定时返回 true（只有一个调用者得到 true）
+ */
+bool QuorumMonitor::check() {
+    int outcome = 0;
+    if (alive_.load() >= required_) {
+        outcome = 1;
+    } else if (failed_.load() + required_ > total_) {
+        outcome = 2;
+    }
+    int expected = 0;
+    return outcome != 0 && outcome_.compare_exchange_strong(expected, outcome);
+}
+
+/**
+ * @brief 记录一个探测完成事件
+ *
+ * 每个目标的状态是一个原子计数：回复把它置为 -1（第一次置位的线程
+ * 计入在线数），超时把它加一，达到每目标探测次数时计入失败数。
+ */
+bool QuorumMonitor::record(const ProbeEvent& ev) {
+    if (ev.late || decided()) {
+        return false;
+    }
+    std::atomic<int>& state = failures_[ev.target];
+    if (ev.result.success) {
+        if (state.exchange(-1) == -1) {
+            return false;
+        }
+        alive_.fetch_add(1);
+    } else {
+        int v = state.load();
+        do {
+            if (v < 0) {
+                return false;
+            }
+        } while (!state.compare_exchange_weak(v, v + 1));
+        if (probes_ == 0 || v + 1 < probes_) {
+            return false;
+        }
+        failed_.fetch_add(1);
+    }
+    if (!check()) {
+        return false;
+    }
+    decided_us_.store(ev.sent_us + ev.elapsed_us);
+    return true;
+}
+
+/**
+ * @brief 输出结论
+ */
+void QuorumMonitor::print_report() const {
+    size_t alive = alive_.load(), failed = failed_.load();
+    size_t pending = total_ - std::min(total_, alive + failed);
+    printf("\n--- 法定数量 ---\n");
+    printf("需要在线 %zu/%zu: 在线=%zu, 失败=%zu, 未定=%zu\n", required_, total_, alive, failed, pending);
+    if (decided()) {
+        printf("结论: %s (%.2fms 时确定)\n", met() ? "满足" : "不满足", decided_us_.load() / 1000.0);
+    } else {
+        printf("结论: 不满足 (未能确定)\n");
+    }
+}
+
+//=============================================================================
+// 最优端点选择
+//=============================================================================
+
+/**
+ * @brief 构造函数
+ */
+SelectBestMonitor::SelectBestMonitor(size_t target_count, int timeout_ms)
+    : cands_(target_count), penalty_us_(timeout_ms * 1000.0), active_(target_count) {
+}
+
+/**
+ * @brief 样本平均值（微秒）
+ */
+double SelectBestMonitor::mean(const Candidate& c) {
+    return c.samples ? c.sum_us / c.samples : 0;
+}
+
+/**
+ * @brief 平均值置信区间的半宽（微秒）
+ *
+ * 方差由样本估计，分位数取自由度 n - 1 的 Student t 分布（99% 双侧）；
+ * 3 个样本时为 9.925，远大于正态分位数 2.576。样本数超出表长时取表中
+ * 最后一项，比正态分位数略保守。
+ */
+double SelectBestMonitor::half_width(const Candidate& c) {
+    static const double t99[] = {
+        63.657, 9.925, 5.841, 4.604, 4.032, 3.707, 3.499, 3.355, 3.250, 3.169,
+        3.106, 3.055, 3.012, 2.977, 2.947, 2.921, 2.898, 2.878, 2.861, 2.845,
+    };
+    const size_t table_len = sizeof(t99) / sizeof(t99[0]);
+    if (c.samples < 2) {
+        return HUGE_VAL;
+    }
+    double m = mean(c);
+    double var = std::max(0.0, (c.sum_sq - c.samples * m * m) / (c.samples - 1));
+    double t = t99[std::min<size_t>((size_t)c.samples - 1, table_len) - 1];
+    return t * std::sqrt(var / c.samples);
+}
+
+/**
+ * @brief 淘汰明显劣于领先者的候选
+ *
+ * 所有在选候选都达到 SELECT_MIN_SAMPLES 个样本后才比较，避免先完成的
+ * 候选凭少量样本淘汰其他候选。
+ */
+void SelectBestMonitor::eliminate(std::vector<size_t>& eliminated) {
+    size_t leader = SIZE_MAX;
+    for (size_t i = 0; i < cands_.size(); ++i) {
+        const Candidate& c = cands_[i];
+        if (c.retired_after) {
+            continue;
+        }
+        if (c.samples < (uint64_t)SELECT_MIN_SAMPLES) {
+            return;
+        }
+        if (leader == SIZE_MAX || mean(c) < mean(cands_[leader])) {
+            leader = i;
+        }
+    }
+    if (leader == SIZE_MAX) {
+        return;
+    }
+    double upper = mean(cands_[leader]) + half_width(cands_[leader]);
+    for (size_t i = 0; i < cands_.size(); ++i) {
+        Candidate& c = cands_[i];
+        if (i != leader && !c.retired_after && mean(c) - half_width(c) > upper) {
+            c.retired_after = probes_;
+            active_--;
+            eliminated.push_back(i);
+        }
+    }
+}
+
+/**
+ * @brief 记录一个探测完成事件
+ */
+bool SelectBestMonitor::record(const ProbeEvent& ev, std::vector<size_t>& eliminated) {
+    if (ev.late) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    Candidate& c = cands_[ev.target];
+    if (decided_ || c.retired_after) {
+        return false;
+    }
+    double us = ev.result.success ? (double)ev.elapsed_us : penalty_us_;
+    c.samples++;
+    c.replies += ev.result.success ? 1 : 0;
+    c.sum_us += us;
+    c.sum_sq += us * us;
+    probes_++;
+
+    eliminate(eliminated);
+
+    bool exhausted = true;
+    size_t leader = SIZE_MAX;
+    for (size_t i = 0; i < cands_.size(); ++i) {
+        const Candidate& d = cands_[i];
+        if (d.retired_after) {
+            continue;
+        }
+        exhausted = exhausted && d.samples >= (uint64_t)SELECT_MAX_PROBES;
+        if (leader == SIZE_MAX || mean(d) < mean(cands_[leader])) {
+            leader = i;
+        }
+    }
+    // 只剩的候选也从未回复时继续探测，直到收到回复或用尽探测次数
+    if ((active_ > 1 || cands_[leader].replies == 0) && !exhausted) {
+        return false;
+    }
+    decided_ = true;
+    winner_ = leader;
+    return true;
+}
+
+/**
+ * @brief 是否选出了收到过回复的候选
+ */
+bool SelectBestMonitor::has_winner() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return winner_ != SIZE_MAX && cands_[winner_].replies > 0;
+}
+
+/**
+ * @brief 输出选择结果
+ *
+ * 最后一行为 key=value 形式，供脚本直接解析；没有候选回复时 best=none。
+ */
+void SelectBestMonitor::print_report(const std::vector<std::string>& targets,
+                                     uint64_t elapsed_ms) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    printf("\n--- 最优端点选择 ---\n");
+    printf("%-40s %6s %6s %10s %10s  %s\n", "候选", "样本", "回复", "平均(ms)", "±(ms)", "状态");
+    for (size_t i = 0; i < cands_.size(); ++i) {
+        const Candidate& c = cands_[i];
+        double hw = half_width(c);
+        char status[64];
+        if (i == winner_) {
+            snprintf(status, sizeof(status), "最优");
+        } else if (c.retired_after) {
+            snprintf(status, sizeof(status), "第 %llu 次探测后淘汰", (unsigned long long)c.retired_after);
+        } else {
+            snprintf(status, sizeof(status), "未区分");
+        }
+        printf("%-40s %6llu %6llu %10.3f %10.3f  %s\n", targets[i].c_str(),
+               (unsigned long long)c.samples, (unsigned long long)c.replies, mean(c) / 1000.0,
+               std::isinf(hw) ? 0.0 : hw / 1000.0, status);
+    }
+    printf("探测 %llu 次 (每个候选 %d 次需 %llu 次), 耗时 %llums\n", (unsigned long long)probes_,
+           SELECT_MAX_PROBES, (unsigned long long)cands_.size() * SELECT_MAX_PROBES,
+           (unsigned long long)elapsed_ms);
+
+    if (winner_ == SIZE_MAX || cands_[winner_].replies == 0) {
+        printf("best=none probes=%llu elapsed_ms=%llu\n", (unsigned long long)probes_,
+               (unsigned long long)elapsed_ms);
+        return;
+    }
+    const Candidate& w = cands_[winner_];
+    printf("best=%s rtt_ms=%.3f samples=%llu probes=%llu elapsed_ms=%llu\n", targets[winner_].c_str(),
+           mean(w) / 1000.0, (unsigned long long)w.samples, (unsigned long long)probes_,
+           (unsigned long long)elapsed_ms);
+}
+
+//=============================================================================
+// 自适应速率控制
+//=============================================================================
+
+/**
+ * @brief 构造函数
+ */
+AimdController::AimdController(size_t target_count, int max_window,
+                               const std::vector<uint8_t>& known_alive)
+    : max_window_(std::max(AIMD_MIN_WINDOW, max_window)),
+      rate_pps_(AIMD_START_PPS),
+      window_(std::min(AIMD_START_WINDOW, std::max(AIMD_MIN_WINDOW, max_window))),
+      alive_(target_count, 0),
+      peak_pps_(AIMD_START_PPS) {
+    for (size_t i = 0; i < known_alive.size() && i < target_count; ++i) {
+        alive_[i] = known_alive[i];
+    }
+    cur_.rate_pps = rate_pps_.load();
+    cur_.window = window_.load();
+}
+
+/**
+ * @brief 记录一个探测完成事件
+ *
+ * 以完成时刻（发送时刻加实测时间）划分周期。各线程的事件到达顺序不严格
+ * 有序，周期边界只是近似，足以用于速率调整。
+ */
+void AimdController::record(const ProbeEvent& ev) {
+    uint64_t now_ms = (ev.sent_us + ev.elapsed_us) / 1000;
+    bool ok = ev.result.success && !ev.late;
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (now_ms >= cur_.begin_ms + AIMD_EPOCH_MS) {
+        close_epoch(now_ms);
+    }
+    cur_.completed++;
+    if (ev.target < alive_.size()) {
+        if (alive_[ev.target] && ev.sent_us >= backoff_us_) {
+            cur_.samples++;
+            cur_.lost += ok ? 0 : 1;
+        }
+        if (ok) {
+            alive_[ev.target] = 1;
+        }
+    }
+}
+
+/**
+ * @brief 结束当前周期并按丢失率调整速率和在途上限
+ *
+ * 已知在线样本不足 AIMD_MIN_SAMPLES 时保持不变：没有样本不代表没有
+ * 丢失，此时增长正是限速导致误判离线的情形；少数几个样本也不足以
+ * 判断拥塞。
+ */
+void AimdController::close_epoch(uint64_t now_ms) {
+    int rate = rate_pps_.load();
+    int window = window_.load();
+    double loss = cur_.samples ? (double)cur_.lost / cur_.samples : 0.0;
+    if (cur_.samples < (uint64_t)AIMD_MIN_SAMPLES) {
+        // 保持
+    } else if (loss > AIMD_LOSS_THRESHOLD) {
+        rate = std::max(AIMD_MIN_PPS, (int)(rate * AIMD_DECREASE_FACTOR));
+        window = std::max(AIMD_MIN_WINDOW, (int)(window * AIMD_DECREASE_FACTOR));
+        backoff_us_ = now_ms * 1000;
+        cur_.decreases = 1;
+        decreases_++;
+    } else {
+        rate = std::min(FLOOD_MAX_PPS, rate + AIMD_INCREASE_PPS);
+        window = std::min(max_window_, window + AIMD_WINDOW_STEP);
+        cur_.increases = 1;
+    }
+    rate_pps_.store(rate);
+    window_.store(window);
+    peak_pps_ = std::max(peak_pps_, rate);
+
+    cur_.span_ms = now_ms - cur_.begin_ms;
+    log_.push_back(cur_);
+    // 日志行数有上限：超过时相邻两行合并，长时间运行也只占固定内存
+    if (log_.size() > (size_t)AIMD_MAX_LOG_ROWS) {
+        size_t merged = 0;
+        for (size_t i = 0; i < log_.size(); i += 2, ++merged) {
+            Epoch e = log_[i];
+            if (i + 1 < log_.size()) {
+                const Epoch& next = log_[i + 1];
+                e.span_ms += next.span_ms;
+                e.completed += next.completed;
+                e.samples += next.samples;
+                e.lost += next.lost;
+                e.rate_pps = next.rate_pps;
+                e.window = next.window;
+                e.increases += next.increases;
+                e.decreases += next.decreases;
+            }
+            log_[merged] = e;
+        }
+        log_.resize(merged);
+    }
+
+    cur_ = Epoch();
+    cur_.begin_ms = now_ms;
+    cur_.rate_pps = rate;
+    cur_.window = window;
+}
+
+/**
+ * @brief 输出速率随时间的变化
+ *
+ * 每行给出该时段（合并的行为其中最后一个周期）生效的速率和在途上限、
+ * 实际完成速率、已知在线目标的丢失率以及时段结束时所做的调整；
+ * 最后一行为尚未评估的当前周期。
+ */
+void AimdController::print_report(uint64_t elapsed_ms) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::vector<Epoch> rows = log_;
+    Epoch last = cur_;
+    last.span_ms = (elapsed_ms > last.begin_ms) ? elapsed_ms - last.begin_ms : 0;
+    if (last.completed > 0) {
+        rows.push_back(last);
+    }
+    const size_t evaluated = log_.size();
+
+    printf("\n--- 自适应速率 (AIMD) ---\n");
+    printf("%10s %12s %8s %12s %10s %8s  %s\n", "时间(s)", "速率上限", "在途上限",
+           "完成(pps)", "在线样本", "丢失率", "调整");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Epoch& e = rows[i];
+        double completed_pps = e.span_ms ? e.completed * 1000.0 / e.span_ms : 0.0;
+        char loss[16];
+        if (e.samples) {
+            snprintf(loss, sizeof(loss), "%.1f%%", 100.0 * e.lost / e.samples);
+        } else {
+            snprintf(loss, sizeof(loss), "-");
+        }
+        char action[32];
+        if (i >= evaluated) {
+            snprintf(action, sizeof(action), "-");
+        } else if (e.decreases) {
+            snprintf(action, sizeof(action), "回退 %d 次", e.decreases);
+        } else if (e.increases) {
+            snprintf(action, sizeof(action), "增长");
+        } else {
+            snprintf(action, sizeof(action), "保持");
+        }
+        printf("%10.2f %12d %8d %12.1f %10llu %8s  %s\n", (e.begin_ms + e.span_ms) / 1000.0,
+               e.rate_pps, e.window, completed_pps, (unsigned long long)e.samples, loss, action);
+    }
+    printf("最终速率 %d pps, 在途上限 %d, 最高速率 %d pps, 回退 %d 次\n",
+           rate_pps_.load(), window_.load(), peak_pps_, decreases_);
+}
+
+//=============================================================================
+// 广播/组播发现
+//=============================================================================
+
+/**
+ * @brief 记录一个探测完成事件
+ *
+ * 迟到的回复同样计入：对发现而言，主机存在比回复是否准时更重要。
+ */
+void DiscoveryMonitor::record(const ProbeEvent& ev, std::vector<ReplySource>& found) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    probes_++;
+    for (const auto& source : ev.sources) {
+        replies_++;
+        auto ins = hosts_.emplace(source.addr, Host());
+        Host& host = ins.first->second;
+        if (ins.second) {
+            host.target = ev.target;
+            host.min_rtt_ms = source.rtt_ms;
+            found.push_back(source);
+        } else {
+            duplicates_++;
+            host.min_rtt_ms = std::min(host.min_rtt_ms, source.rtt_ms);
+        }
+        host.replies++;
+    }
+}
+
+/**
+ * @brief 输出发现结果
+ *
+ * 主机按地址排序（IPv4 在前）。
+ */
+void DiscoveryMonitor::print_report(const std::vector<std::string>& targets) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::vector<const std::pair<const std::string, Host>*> sorted;
+    sorted.reserve(hosts_.size());
+    for (const auto& kv : hosts_) {
+        sorted.push_back(&kv);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<const std::string, Host>* a,
+                                               const std::pair<const std::string, Host>* b) {
+        bool a6 = is_ipv6_address(a->first), b6 = is_ipv6_address(b->first);
+        if (a6 != b6) {
+            return b6;
+        }
+        return a6 ? a->first < b->first : ip_to_uint32(a->first) < ip_to_uint32(b->first);
+    });
+
+    std::vector<std::string> addrs;
+    addrs.reserve(sorted.size());
+    printf("\n--- 广播/组播发现 ---\n");
+    printf("%-40s %-40s %6s %10s\n", "主机", "发现于", "回复", "最小(ms)");
+    for (const auto* kv : sorted) {
+        addrs.push_back(kv->first);
+        printf("%-40s %-40s %6llu %10lu\n", kv->first.c_str(), targets[kv->second.target].c_str(),
+               (unsigned long long)kv->second.replies, (unsigned long)kv->second.min_rtt_ms);
+    }
+    printf("请求 %llu 个, 回复 %llu 个 (重复 %llu 个)\n",
+           (unsigned long long)probes_, (unsigned long long)replies_,
+           (unsigned long long)duplicates_);
+    printf("发现主机 (%zu): %s\n", addrs.size(), compress_ip_ranges(addrs).c_str());
+}
+
+} // namespace qping
@@ -0,0 +1,253 @@
+/**
+ * @file exclude.cpp
+ * @brief 排除列表模块 - 大规模禁止探测地址的紧凑存储与查询
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --exclude-file 选项和 qping build-exclude 子命令，包括：
+ * - 从文本列表构建排除文件（分块 Bloom 过滤器 + 排序地址数组）
+ * - 以内存映射方式只读加载，不解析、不拷贝
+ * - 先查 Bloom 过滤器，命中时再二分查找排序数组确认
+ *
+ * 每个地址只占 4 字节加约 10 位过滤器，两千万个地址的文件约 100MB，
+ * 加载时间与文件大小无关；不在列表中的地址通常只需访问一个缓存行。
+ */
+
+#include "qping.h"
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/**
+ * @brief 64 位混合函数（splitmix64 的最终化步骤）
+ */
+static uint64_t exclude_hash(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief 地址所在过滤器块的起始字（64 位）下标，以及块内各位的位置
+ *
+ * 第一个哈希的高 32 位按乘法映射到块序号，第二个哈希每 9 位给出块内
+ * 512 位中的一个位置，共 EXCLUDE_BLOOM_HASHES 个。
+ */
+static size_t bloom_block(uint32_t block_count, uint32_t addr, uint64_t& bits) {
+    uint64_t h = exclude_hash(addr);
+    uint32_t block = (uint32_t)(((h >> 32) * block_count) >> 32);
+    bits = exclude_hash(h);
+    return (size_t)block * (EXCLUDE_BLOCK_BYTES / 8);
+}
+
+//=============================================================================
+// 构建
+//=============================================================================
+
+/**
+ * @brief 从文本列表构建排除文件
+ *
+ * 每行一个目标（与命令行目标相同的 IPv4 格式，可以是范围或 CIDR），
+ * 空行和 # 开头的注释行忽略。地址排序去重后写入临时文件，完成后
+ * 替换目标文件。
+ */
+bool build_exclude_file(const std::string& input, const std::string& output,
+                        uint64_t& count, uint64_t& bytes) {
+    FILE* in = fopen(input.c_str(), "r");
+    if (!in) {
+        fprintf(stderr, "无法打开排除列表: %s\n", input.c_str());
+        return false;
+    }
+
+    std::vector<uint32_t> addrs;
+    std::vector<TargetSpec> specs;
+    char line[256];
+    size_t line_no = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), in)) {
+        line_no++;
+        size_t len = strcspn(line, "\r\n#");
+        while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+            len--;
+        }
+        size_t start = strspn(line, " \t");
+        if (start >= len) {
+            continue;
+        }
+
+        specs.clear();
+        if (!tokenize_targets(TextView(line + start, len - start), specs, UINT64_MAX)) {
+            fprintf(stderr, "排除列表第 %zu 行无效\n", line_no);
+            ok = false;
+            break;
+        }
+        for (const auto& spec : specs) {
+            if (spec.kind != TARGET_IPV4_RANGE) {
+                fprintf(stderr, "排除列表第 %zu 行: 仅支持IPv4地址\n", line_no);
+                ok = false;
+                break;
+            }
+            for (uint64_t v = spec.first; v <= spec.last; ++v) {
+                addrs.push_back((uint32_t)v);
+            }
+        }
+    }
+    fclose(in);
+    if (!ok) {
+        return false;
+    }
+
+    std::sort(addrs.begin(), addrs.end());
+    addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+    count = addrs.size();
+
+    //-------------------------------------------------------------------------
+    // 构建分块 Bloom 过滤器
+    //-------------------------------------------------------------------------
+    uint64_t bits_needed = std::max<uint64_t>(1, count) * EXCLUDE_BLOOM_BITS_PER_ENTRY;
+    uint32_t block_count = (uint32_t)((bits_needed + EXCLUDE_BLOCK_BYTES * 8 - 1) /
+                                      (EXCLUDE_BLOCK_BYTES * 8));
+    std::vector<uint64_t> bloom((size_t)block_count * (EXCLUDE_BLOCK_BYTES / 8), 0);
+    for (uint32_t addr : addrs) {
+        uint64_t bits;
+        uint64_t* block = bloom.data() + bloom_block(block_count, addr, bits);
+        for (int k = 0; k < EXCLUDE_BLOOM_HASHES; ++k, bits >>= 9) {
+            uint32_t pos = (uint32_t)(bits & 511);
+            block[pos >> 6] |= 1ull << (pos & 63);
+        }
+    }
+
+    ExcludeFileHeader header = {};
+    header.magic = EXCLUDE_MAGIC;
+    header.version = EXCLUDE_VERSION;
+    header.count = count;
+    header.block_count = block_count;
+    header.hash_count = EXCLUDE_BLOOM_HASHES;
+    header.bloom_offset = EXCLUDE_BLOCK_BYTES;
+    header.array_offset = header.bloom_offset + (uint64_t)block_count * EXCLUDE_BLOCK_BYTES;
+    bytes = header.array_offset + count * 4;
+
+    //-------------------------------------------------------------------------
+    // 写入：头部占一个块，过滤器按块对齐，随后是排序数组
+    //-------------------------------------------------------------------------
+    std::string data(EXCLUDE_BLOCK_BYTES, '\0');
+    data.reserve((size_t)bytes);
+    memcpy(&data[0], &header, sizeof(header));
+    data.append((const char*)bloom.data(), bloom.size() * 8);
+    data.append((const char*)addrs.data(), addrs.size() * 4);
+    if (!atomic_write_file(output, data)) {
+        fprintf(stderr, "无法写入排除文件: %s\n", output.c_str());
+        return false;
+    }
+    return true;
+}
+
+//=============================================================================
+// 加载与查询
+//=============================================================================
+
+/**
+ * @brief 映射排除文件并校验头部和各段边界
+ */
+bool ExcludeFilter::open(const std::string& path) {
+    close();
+
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "无法打开排除文件: %s\n", path.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart < (LONGLONG)EXCLUDE_BLOCK_BYTES) {
+        fprintf(stderr, "排除文件过小或无法读取: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+        base_ = (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!base_) {
+        fprintf(stderr, "无法映射排除文件: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    // 过滤器块紧跟头部块且按块对齐，排序数组紧跟最后一个过滤器块
+    ExcludeFileHeader header;
+    memcpy(&header, base_, sizeof(header));
+    uint64_t file_size = (uint64_t)size.QuadPart;
+    bool valid = header.magic == EXCLUDE_MAGIC && header.version == EXCLUDE_VERSION &&
+                 header.hash_count == EXCLUDE_BLOOM_HASHES && header.block_count > 0 &&
+                 header.bloom_offset >= EXCLUDE_BLOCK_BYTES &&
+                 header.bloom_offset % EXCLUDE_BLOCK_BYTES == 0 &&
+                 section_in_file(header.bloom_offset, header.block_count, EXCLUDE_BLOCK_BYTES, file_size) &&
+                 header.array_offset == header.bloom_offset +
+                                        (uint64_t)header.block_count * EXCLUDE_BLOCK_BYTES &&
+                 section_in_file(header.array_offset, header.count, 4, file_size);
+    if (!valid) {
+        fprintf(stderr, "排除文件格式无效: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    bloom_ = (const uint64_t*)(base_ + header.bloom_offset);
+    block_count_ = header.block_count;
+    addrs_ = (const uint32_t*)(base_ + header.array_offset);
+    count_ = (size_t)header.count;
+    return true;
+}
+
+/**
+ * @brief 解除映射并关闭文件
+ */
+void ExcludeFilter::close() {
+    if (base_) {
+        UnmapViewOfFile(base_);
+        base_ = nullptr;
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    bloom_ = nullptr;
+    addrs_ = nullptr;
+    block_count_ = 0;
+    count_ = 0;
+}
+
+/**
+ * @brief 查询地址是否在排除列表中
+ *
+ * 过滤器的全部位都在同一个 64 字节块内；任一位为 0 即可确定不在列表中，
+ * 全部为 1 时再二分查找排序数组排除误判。
+ */
+bool ExcludeFilter::contains(uint32_t addr) const {
+    if (!bloom_) {
+        return false;
+    }
+    uint64_t bits;
+    const uint64_t* block = bloom_ + bloom_block(block_count_, addr, bits);
+    for (int k = 0; k < EXCLUDE_BLOOM_HASHES; ++k, bits >>= 9) {
+        uint32_t pos = (uint32_t)(bits & 511);
+        if (!(block[pos >> 6] & (1ull << (pos & 63)))) {
+            return false;
+        }
+    }
+    return std::binary_search(addrs_, addrs_ + count_, addr);
+}
+
+} // namespace qping
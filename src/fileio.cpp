@@ -0,0 +1,91 @@
+/**
+ * @file fileio.cpp
+ * @brief 文件工具模块 - 各文件格式共用的编码和写入辅助函数
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了归档、草图、排除列表、目标集和存活缓存共用的：
+ * - 无符号 varint 编码和解码
+ * - 先写临时文件再替换的原子写入
+ * - 映射文件中各段的边界校验
+ */
+
+#include "qping.h"
+
+namespace qping {
+
+//=============================================================================
+// varint 编码
+//=============================================================================
+
+/**
+ * @brief 追加无符号 varint（每字节 7 位，最高位表示后续还有字节）
+ */
+void put_varint(std::string& buf, uint64_t v) {
+    while (v >= 0x80) {
+        buf.push_back((char)((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((char)v);
+}
+
+/**
+ * @brief 读取无符号 varint
+ */
+bool get_varint(const unsigned char*& p, const unsigned char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char b = *p++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//=============================================================================
+// 原子写入
+//=============================================================================
+
+/**
+ * @brief 写入 path.tmp 后替换 path
+ *
+ * 写入或关闭失败时删除临时文件，原文件保持不变；读者要么看到旧文件，
+ * 要么看到完整的新文件。
+ */
+bool atomic_write_file(const std::string& path, const std::string& data) {
+    std::string tmp = path + ".tmp";
+    FILE* out = fopen(tmp.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    bool ok = data.empty() || fwrite(data.data(), 1, data.size(), out) == data.size();
+    ok = (fclose(out) == 0) && ok;
+    if (ok) {
+        ok = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+    }
+    if (!ok) {
+        remove(tmp.c_str());
+    }
+    return ok;
+}
+
+//=============================================================================
+// 边界校验
+//=============================================================================
+
+/**
+ * @brief 检查 count 个 elem_size 字节的元素从 offset 起是否完整落在文件内
+ *
+ * 先确认 offset 不超过文件大小，再把元素数与剩余长度能容纳的元素数
+ * 比较，不计算 offset + count * elem_size，头部中构造的大数无法借
+ * 乘法或加法回绕通过校验。
+ */
+bool section_in_file(uint64_t offset, uint64_t count, uint64_t elem_size, uint64_t file_size) {
+    return elem_size > 0 && offset <= file_size && count <= (file_size - offset) / elem_size;
+}
+
+} // namespace qping
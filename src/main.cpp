@@ -82,9 +82,57 @@ void print_usage(const char* prog) {
     printf("  --concurrency N                并发线程数(默认 %d)\n", DEFAULT_CONCURRENCY);
     printf("  --force                        允许扫描超过 %u 个目标\n", MAX_HOSTS_DEFAULT);
     printf("  --exclude ip[,ip...]           排除逗号分隔的IP列表\n");
+    printf("  --exclude-file FILE            排除 build-exclude 生成的大规模禁止探测列表\n");
+    printf("  --target-set FILE              加入 compile-targets 生成的目标集(可重复，可与普通目标混用)\n");
+    printf("  --window W                     每个目标最多 W 个在途探测(1-%d)，按序列号配对\n", MAX_WINDOW);
+    printf("  --interval ms                  同一目标相邻两次探测的间隔(毫秒，默认 1000)\n");
+    printf("  --size-sweep min:max:step      按多个负载大小交错探测，报告RTT-大小斜率和开始丢包的大小\n");
+    printf("  --discover                     收集广播/组播目标(如 192.168.1.255、ff02::1)每个请求的全部回复，列出发现的主机\n");
+    printf("  --flows N                      每个目标轮换 N 个流(1-%d)各探测 -n 次，报告各等价路径的丢包和RTT\n", MAX_FLOWS);
+    printf("  --simulate-ecmp P:B:L          配合 --flows：模拟按负载散列到 P 条路径的负载均衡，路径 B 丢包 L%%(用于验证)\n");
+    printf("  --sample-rate R                抽样模式：按随机顺序最多探测范围内比例 R 的地址(0-1)，估计在线比例\n");
+    printf("  --confidence C                 抽样模式：置信水平 C(如 0.95)，区间足够窄时提前停止\n");
+    printf("  --margin M                     提前停止的区间半宽(在线比例，默认 %.2f)\n", SAMPLE_DEFAULT_MARGIN);
+    printf("  --flood PPS                    洪泛模式：速率分 %d 级递增到 PPS(最大 %d)，报告开始丢包点\n",
+           FLOOD_RAMP_STEPS, FLOOD_MAX_PPS);
+    printf("  --aimd                         按已知在线目标的丢失率自适应调整速率和在途数(加性增长、乘性回退)\n");
+    printf("  --prefix-rate PPS              发往同一前缀的速率上限，令牌不足时先探测其他前缀的目标\n");
+    printf("  --prefix-len N                 --prefix-rate 使用的IPv4前缀长度(8-32，默认 %d，32 即每个地址)\n",
+           PREFIX_DEFAULT_LEN);
+    printf("  --cpus LIST                    将引擎线程绑定到指定CPU(如 0-3,6 或 all)，每核一个线程\n");
+    printf("  --scaling                      多核扩展性测试：线程数从 1 倍增到CPU数，报告各级回复速率\n");
+    printf("  --busy-poll                    引擎线程忙轮询完成事件，不睡眠（降低RTT测量抖动，占满CPU）\n");
+    printf("  --rtt-floor                    测量本机回环RTT在阻塞等待和忙轮询下的分布（无需目标）\n");
+    printf("  --bench-options                比较无IP选项特化探测路径与通用选项路径的开销（无需目标）\n");
+    printf("  --send-timing                  将每次RTT分解为qping发送延迟和网络往返，结束时报告两者分布\n");
+    printf("  --quorum K                     健康检查：至少 K 个目标在线即成功，结论确定后立即返回并取消在途探测\n");
+    printf("  --any                          等同于 --quorum 1\n");
+    printf("  --all                          要求全部目标在线，任一目标失败即返回\n");
+    printf("  --select-best                  并行探测候选并逐次淘汰明显较慢者，输出RTT最低的端点(best=...)\n");
+    printf("  --pcap FILE                    将发送和接收的ICMP数据包写入pcap文件\n");
+    printf("  --archive DIR                  将每次探测结果追加到DIR中的列式历史归档(按小时分段)\n");
+    printf("  --shm NAME                     在命名共享内存中发布每个目标的实时计数和RTT直方图\n");
+    printf("  --sketch FILE                  将每个目标的计数和可合并的RTT草图写入结果文件(分位数相对误差 ≤1%%)\n");
+    printf("  --cache FILE                   在FILE中保存每个地址最近的在线结论，供后续运行复用\n");
+    printf("  --max-age SEC                  配合 --cache：SEC 秒内探测过的目标直接使用缓存结论，只探测其余目标\n");
+    printf("  --replay-pcap FILE             离线回放pcap文件中的请求和回复并输出统计\n");
     printf("  -h, --help                     显示此帮助信息\n");
     printf("  --version                      显示版本信息\n");
 
+    printf("\n历史查询:\n");
+    printf("  %s query --archive DIR --target IP [--from 时间] [--to 时间]\n", prog);
+    printf("                                 从归档读取一个目标的探测记录；时间为本地时间\n");
+    printf("                                 YYYY-MM-DD[ HH:MM[:SS]] 或 Unix 秒数\n");
+
+    printf("\n实时统计:\n");
+    printf("  %s shm NAME                    读取正在运行的 qping 通过 --shm 发布的实时统计\n", prog);
+
+    printf("\n文件工具:\n");
+    printf("  %s build-exclude INPUT OUTPUT  将每行一个IPv4目标的文本列表编译为 --exclude-file 文件\n", prog);
+    printf("  %s compile-targets OUTPUT [--exclude ip,...] [--exclude-file FILE] 目标...\n", prog);
+    printf("                                 将IPv4目标规范化后编译为 --target-set 文件\n");
+    printf("  %s merge [-o OUTPUT] FILE...   合并多个 --sketch 结果文件，输出各目标和全局的RTT分位数\n", prog);
+
     printf("\n域名解析:\n");
     printf("  - 支持ping域名（如 google.com），自动进行DNS解析\n");
     printf("  - 使用 -4 强制解析为IPv4地址\n");
@@ -96,6 +144,130 @@ void print_usage(const char* prog) {
     printf("  %s -n 5 -l 64 192.168.0.1\n", prog);
     printf("  %s 192.168.1.1/24\n", prog);
     printf("  %s --concurrency 200 192.168.1.1/24\n", prog);
+    printf("  %s --size-sweep 64:1472:64 -f 192.168.0.1\n", prog);
+    printf("  %s --discover 192.168.1.255\n", prog);
+    printf("  %s -n 20 --flows 8 --interval 50 192.168.0.1\n", prog);
+    printf("  %s -n 50 --flows 8 --interval 10 --simulate-ecmp 4:1:50 127.0.0.1\n", prog);
+    printf("  %s --flood 20000 127.0.0.1\n", prog);
+    printf("  %s --confidence 0.95 --margin 0.005 10.0.0.0/8\n", prog);
+    printf("  %s --aimd --cache qping.cache --force 10.0.0.0/16\n", prog);
+    printf("  %s --prefix-rate 20 --force 10.0.0.0/16\n", prog);
+}
+
+//=============================================================================
+// 统计输出函数实现
+//=============================================================================
+
+/**
+ * @brief 输出回复中的记录路由和时间戳信息
+ * @param result Ping 结果
+ */
+static void print_option_results(const PingResult& result) {
+    // 输出记录路由信息
+    if (!result.route_hops.empty()) {
+        printf("    路由: ");
+        for (size_t i = 0; i < result.route_hops.size(); ++i) {
+            if (i > 0) printf(" -> ");
+            printf("%s", result.route_hops[i].c_str());
+        }
+        printf("\n");
+    }
+
+    // 输出时间戳信息
+    if (!result.timestamps.empty()) {
+        printf("    时间戳: ");
+        for (size_t i = 0; i < result.timestamps.size(); ++i) {
+            if (i > 0) printf(", ");
+            printf("%ums", result.timestamps[i]);
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * @brief 输出每个目标和汇总的统计信息，以及在线/失败设备列表
+ *
+ * 实时探测和 --replay-pcap 回放共用此函数。
+ *
+ * @param targets 目标地址列表
+ * @param stats 每个目标的统计数据，与 targets 一一对应
+ * @return 接收到的回复总数
+ */
+uint64_t print_statistics(const std::vector<std::string>& targets,
+                          const std::vector<TargetStat>& stats) {
+    printf("\n--- 统计信息 ---\n");
+
+    uint64_t total_sent = 0, total_recv = 0;
+    std::vector<std::string> online_ips;   // 在线设备列表
+    std::vector<std::string> failed_ips;   // 失败设备列表
+
+    // 收集统计数据并分类设备
+    for (size_t i = 0; i < targets.size(); ++i) {
+        uint64_t s = stats[i].sent.load();
+        uint64_t r = stats[i].recv.load();
+        uint64_t late = stats[i].late.load();
+        uint64_t lost = (s > r) ? (s - r) : 0;
+        double pct = (s > 0) ? (100.0 * lost / s) : 0.0;
+
+        printf("%s : 已发送=%llu, 已接收=%llu, 丢失=%llu (%.1f%%)",
+               targets[i].c_str(), (unsigned long long)s,
+               (unsigned long long)r, (unsigned long long)lost, pct);
+        // 迟到回复已计入丢失，单独列出便于区分真丢包和高延迟
+        if (late > 0) {
+            printf(", 其中迟到=%llu", (unsigned long long)late);
+        }
+        printf("\n");
+
+        total_sent += s;
+        total_recv += r;
+
+        // 分类：至少收到一个回复为在线，否则为失败
+        if (r > 0) {
+            online_ips.push_back(targets[i]);
+        } else {
+            failed_ips.push_back(targets[i]);
+        }
+    }
+
+    // 输出汇总统计
+    uint64_t total_lost = (total_sent > total_recv) ? (total_sent - total_recv) : 0;
+    double total_pct = (total_sent > 0) ? (100.0 * total_lost / total_sent) : 0.0;
+
+    printf("\n数据包统计: 发送=%llu, 接收=%llu, 丢失=%llu (%.1f%%)\n",
+           (unsigned long long)total_sent, (unsigned long long)total_recv,
+           (unsigned long long)total_lost, total_pct);
+
+    // 输出在线/失败设备列表（使用范围压缩格式）
+    printf("\n在线设备 (%zu): %s\n",
+           online_ips.size(), compress_ip_ranges(online_ips).c_str());
+    printf("失败设备 (%zu): %s\n",
+           failed_ips.size(), compress_ip_ranges(failed_ips).c_str());
+
+    return total_recv;
+}
+
+/**
+ * @brief 输出直接取自存活缓存的目标结论（--max-age）
+ * @param targets 命中缓存的目标
+ * @param entries 对应的缓存结论
+ * @return 在线目标数
+ */
+static uint64_t print_cached_results(const std::vector<std::string>& targets,
+                                     const std::vector<qping::LivenessEntry>& entries) {
+    using namespace qping;
+
+    std::vector<std::string> online_ips, failed_ips;
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        (entries[i].alive ? online_ips : failed_ips).push_back(targets[i]);
+        oldest = std::min(oldest, entries[i].time_ms);
+    }
+    uint64_t now = PcapWriter::now_ns() / 1000000;
+    printf("\n--- 缓存结论 (%zu 个目标, 最早 %.0f 秒前) ---\n", targets.size(),
+           (now - std::min(now, oldest)) / 1000.0);
+    printf("在线设备 (%zu): %s\n", online_ips.size(), compress_ip_ranges(online_ips).c_str());
+    printf("失败设备 (%zu): %s\n", failed_ips.size(), compress_ip_ranges(failed_ips).c_str());
+    return online_ips.size();
 }
 
 //=============================================================================
@@ -332,6 +504,258 @@ static BOOL WINAPI win_console_handler(DWORD ctrl_type) {
 // 主函数
 //=============================================================================
 
+/**
+ * @brief 执行 query 子命令：从历史归档中读取一个目标的记录
+ * @param argc 命令行参数数量
+ * @param argv 命令行参数数组（argv[1] 为 "query"）
+ * @return 退出码：0 有记录，1 无记录，2 参数或归档错误
+ */
+static int run_query(int argc, char** argv) {
+    using namespace qping;
+
+    std::string dir, target;
+    uint64_t from_ms = 0, to_ms = UINT64_MAX;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--archive" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--target" && i + 1 < argc) {
+            target = argv[++i];
+        } else if ((arg == "--from" || arg == "--to") && i + 1 < argc) {
+            uint64_t& v = (arg == "--from") ? from_ms : to_ms;
+            if (!parse_time_arg(argv[++i], v)) {
+                fprintf(stderr, "无效的时间: %s\n", argv[i]);
+                return 2;
+            }
+        } else {
+            fprintf(stderr, "未知的查询参数: %s\n", arg.c_str());
+            return 2;
+        }
+    }
+    if (dir.empty() || target.empty()) {
+        fprintf(stderr, "用法: %s query --archive DIR --target IP [--from 时间] [--to 时间]\n", argv[0]);
+        return 2;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<HistorySample> samples;
+    size_t segments = 0;
+    if (!query_archive(dir, target, from_ms, to_ms, samples, segments)) {
+        return 2;
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+
+    uint64_t recv = 0, rtt_sum = 0;
+    uint32_t rtt_min = UINT32_MAX, rtt_max = 0;
+    for (const auto& s : samples) {
+        if (s.success) {
+            printf("%s  来自 %s 的回复: 时间=%.2fms\n", format_time_ms(s.timestamp_ms).c_str(),
+                   target.c_str(), s.rtt_us / 1000.0);
+            recv++;
+            rtt_sum += s.rtt_us;
+            rtt_min = std::min(rtt_min, s.rtt_us);
+            rtt_max = std::max(rtt_max, s.rtt_us);
+        } else {
+            printf("%s  请求超时 %s\n", format_time_ms(s.timestamp_ms).c_str(), target.c_str());
+        }
+    }
+
+    printf("\n--- %s 的历史记录 ---\n", target.c_str());
+    printf("记录=%zu, 接收=%llu, 丢失=%llu (%.1f%%)\n", samples.size(),
+           (unsigned long long)recv, (unsigned long long)(samples.size() - recv),
+           samples.empty() ? 0.0 : 100.0 * (samples.size() - recv) / samples.size());
+    if (recv > 0) {
+        printf("往返时间: 最短=%.2fms, 最长=%.2fms, 平均=%.2fms\n",
+               rtt_min / 1000.0, rtt_max / 1000.0, rtt_sum / 1000.0 / recv);
+    }
+    printf("读取分段 %zu 个, 耗时 %.2fms\n", segments, elapsed);
+    return samples.empty() ? 1 : 0;
+}
+
+/**
+ * @brief 执行 shm 子命令：读取共享内存中的实时统计快照
+ * @param argc 命令行参数数量
+ * @param argv 命令行参数数组（argv[1] 为 "shm"）
+ * @return 退出码：0 成功，2 参数错误或共享内存不可读
+ */
+static int run_shm_reader(int argc, char** argv) {
+    using namespace qping;
+
+    if (argc != 3) {
+        fprintf(stderr, "用法: %s shm NAME\n", argv[0]);
+        return 2;
+    }
+
+    ShmHeader header;
+    std::vector<ShmRecord> records;
+    if (!read_shared_stats(argv[2], header, records)) {
+        return 2;
+    }
+
+    uint64_t now = PcapWriter::now_ns() / 1000000;
+    printf("共享内存: %s (进程 %u, %s, 心跳 %.1f 秒前, 已运行 %.0f 秒)\n", argv[2],
+           header.pid, header.state == SHM_STATE_FINISHED ? "已结束" : "运行中",
+           (now - std::min(now, (uint64_t)header.heartbeat_ms)) / 1000.0,
+           (now - std::min(now, header.start_ms)) / 1000.0);
+
+    for (const auto& r : records) {
+        printf("%s : 完成=%llu, 接收=%llu, 迟到=%llu, 丢失=%.1f%%", r.addr,
+               (unsigned long long)r.completed, (unsigned long long)r.received,
+               (unsigned long long)r.late,
+               r.completed ? 100.0 * (r.completed - r.received) / r.completed : 0.0);
+        if (r.received > 0) {
+            // 由直方图估计分位数（取所在桶的上界）
+            uint64_t p50 = 0, p99 = 0, acc = 0;
+            for (int b = 0; b < SHM_HIST_BUCKETS; ++b) {
+                acc += r.hist[b];
+                if (!p50 && acc * 2 >= r.received) {
+                    p50 = 2ull << b;
+                }
+                if (!p99 && acc * 100 >= r.received * 99) {
+                    p99 = 2ull << b;
+                }
+            }
+            printf(", RTT 最短=%.2fms 平均=%.2fms 最长=%.2fms P50<%.2fms P99<%.2fms",
+                   r.min_rtt_us / 1000.0, r.rtt_sum_us / 1000.0 / r.received,
+                   r.max_rtt_us / 1000.0, p50 / 1000.0, p99 / 1000.0);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+/**
+ * @brief 执行 build-exclude 子命令：将文本排除列表编译为排除文件
+ * @param argc 命令行参数数量
+ * @param argv 命令行参数数组（argv[1] 为 "build-exclude"）
+ * @return 退出码：0 成功，2 参数错误或读写失败
+ */
+static int run_build_exclude(int argc, char** argv) {
+    using namespace qping;
+
+    if (argc != 4) {
+        fprintf(stderr, "用法: %s build-exclude INPUT OUTPUT\n", argv[0]);
+        return 2;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t count = 0, bytes = 0;
+    if (!build_exclude_file(argv[2], argv[3], count, bytes)) {
+        return 2;
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+
+    printf("已写入 %s: 地址 %llu 个, 约 %.1fMB, 耗时 %.2fms\n", argv[3],
+           (unsigned long long)count, bytes / 1048576.0, elapsed);
+    return 0;
+}
+
+/**
+ * @brief 执行 compile-targets 子命令：把目标参数编译为目标集文件
+ * @param argc 命令行参数数量
+ * @param argv 命令行参数数组（argv[1] 为 "compile-targets"）
+ * @return 退出码：0 成功，2 参数错误或读写失败
+ */
+static int run_compile_targets(int argc, char** argv) {
+    using namespace qping;
+
+    if (argc < 4) {
+        fprintf(stderr, "用法: %s compile-targets OUTPUT [--exclude ip,...] [--exclude-file FILE] 目标...\n",
+                argv[0]);
+        return 2;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<TargetSpec> specs;
+    std::vector<uint32_t> excluded;
+    ExcludeFilter exclude_filter;
+    std::string source;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--exclude" && i + 1 < argc) {
+            for (const auto& e : split(argv[++i], ',')) {
+                if (e.empty()) {
+                    continue;
+                }
+                if (!is_valid_ipv4_address(e)) {
+                    fprintf(stderr, "目标集仅支持IPv4排除地址: %s\n", e.c_str());
+                    return 2;
+                }
+                excluded.push_back(ip_to_uint32(e));
+            }
+            continue;
+        }
+        if (arg == "--exclude-file" && i + 1 < argc) {
+            if (!exclude_filter.open(argv[++i])) {
+                return 2;
+            }
+            continue;
+        }
+        if (!tokenize_targets(TextView(argv[i]), specs, UINT64_MAX)) {
+            return 2;
+        }
+        source += source.empty() ? arg : " " + arg;
+    }
+    std::sort(excluded.begin(), excluded.end());
+    excluded.erase(std::unique(excluded.begin(), excluded.end()), excluded.end());
+
+    uint64_t hosts = 0, bytes = 0;
+    if (!compile_target_set(specs, excluded, exclude_filter, source, argv[2], hosts, bytes)) {
+        return 2;
+    }
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+    printf("已写入 %s: 地址 %llu 个, %.1fKB, 耗时 %.2fms\n", argv[2],
+           (unsigned long long)hosts, bytes / 1024.0, elapsed);
+    return 0;
+}
+
+/**
+ * @brief 执行 merge 子命令：合并多个分片的延迟草图结果文件
+ * @param argc 命令行参数数量
+ * @param argv 命令行参数数组（argv[1] 为 "merge"）
+ * @return 退出码：0 成功，2 参数错误或读写失败
+ */
+static int run_merge(int argc, char** argv) {
+    using namespace qping;
+
+    std::string output;
+    std::vector<std::string> inputs;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+            continue;
+        }
+        inputs.push_back(arg);
+    }
+    if (inputs.empty()) {
+        fprintf(stderr, "用法: %s merge [-o OUTPUT] FILE...\n", argv[0]);
+        return 2;
+    }
+
+    LatencyResults results;
+    for (const auto& path : inputs) {
+        if (!results.load(path)) {
+            return 2;
+        }
+    }
+    results.print_report();
+
+    if (!output.empty()) {
+        uint64_t bytes = 0;
+        if (!results.save(output, bytes)) {
+            return 2;
+        }
+        printf("\n已写入 %s: 分片 %zu 个, 目标 %zu 个, 样本 %llu 个, %.1fKB\n", output.c_str(),
+               inputs.size(), results.size(), (unsigned long long)results.sample_count(),
+               bytes / 1024.0);
+    }
+    return 0;
+}
+
 /**
  * @brief 程序入口点
  *
@@ -410,6 +834,23 @@ int main(int argc, char** argv) {
         return 2;
     }
     
+    // 子命令：历史查询不需要网络，直接执行
+    if (std::string(argv[1]) == "query") {
+        return run_query(argc, argv);
+    }
+    if (std::string(argv[1]) == "shm") {
+        return run_shm_reader(argc, argv);
+    }
+    if (std::string(argv[1]) == "build-exclude") {
+        return run_build_exclude(argc, argv);
+    }
+    if (std::string(argv[1]) == "compile-targets") {
+        return run_compile_targets(argc, argv);
+    }
+    if (std::string(argv[1]) == "merge") {
+        return run_merge(argc, argv);
+    }
+
     // 快速检查帮助和版本选项，避免在这些情况下预热
     if (argc == 2) {
         std::string arg = argv[1];
@@ -437,17 +878,48 @@ int main(int argc, char** argv) {
     // 运行参数
     int concurrency = DEFAULT_CONCURRENCY;  ///< 并发线程数
     int count_per_target = 1;               ///< 每个目标的 Ping 次数（0=无限）
+    bool count_set = false;                 ///< 是否显式指定了 -n 或 -t
     bool force = false;                     ///< 是否强制允许大量目标
     bool resolve_names = false;             ///< 是否解析主机名
     bool force_ipv4 = false;                ///< 强制使用 IPv4
     bool force_ipv6 = false;                ///< 强制使用 IPv6
+    std::string pcap_path;                  ///< pcap 导出文件路径（--pcap）
+    std::string replay_path;                ///< pcap 回放文件路径（--replay-pcap）
+    std::string archive_dir;                ///< 历史归档目录（--archive）
+    std::string shm_name;                   ///< 共享内存名（--shm）
+    std::string exclude_path;               ///< 排除文件路径（--exclude-file）
+    std::vector<std::string> target_set_paths; ///< 目标集文件路径（--target-set）
+    std::string cache_path;                 ///< 存活缓存文件路径（--cache）
+    std::string sketch_path;                ///< 延迟草图结果文件路径（--sketch）
+    int max_age_s = -1;                     ///< 缓存结论的最长有效期（秒，-1=不复用）
+    int quorum = 0;                         ///< 需要在线的目标数（0=关闭，-1=全部）
+    bool select_best = false;               ///< 是否选择最优端点（--select-best）
+    int window = 0;                         ///< 每目标在途探测数（0=传统工作线程模式）
+    int interval_ms = 1000;                 ///< 同一目标的探测间隔（毫秒）
+    bool interval_set = false;              ///< 是否显式指定了 --interval
+    int flood_pps = 0;                      ///< 洪泛模式速率上限（0=关闭）
+    bool aimd = false;                      ///< 是否按丢失率自适应调整速率（--aimd）
+    int prefix_rate = 0;                    ///< 发往同一前缀的速率上限（0=不限，--prefix-rate）
+    int prefix_len = PREFIX_DEFAULT_LEN;    ///< 限速所用的 IPv4 前缀长度（--prefix-len）
+    std::vector<int> sweep_sizes;           ///< 负载大小扫描序列（--size-sweep）
+    std::vector<int> cpus;                  ///< 引擎线程绑定的 CPU（--cpus）
+    bool scaling = false;                   ///< 是否运行多核扩展性测试（--scaling）
+    bool busy_poll = false;                 ///< 引擎线程是否忙轮询（--busy-poll）
+    bool rtt_floor = false;                 ///< 是否运行本机 RTT 下限测量（--rtt-floor）
+    bool send_timing = false;               ///< 是否分解发送延迟和网络往返（--send-timing）
+    int flows = 0;                          ///< 每目标轮换的流数（--flows）
+    int ecmp_paths = 0, ecmp_bad_path = 0, ecmp_loss = 0;  ///< 模拟 ECMP 参数（--simulate-ecmp）
+    bool discover = false;                  ///< 是否收集广播/组播目标的全部回复（--discover）
+    bool bench_options = false;             ///< 是否运行选项特化基准测试（--bench-options）
+    bool sample_mode = false;               ///< 是否为抽样模式（--sample-rate / --confidence）
+    SampleConfig sample_cfg;                ///< 抽样参数
 
     // Ping 配置选项
     PingOptions opts;
 
     // 排除列表和目标列表
     std::unordered_set<std::string> exclude_set;
-    std::vector<std::string> tokens;
+    std::vector<TextView> tokens;           ///< 目标参数（指向 argv）
 
     //=========================================================================
     // 解析命令行参数
@@ -483,108 +955,300 @@ int main(int argc, char** argv) {
             force = true;
             continue;
         }
-        if (arg == "--exclude" && i + 1 < argc) {
-            auto eps = split(argv[++i], ',');
-            for (auto& e : eps) {
-                if (!e.empty()) {
-                    exclude_set.insert(e);
-                }
-            }
+        if (arg == "--pcap" && i + 1 < argc) {
+            pcap_path = argv[++i];
             continue;
         }
-
-        //---------------------------------------------------------------------
-        // 标准 Ping 选项
-        //---------------------------------------------------------------------
-        if (arg == "-t") {
-            // 持续 Ping 模式
-            count_per_target = 0;
+        if (arg == "--shm" && i + 1 < argc) {
+            shm_name = argv[++i];
             continue;
         }
-        if (arg == "-n" && i + 1 < argc) {
-            // 指定 Ping 次数
-            int v;
-            if (!parse_int(argv[++i], v) || v <= 0) {
-                fprintf(stderr, "无效的计数\n");
+        if (arg == "--archive" && i + 1 < argc) {
+            archive_dir = argv[++i];
+            continue;
+        }
+        if (arg == "--quorum" && i + 1 < argc) {
+            if (!parse_int(argv[++i], quorum) || quorum < 1) {
+                fprintf(stderr, "无效的法定数量\n");
                 return 2;
             }
-            count_per_target = v;
             continue;
         }
-        if (arg == "-w" && i + 1 < argc) {
-            // 超时时间
-            int v;
-            if (!parse_int(argv[++i], v) || v <= 0) {
-                fprintf(stderr, "无效的超时时间\n");
+        if (arg == "--discover") {
+            discover = true;
+            continue;
+        }
+        if (arg == "--select-best") {
+            select_best = true;
+            continue;
+        }
+        if (arg == "--any") {
+            quorum = 1;
+            continue;
+        }
+        if (arg == "--all") {
+            quorum = -1;
+            continue;
+        }
+        if (arg == "--cache" && i + 1 < argc) {
+            cache_path = argv[++i];
+            continue;
+        }
+        if (arg == "--sketch" && i + 1 < argc) {
+            sketch_path = argv[++i];
+            continue;
+        }
+        if (arg == "--max-age" && i + 1 < argc) {
+            if (!parse_int(argv[++i], max_age_s) || max_age_s < 0) {
+                fprintf(stderr, "无效的缓存有效期(秒)\n");
                 return 2;
             }
-            opts.timeout_ms = v;
             continue;
         }
-        if (arg == "-a") {
-            // 解析主机名
-            resolve_names = true;
+        if (arg == "--replay-pcap" && i + 1 < argc) {
+            replay_path = argv[++i];
             continue;
         }
-        if (arg == "-l" && i + 1 < argc) {
-            // 负载大小
+        if (arg == "--window" && i + 1 < argc) {
             int v;
-            if (!parse_int(argv[++i], v) || v < 0 || v > MAX_PAYLOAD_SIZE) {
-                fprintf(stderr, "无效的缓冲区大小(0-%d)\n", MAX_PAYLOAD_SIZE);
+            if (!parse_int(argv[++i], v) || v < 1 || v > MAX_WINDOW) {
+                fprintf(stderr, "无效的窗口大小(1-%d)\n", MAX_WINDOW);
                 return 2;
             }
-            opts.payload_size = v;
+            window = v;
             continue;
         }
-        if (arg == "-i" && i + 1 < argc) {
-            // TTL
+        if (arg == "--interval" && i + 1 < argc) {
             int v;
-            if (!parse_int(argv[++i], v) || v < 0 || v > 255) {
-                fprintf(stderr, "无效的TTL(0-255)\n");
+            if (!parse_int(argv[++i], v) || v < 0) {
+                fprintf(stderr, "无效的探测间隔\n");
                 return 2;
             }
-            opts.ttl = v;
+            interval_ms = v;
+            interval_set = true;
             continue;
         }
-        if (arg == "-v" && i + 1 < argc) {
-            // TOS
-            int v;
-            if (!parse_int(argv[++i], v) || v < 0 || v > 255) {
-                fprintf(stderr, "无效的TOS(0-255)\n");
+        if (arg == "--cpus" && i + 1 < argc) {
+            if (!parse_cpu_list(argv[++i], cpus)) {
+                fprintf(stderr, "无效的CPU列表(如 0-3,6 或 all)\n");
                 return 2;
             }
-            opts.tos = v;
             continue;
         }
-        if (arg == "-f") {
-            // 不分段标志
-            opts.dont_fragment = true;
+        if (arg == "--scaling") {
+            scaling = true;
             continue;
         }
-        if (arg == "-4") {
-            // 强制 IPv4
-            force_ipv4 = true;
-            force_ipv6 = false;
+        if (arg == "--busy-poll") {
+            busy_poll = true;
             continue;
         }
-        if (arg == "-6") {
-            // 强制 IPv6
-            force_ipv6 = true;
-            force_ipv4 = false;
+        if (arg == "--rtt-floor") {
+            rtt_floor = true;
             continue;
         }
-        if (arg == "-r" && i + 1 < argc) {
-            // 记录路由
+        if (arg == "--send-timing") {
+            send_timing = true;
+            continue;
+        }
+        if (arg == "--bench-options") {
+            bench_options = true;
+            continue;
+        }
+        if (arg == "--flows" && i + 1 < argc) {
             int v;
-            if (!parse_int(argv[++i], v) || v < 1 || v > MAX_RECORD_ROUTE) {
-                fprintf(stderr, "无效的记录路由计数(1-%d)\n", MAX_RECORD_ROUTE);
+            if (!parse_int(argv[++i], v) || v < 1 || v > MAX_FLOWS) {
+                fprintf(stderr, "无效的流数(1-%d)\n", MAX_FLOWS);
                 return 2;
             }
-            opts.record_route = v;
+            flows = v;
             continue;
         }
-        if (arg == "-s" && i + 1 < argc) {
-            // 时间戳
+        if (arg == "--simulate-ecmp" && i + 1 < argc) {
+            if (!parse_ecmp_sim(argv[++i], ecmp_paths, ecmp_bad_path, ecmp_loss)) {
+                fprintf(stderr, "无效的模拟ECMP参数(paths:bad:loss，路径数 2-%d，丢包率 0-100)\n",
+                        ECMP_SIM_MAX_PATHS);
+                return 2;
+            }
+            continue;
+        }
+        if (arg == "--size-sweep" && i + 1 < argc) {
+            if (!parse_size_sweep(argv[++i], sweep_sizes)) {
+                fprintf(stderr, "无效的大小扫描参数(min:max:step，0-%d 字节，最多 %d 级)\n",
+                        MAX_PAYLOAD_SIZE, MAX_SWEEP_SIZES);
+                return 2;
+            }
+            continue;
+        }
+        if (arg == "--sample-rate" && i + 1 < argc) {
+            double v;
+            if (!parse_double(argv[++i], v) || v <= 0 || v > 1) {
+                fprintf(stderr, "无效的抽样比例(0-1)\n");
+                return 2;
+            }
+            sample_cfg.sample_rate = v;
+            sample_mode = true;
+            continue;
+        }
+        if (arg == "--confidence" && i + 1 < argc) {
+            double v;
+            if (!parse_double(argv[++i], v) || v <= 0 || v >= 1) {
+                fprintf(stderr, "无效的置信水平(0-1)\n");
+                return 2;
+            }
+            sample_cfg.confidence = v;
+            sample_cfg.early_stop = true;
+            sample_mode = true;
+            continue;
+        }
+        if (arg == "--margin" && i + 1 < argc) {
+            double v;
+            if (!parse_double(argv[++i], v) || v <= 0 || v >= 1) {
+                fprintf(stderr, "无效的区间半宽(0-1)\n");
+                return 2;
+            }
+            sample_cfg.margin = v;
+            continue;
+        }
+        if (arg == "--flood" && i + 1 < argc) {
+            int v;
+            if (!parse_int(argv[++i], v) || v < 1 || v > FLOOD_MAX_PPS) {
+                fprintf(stderr, "无效的洪泛速率(1-%d)\n", FLOOD_MAX_PPS);
+                return 2;
+            }
+            flood_pps = v;
+            continue;
+        }
+        if (arg == "--aimd") {
+            aimd = true;
+            continue;
+        }
+        if (arg == "--prefix-rate" && i + 1 < argc) {
+            if (!parse_int(argv[++i], prefix_rate) || prefix_rate < 1 || prefix_rate > PREFIX_MAX_PPS) {
+                fprintf(stderr, "无效的前缀速率(1-%d)\n", PREFIX_MAX_PPS);
+                return 2;
+            }
+            continue;
+        }
+        if (arg == "--prefix-len" && i + 1 < argc) {
+            if (!parse_int(argv[++i], prefix_len) || prefix_len < 8 || prefix_len > 32) {
+                fprintf(stderr, "无效的前缀长度(8-32)\n");
+                return 2;
+            }
+            continue;
+        }
+        if (arg == "--exclude" && i + 1 < argc) {
+            auto eps = split(argv[++i], ',');
+            for (auto& e : eps) {
+                if (!e.empty()) {
+                    exclude_set.insert(e);
+                }
+            }
+            continue;
+        }
+        if (arg == "--exclude-file" && i + 1 < argc) {
+            exclude_path = argv[++i];
+            continue;
+        }
+        if (arg == "--target-set" && i + 1 < argc) {
+            target_set_paths.push_back(argv[++i]);
+            continue;
+        }
+
+        //---------------------------------------------------------------------
+        // 标准 Ping 选项
+        //---------------------------------------------------------------------
+        if (arg == "-t") {
+            // 持续 Ping 模式
+            count_per_target = 0;
+            count_set = true;
+            continue;
+        }
+        if (arg == "-n" && i + 1 < argc) {
+            // 指定 Ping 次数
+            int v;
+            if (!parse_int(argv[++i], v) || v <= 0) {
+                fprintf(stderr, "无效的计数\n");
+                return 2;
+            }
+            count_per_target = v;
+            count_set = true;
+            continue;
+        }
+        if (arg == "-w" && i + 1 < argc) {
+            // 超时时间
+            int v;
+            if (!parse_int(argv[++i], v) || v <= 0) {
+                fprintf(stderr, "无效的超时时间\n");
+                return 2;
+            }
+            opts.timeout_ms = v;
+            continue;
+        }
+        if (arg == "-a") {
+            // 解析主机名
+            resolve_names = true;
+            continue;
+        }
+        if (arg == "-l" && i + 1 < argc) {
+            // 负载大小
+            int v;
+            if (!parse_int(argv[++i], v) || v < 0 || v > MAX_PAYLOAD_SIZE) {
+                fprintf(stderr, "无效的缓冲区大小(0-%d)\n", MAX_PAYLOAD_SIZE);
+                return 2;
+            }
+            opts.payload_size = v;
+            continue;
+        }
+        if (arg == "-i" && i + 1 < argc) {
+            // TTL
+            int v;
+            if (!parse_int(argv[++i], v) || v < 0 || v > 255) {
+                fprintf(stderr, "无效的TTL(0-255)\n");
+                return 2;
+            }
+            opts.ttl = v;
+            continue;
+        }
+        if (arg == "-v" && i + 1 < argc) {
+            // TOS
+            int v;
+            if (!parse_int(argv[++i], v) || v < 0 || v > 255) {
+                fprintf(stderr, "无效的TOS(0-255)\n");
+                return 2;
+            }
+            opts.tos = v;
+            continue;
+        }
+        if (arg == "-f") {
+            // 不分段标志
+            opts.dont_fragment = true;
+            continue;
+        }
+        if (arg == "-4") {
+            // 强制 IPv4
+            force_ipv4 = true;
+            force_ipv6 = false;
+            continue;
+        }
+        if (arg == "-6") {
+            // 强制 IPv6
+            force_ipv6 = true;
+            force_ipv4 = false;
+            continue;
+        }
+        if (arg == "-r" && i + 1 < argc) {
+            // 记录路由
+            int v;
+            if (!parse_int(argv[++i], v) || v < 1 || v > MAX_RECORD_ROUTE) {
+                fprintf(stderr, "无效的记录路由计数(1-%d)\n", MAX_RECORD_ROUTE);
+                return 2;
+            }
+            opts.record_route = v;
+            continue;
+        }
+        if (arg == "-s" && i + 1 < argc) {
+            // 时间戳
             int v;
             if (!parse_int(argv[++i], v) || v < 1 || v > MAX_TIMESTAMP) {
                 fprintf(stderr, "无效的时间戳计数(1-%d)\n", MAX_TIMESTAMP);
@@ -620,76 +1284,79 @@ int main(int argc, char** argv) {
         }
 
         //---------------------------------------------------------------------
-        // 目标参数处理
-        // 支持三种逗号用法：
-        // 1. 多个独立目标：192.168.1.1,192.168.2.1（每部分都是完整IP或域名）
-        // 2. 最后一段列表：192.168.2.1,3,5（只有第一部分是完整IP）
-        // 3. 多个域名：google.com,localhost,yahoo.com（每个都是域名）
+        // 目标参数：不复制，枚举阶段由分词器直接扫描 argv 中的原始字符串
         //---------------------------------------------------------------------
-        if (arg.find(',') != std::string::npos) {
-            auto parts = split(arg, ',');
-            // 检查是否所有部分都是完整的 IP 格式（包含点号）或域名
-            bool all_complete_targets = true;
-            for (const auto& p : parts) {
-                // 完整目标应该是：IP地址（包含点号或冒号）或域名
-                if (!p.empty() && p.find('.') == std::string::npos &&
-                    p.find(':') == std::string::npos) {
-                    // 可能是数字（如最后一段列表）或域名
-                    // 检查是否是纯数字（最后一段列表格式）
-                    bool is_number = true;
-                    for (char c : p) {
-                        if (c < '0' || c > '9') {
-                            is_number = false;
-                            break;
-                        }
-                    }
-                    if (is_number) {
-                        // 纯数字，可能是最后一段列表格式的一部分
-                        all_complete_targets = false;
-                        break;
-                    } else {
-                        // 不是纯数字，可能是域名
-                        // 检查是否包含字母，可能是域名
-                        bool has_letter = false;
-                        for (char c : p) {
-                            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
-                                has_letter = true;
-                                break;
-                            }
-                        }
-                        if (!has_letter) {
-                            // 既不是数字也不是字母，无效格式
-                            all_complete_targets = false;
-                            break;
-                        }
-                    }
-                }
-            }
+        tokens.push_back(TextView(argv[i]));
+    }
 
-            if (all_complete_targets) {
-                // 多个独立目标，分别添加
-                for (auto& p : parts) {
-                    if (!p.empty()) {
-                        tokens.push_back(p);
-                    }
-                }
-            } else {
-                // 最后一段列表格式（如 192.168.2.1,3,5），作为整体处理
-                tokens.push_back(arg);
-            }
-        } else {
-            // 无逗号，直接添加
-            tokens.push_back(arg);
+    //=========================================================================
+    // 离线回放模式（--replay-pcap）：不发送任何数据包
+    //=========================================================================
+    if (!replay_path.empty()) {
+        std::vector<std::string> replay_targets;
+        std::vector<TargetStat> replay_stats;
+        ReplayReport report;
+        if (!replay_pcap(replay_path, opts, replay_targets, replay_stats, report)) {
+            return 2;
+        }
+
+        printf("回放文件: %s\n", replay_path.c_str());
+        printf("数据包=%llu, 请求=%llu, 回复=%llu, 配对=%llu, 迟到=%llu, 未配对=%llu\n",
+               (unsigned long long)report.packets, (unsigned long long)report.requests,
+               (unsigned long long)report.replies, (unsigned long long)report.matched,
+               (unsigned long long)report.late, (unsigned long long)report.unmatched);
+        if (report.option_entries > 0) {
+            printf("IP选项: 解析出记录路由/时间戳条目 %llu 个\n",
+                   (unsigned long long)report.option_entries);
+        }
+        if (report.elapsed_s > 0) {
+            printf("处理耗时: %.3f 秒, %.0f 数据包/秒, %.0f 回复/秒\n", report.elapsed_s,
+                   report.packets / report.elapsed_s, report.replies / report.elapsed_s);
+        }
+
+        uint64_t replay_recv = print_statistics(replay_targets, replay_stats);
+        return (replay_recv > 0) ? 0 : 1;
+    }
+
+    //=========================================================================
+    // 本机基准测试（--rtt-floor / --bench-options）：固定探测 127.0.0.1，不需要目标
+    //=========================================================================
+    if (rtt_floor || bench_options) {
+        WSADATA floor_wsa;
+        if (WSAStartup(MAKEWORD(2, 2), &floor_wsa) != 0) {
+            fprintf(stderr, "WSAStartup失败\n");
+            return 3;
+        }
+        std::atomic<bool> floor_stop{false};
+        g_stop_ptr = &floor_stop;
+        SetConsoleCtrlHandler(win_console_handler, TRUE);
+        if (rtt_floor) {
+            run_rtt_floor(opts, cpus, floor_stop);
         }
+        if (bench_options) {
+            run_options_benchmark(opts, floor_stop);
+        }
+        WSACleanup();
+        return 0;
     }
 
     //=========================================================================
     // 验证参数
     //=========================================================================
-    if (tokens.empty()) {
+    if (tokens.empty() && target_set_paths.empty()) {
         print_usage(argv[0]);
         return 2;
     }
+    if (max_age_s >= 0 && cache_path.empty()) {
+        fprintf(stderr, "--max-age 需要配合 --cache 使用\n");
+        return 2;
+    }
+    // 最优选择自行设定探测次数、窗口和间隔，与同样设定这些参数的模式互斥
+    if (select_best && (quorum != 0 || flood_pps > 0 || !sweep_sizes.empty() || flows > 0 || discover)) {
+        fprintf(stderr, "--select-best 不能与 --quorum/--any/--all、--flood、--size-sweep、"
+                        "--flows 或 --discover 同时使用\n");
+        return 2;
+    }
 
     //=========================================================================
     // 初始化 Winsock
@@ -700,68 +1367,75 @@ int main(int argc, char** argv) {
         return 3;
     }
 
+    // 排除文件以内存映射方式加载，抽样和枚举共用
+    ExcludeFilter exclude_filter;
+    if (!exclude_path.empty() && !exclude_filter.open(exclude_path)) {
+        WSACleanup();
+        return 2;
+    }
+
+    // 目标集同样只做映射，区间直接转换为目标描述
+    std::vector<std::unique_ptr<TargetSet>> target_sets;
+    for (const auto& path : target_set_paths) {
+        target_sets.emplace_back(new TargetSet());
+        if (!target_sets.back()->open(path)) {
+            WSACleanup();
+            return 2;
+        }
+    }
+
     //=========================================================================
-    // 枚举所有目标 IP 地址（支持域名解析）
+    // 抽样模式（--sample-rate / --confidence）：不展开目标列表
     //=========================================================================
-    std::vector<std::string> all_targets;
-    for (auto& tok : tokens) {
-        // 检查是否是可能的主机名（域名）
-        if (is_possible_hostname(tok)) {
-            // 解析域名为IP地址
-            std::vector<std::string> resolved_ips;
-            if (force_ipv6) {
-                // 只解析IPv6地址
-                resolved_ips = resolve_to_ips(tok, true);
-                // 过滤掉IPv4地址（如果有）
-                std::vector<std::string> ipv6_only;
-                for (const auto& ip : resolved_ips) {
-                    if (ip.find(':') != std::string::npos) {
-                        ipv6_only.push_back(ip);
-                    }
-                }
-                resolved_ips = ipv6_only;
-            } else if (force_ipv4) {
-                // 只解析IPv4地址
-                resolved_ips = resolve_to_ips(tok, false);
-                // 过滤掉IPv6地址（如果有）
-                std::vector<std::string> ipv4_only;
-                for (const auto& ip : resolved_ips) {
-                    if (ip.find(':') == std::string::npos) {
-                        ipv4_only.push_back(ip);
-                    }
-                }
-                resolved_ips = ipv4_only;
-            } else {
-                // 解析所有地址
-                resolved_ips = resolve_to_ips(tok, false);
-            }
-            
-            if (resolved_ips.empty()) {
-                fprintf(stderr, "无法解析域名: %s\n", tok.c_str());
+    if (sample_mode) {
+        std::vector<Ipv4Range> ranges;
+        for (auto& tok : tokens) {
+            if (!parse_ipv4_ranges(tok, ranges)) {
                 WSACleanup();
                 return 2;
             }
-            
-            // 添加解析到的IP地址
-            for (auto& ip : resolved_ips) {
-                if (exclude_set.find(ip) == exclude_set.end()) {
-                    all_targets.push_back(ip);
-                }
-            }
-        } else {
-            // 不是域名，使用原来的IP/CIDR/范围解析逻辑
-            std::vector<std::string> gen;
-            if (!enumerate_targets(tok, gen, force ? UINT_MAX : MAX_HOSTS_DEFAULT)) {
-                WSACleanup();
-                return 2;
-            }
-            // 添加不在排除列表中的目标
-            for (auto& ip : gen) {
-                if (exclude_set.find(ip) == exclude_set.end()) {
-                    all_targets.push_back(ip);
-                }
-            }
         }
+        for (const auto& set : target_sets) {
+            set->append_ranges(ranges);
+        }
+
+        std::atomic<bool> sample_stop{false};
+        g_stop_ptr = &sample_stop;
+        SetConsoleCtrlHandler(win_console_handler, TRUE);
+
+        sample_cfg.probes_per_host = (count_per_target > 0) ? count_per_target : 1;
+        sample_cfg.concurrency = concurrency;
+        uint64_t sample_live = 0;
+        if (!run_sampling(std::move(ranges), exclude_set, exclude_filter, opts, sample_cfg,
+                          sample_stop, sample_live)) {
+            WSACleanup();
+            return 2;
+        }
+
+        WSACleanup();
+        return (sample_live > 0) ? 0 : 1;
+    }
+
+    //=========================================================================
+    // 枚举所有目标 IP 地址（支持域名解析）
+    //=========================================================================
+    std::vector<TargetSpec> specs;
+    for (const auto& tok : tokens) {
+        if (!tokenize_targets(tok, specs, force ? UINT64_MAX : MAX_HOSTS_DEFAULT)) {
+            WSACleanup();
+            return 2;
+        }
+    }
+    for (const auto& set : target_sets) {
+        set->append_specs(specs);
+    }
+
+    // 并行展开并扣除排除项，结果整体移入目标表
+    std::vector<std::string> all_targets;
+    int resolve_af = force_ipv6 ? AF_INET6 : (force_ipv4 ? AF_INET : AF_UNSPEC);
+    if (!build_target_list(std::move(specs), exclude_set, exclude_filter, resolve_af, all_targets)) {
+        WSACleanup();
+        return 2;
     }
 
     // 检查是否有有效目标
@@ -778,22 +1452,131 @@ int main(int argc, char** argv) {
         return 2;
     }
 
+    // 洪泛模式只用于少量目标的压力测试
+    if (flood_pps > 0 && all_targets.size() > (size_t)FLOOD_MAX_TARGETS) {
+        fprintf(stderr, "洪泛模式最多支持 %d 个目标\n", FLOOD_MAX_TARGETS);
+        WSACleanup();
+        return 2;
+    }
+    if (flood_pps > 0 && aimd) {
+        fprintf(stderr, "--aimd 不能与 --flood 同时使用\n");
+        WSACleanup();
+        return 2;
+    }
+    // 流标记写在负载开头，负载太短时各流的报文完全相同，无法区分路径
+    if (flows > 1) {
+        int min_payload = sweep_sizes.empty() ? opts.payload_size
+                                              : *std::min_element(sweep_sizes.begin(), sweep_sizes.end());
+        if (min_payload < FLOW_KEY_BYTES) {
+            fprintf(stderr, "--flows 需要至少 %d 字节的负载(-l 或 --size-sweep)来区分各流\n",
+                    FLOW_KEY_BYTES);
+            WSACleanup();
+            return 2;
+        }
+    }
+    if (ecmp_paths > 0 && flows == 0) {
+        fprintf(stderr, "--simulate-ecmp 需要与 --flows 一起使用\n");
+        WSACleanup();
+        return 2;
+    }
+
+    //=========================================================================
+    // 存活缓存（--cache / --max-age）：足够新的目标直接使用缓存结论
+    //=========================================================================
+    LivenessCache cache;
+    std::vector<std::string> cached_targets;
+    std::vector<LivenessEntry> cached_entries;
+    if (!cache_path.empty()) {
+        if (!cache.load(cache_path)) {
+            WSACleanup();
+            return 2;
+        }
+        if (max_age_s >= 0) {
+            uint64_t now_ms = PcapWriter::now_ns() / 1000000;
+            uint64_t min_time = now_ms - std::min<uint64_t>(now_ms, (uint64_t)max_age_s * 1000);
+            size_t kept = 0;
+            for (size_t i = 0; i < all_targets.size(); ++i) {
+                LivenessEntry entry;
+                if (cache.lookup(all_targets[i], min_time, entry)) {
+                    cached_targets.push_back(std::move(all_targets[i]));
+                    cached_entries.push_back(entry);
+                } else {
+                    if (kept != i) {
+                        all_targets[kept] = std::move(all_targets[i]);
+                    }
+                    kept++;
+                }
+            }
+            all_targets.resize(kept);
+            printf("缓存命中: %zu 个目标 (%d 秒内), 需要探测: %zu 个\n",
+                   cached_targets.size(), max_age_s, all_targets.size());
+        }
+    }
+
+    // 法定数量按全部目标（含缓存命中的目标）计算
+    size_t universe = all_targets.size() + cached_targets.size();
+    size_t quorum_required = (quorum < 0) ? universe : (size_t)quorum;
+    if (quorum != 0 && quorum_required > universe) {
+        fprintf(stderr, "法定数量(%zu)超过目标数(%zu)\n", quorum_required, universe);
+        WSACleanup();
+        return 2;
+    }
+
+    if (all_targets.empty()) {
+        uint64_t cached_alive = print_cached_results(cached_targets, cached_entries);
+        WSACleanup();
+        if (quorum != 0) {
+            return (cached_alive >= quorum_required) ? 0 : 1;
+        }
+        return (cached_alive > 0) ? 0 : 1;
+    }
+
     printf("总目标数: %zu\n", all_targets.size());
     size_t N = all_targets.size();
 
+    //=========================================================================
+    // 打开 pcap 导出文件（--pcap）
+    //=========================================================================
+    PcapWriter pcap_writer;
+    if (!pcap_path.empty()) {
+        if (!pcap_writer.open(pcap_path)) {
+            WSACleanup();
+            return 3;
+        }
+        opts.pcap = &pcap_writer;
+    }
+
+    //=========================================================================
+    // 打开历史归档（--archive）
+    //=========================================================================
+    HistoryArchive archive;
+    if (!archive_dir.empty() && !archive.open(archive_dir, all_targets)) {
+        WSACleanup();
+        return 3;
+    }
+
+    //=========================================================================
+    // 创建共享内存统计（--shm）
+    //=========================================================================
+    SharedStats shared;
+    if (!shm_name.empty() && !shared.create(shm_name, all_targets)) {
+        WSACleanup();
+        return 3;
+    }
+
+    //=========================================================================
+    // 延迟草图（--sketch）
+    //=========================================================================
+    LatencyResults latency;
+    if (!sketch_path.empty()) {
+        latency.init(all_targets);
+    }
+
     //=========================================================================
     // 初始化统计数据
     //=========================================================================
 
-    /**
-     * @struct Stat
-     * @brief 每个目标的统计数据
-     */
-    struct Stat {
-        std::atomic<uint64_t> sent{0};  ///< 已发送数据包数
-        std::atomic<uint64_t> recv{0};  ///< 已接收数据包数
-    };
-    std::vector<Stat> stats(N);
+    std::vector<TargetStat> stats(N);
 
     //=========================================================================
     // 初始化同步原语
@@ -808,15 +1591,242 @@ int main(int argc, char** argv) {
     SetConsoleCtrlHandler(win_console_handler, TRUE);
 
     //=========================================================================
-    // 创建工作线程
+    // 多核扩展性测试（--scaling）
+    //=========================================================================
+    if (scaling) {
+        run_scaling_benchmark(all_targets, opts, cpus, stop_flag);
+        WSACleanup();
+        return 0;
+    }
+
+    //=========================================================================
+    // 窗口模式（--window）：使用异步探测引擎代替工作线程
     //=========================================================================
-    size_t worker_count = std::min<size_t>(std::max<int>(1, concurrency), N);
+    std::unique_ptr<HostnameResolver> resolver;  ///< 引擎模式下 -a 的后台反向解析（须晚于引擎销毁）
+    std::unique_ptr<ProbeEngine> engine;
+    std::unique_ptr<FloodMonitor> flood;
+    std::unique_ptr<SizeSweepMonitor> sweep;
+    std::unique_ptr<SendTimingMonitor> timing;
+    std::unique_ptr<FlowMonitor> flow_monitor;
+    std::unique_ptr<DiscoveryMonitor> discovery;
+    std::unique_ptr<AimdController> aimd_controller;
+    std::unique_ptr<QuorumMonitor> quorum_monitor;
+    std::unique_ptr<SelectBestMonitor> selector;
+    auto flood_begin = std::chrono::steady_clock::now();
+    if (window > 0 || flood_pps > 0 || !sweep_sizes.empty() || !cpus.empty() || busy_poll ||
+        send_timing || quorum != 0 || select_best || flows > 0 || discover || aimd || prefix_rate > 0) {
+        EngineConfig engine_cfg;
+        engine_cfg.window = std::max(window, 1);
+        engine_cfg.interval_ms = interval_ms;
+        engine_cfg.count = count_per_target;
+        engine_cfg.max_in_flight = concurrency;
+        engine_cfg.cpus = cpus;
+        engine_cfg.busy_poll = busy_poll;
+        engine_cfg.prefix_rate_pps = prefix_rate;
+        engine_cfg.prefix_len = prefix_len;
+
+        // 大小扫描：每个大小各探测 -n 次，各大小按发送次序交错
+        if (!sweep_sizes.empty()) {
+            engine_cfg.payload_sizes = sweep_sizes;
+            engine_cfg.count = count_per_target * (int)sweep_sizes.size();
+            if (!interval_set) {
+                engine_cfg.interval_ms = SIZE_SWEEP_INTERVAL_MS;
+            }
+            sweep.reset(new SizeSweepMonitor(sweep_sizes, N));
+        }
+
+        // 广播/组播发现：每个请求收集缓冲区中的全部回复；一次请求在首个回复到达时
+        // 即完成，默认多发几次以覆盖回复较慢的主机
+        if (discover) {
+            engine_cfg.max_replies = DISCOVER_MAX_REPLIES;
+            if (!count_set) {
+                engine_cfg.count = DISCOVER_DEFAULT_PROBES;
+            }
+            discovery.reset(new DiscoveryMonitor());
+        }
+
+        // 自适应速率：槽位按 AIMD_MAX_IN_FLIGHT（或更大的 --concurrency）分配，实际在途上限由控制器决定；
+        // 存活缓存中记为在线的目标从一开始就作为丢失率样本
+        if (aimd) {
+            engine_cfg.max_in_flight = std::max(concurrency, AIMD_MAX_IN_FLIGHT);
+            std::vector<uint8_t> known_alive;
+            if (!cache_path.empty()) {
+                known_alive.resize(N);
+                for (size_t i = 0; i < N; ++i) {
+                    LivenessEntry entry;
+                    known_alive[i] = (cache.lookup(all_targets[i], 0, entry) && entry.alive) ? 1 : 0;
+                }
+            }
+            aimd_controller.reset(new AimdController(N, engine_cfg.max_in_flight, known_alive));
+        }
+
+        // 多路径覆盖：每个流各探测 -n 次（扫描时为每个大小），流在目标内轮换
+        if (flows > 0) {
+            engine_cfg.flows = flows;
+            engine_cfg.count *= flows;
+            flow_monitor.reset(new FlowMonitor(flows, N));
+            engine_cfg.ecmp_paths = ecmp_paths;
+            engine_cfg.ecmp_bad_path = ecmp_bad_path;
+            engine_cfg.ecmp_loss_pct = ecmp_loss;
+            if (ecmp_paths > 0) {
+                printf("模拟ECMP: %d 条路径按负载散列, 路径 %d 丢包 %d%%\n",
+                       ecmp_paths, ecmp_bad_path, ecmp_loss);
+            }
+        }
+
+        // 洪泛模式：窗口填满，不按间隔节奏，由全局速率控制；-t 时在上限保持直到停止
+        if (flood_pps > 0) {
+            engine_cfg.window = (window > 0) ? window : MAX_WINDOW;
+            engine_cfg.interval_ms = 0;
+            engine_cfg.count = 0;
+            engine_cfg.max_in_flight = (int)N * engine_cfg.window;
+            engine_cfg.rate_pps = flood_pps;
+            engine_cfg.ramp_steps = FLOOD_RAMP_STEPS;
+            engine_cfg.step_ms = FLOOD_STEP_MS;
+            engine_cfg.duration_ms = (count_per_target == 0) ? 0 : FLOOD_RAMP_STEPS * FLOOD_STEP_MS;
+            flood.reset(new FloodMonitor(engine_cfg));
+            printf("洪泛模式: 速率上限 %d pps, 分 %d 级递增 (每级 %d ms), 每目标窗口 %d\n",
+                   flood_pps, FLOOD_RAMP_STEPS, FLOOD_STEP_MS, engine_cfg.window);
+        }
+
+        if (send_timing) {
+            timing.reset(new SendTimingMonitor());
+        }
+
+        // 法定数量：结论确定后停止引擎，在途探测直接取消而不是等到超时
+        if (quorum != 0) {
+            size_t known_alive = (size_t)std::count_if(cached_entries.begin(), cached_entries.end(),
+                                                       [](const LivenessEntry& e) { return e.alive; });
+            quorum_monitor.reset(new QuorumMonitor(N, quorum_required, engine_cfg.count, known_alive,
+                                                   cached_entries.size() - known_alive));
+            engine_cfg.cancel_on_stop = true;
+            // 超时即判定失败，不再为迟到回复多等一倍 -w
+            engine_cfg.track_late = false;
+            if (quorum_monitor->decided()) {
+                stop_flag.store(true);
+            }
+        }
+
+        // 最优端点选择：每个候选一个在途探测，淘汰的候选不再发送，选出后取消其余探测
+        if (select_best) {
+            engine_cfg.window = 1;
+            engine_cfg.count = SELECT_MAX_PROBES;
+            if (!interval_set) {
+                engine_cfg.interval_ms = SELECT_INTERVAL_MS;
+            }
+            engine_cfg.cancel_on_stop = true;
+            engine_cfg.track_late = false;
+            selector.reset(new SelectBestMonitor(N, opts.timeout_ms));
+        }
+
+        if (resolve_names) {
+            resolver.reset(new HostnameResolver(all_targets, LABEL_RESOLVE_THREADS));
+        }
+
+        engine.reset(new ProbeEngine(all_targets, stats, opts, engine_cfg));
+        engine->set_rate_controller(aimd_controller.get());
+        if (prefix_rate > 0) {
+            printf("前缀限速: 每个 /%d (IPv6 /%d) 前缀最多 %d pps, 共 %zu 个前缀\n",
+                   prefix_len, PREFIX_IPV6_LEN, prefix_rate, engine->prefix_count());
+        }
+        engine->set_callback([&](const ProbeEvent& ev) {
+            if (archive.is_open()) {
+                archive.record(ev.target, ev.result.success && !ev.late, (uint32_t)ev.elapsed_us);
+            }
+            if (shared.is_open()) {
+                shared.record(ev.target, ev.result.success && !ev.late, ev.late,
+                              (uint32_t)ev.elapsed_us);
+            }
+            if (!sketch_path.empty()) {
+                latency.record(ev.target, ev.result.success && !ev.late, (uint32_t)ev.elapsed_us);
+            }
+            if (sweep) {
+                sweep->record(ev);
+            }
+            if (timing) {
+                timing->record(ev);
+            }
+            if (flow_monitor) {
+                flow_monitor->record(ev);
+            }
+            if (aimd_controller) {
+                aimd_controller->record(ev);
+            }
+            std::vector<ReplySource> found;
+            if (discovery) {
+                discovery->record(ev, found);
+            }
+            if (quorum_monitor && quorum_monitor->record(ev)) {
+                stop_flag.store(true);
+            }
+            if (selector) {
+                std::vector<size_t> eliminated;
+                bool decided = selector->record(ev, eliminated);
+                for (size_t t : eliminated) {
+                    engine->retire(t);
+                }
+                if (decided) {
+                    stop_flag.store(true);
+                }
+            }
+            if (flood) {
+                flood->record(ev);
+            }
+
+            // 所有统计都已记录，以下只决定逐条输出的形式：发现模式只输出新发现的
+            // 主机，最优选择和洪泛模式不逐条输出
+            if (discovery) {
+                std::lock_guard<std::mutex> lk(print_mtx);
+                for (const auto& host : found) {
+                    printf("发现 %s (经 %s): 时间=%lums\n", host.addr.c_str(),
+                           all_targets[ev.target].c_str(), (unsigned long)host.rtt_ms);
+                }
+                return;
+            }
+            if (selector || flood) {
+                return;
+            }
+
+            const std::string label = resolver ? resolver->label(ev.target, ev.result.success)
+                                               : all_targets[ev.target];
+            std::lock_guard<std::mutex> lk(print_mtx);
+
+            if (ev.late) {
+                printf("来自 %s 的迟到回复: 序号=%u 时间=%lums (超过 %dms 超时)\n",
+                       label.c_str(), (unsigned)ev.seq,
+                       (unsigned long)(ev.elapsed_us / 1000), opts.timeout_ms);
+            } else if (ev.result.success) {
+                printf("来自 %s 的回复: 字节=%d 序号=%u 时间=%lums TTL=%lu",
+                       label.c_str(), ev.payload_size, (unsigned)ev.seq,
+                       (unsigned long)ev.result.rtt_ms, (unsigned long)ev.result.reply_ttl);
+                if (timing) {
+                    printf(" 发送=%lluus 网络=%lluus", (unsigned long long)ev.send_delay_us,
+                           (unsigned long long)ev.wire_us);
+                }
+                printf("\n");
+                print_option_results(ev.result);
+            } else {
+                printf("请求超时 %s 序号=%u\n", label.c_str(), (unsigned)ev.seq);
+            }
+        });
+        flood_begin = std::chrono::steady_clock::now();
+        if (!engine->start(stop_flag)) {
+            WSACleanup();
+            return 2;
+        }
+    }
+
+    //=========================================================================
+    // 创建工作线程（窗口模式下不创建）
+    //=========================================================================
+    size_t worker_count = engine ? 0 : std::min<size_t>(std::max<int>(1, concurrency), N);
     std::atomic<size_t> rr_idx{0};  ///< 轮询索引
+    const PingFunc ping4 = select_ping_ipv4(opts);  ///< 按选项特化的 IPv4 探测路径
     std::vector<std::thread> workers;
     workers.reserve(worker_count);
 
     int per_target = count_per_target;
-    const std::chrono::milliseconds ping_interval(1000);  ///< Ping 间隔
+    const std::chrono::milliseconds ping_interval(interval_ms);  ///< Ping 间隔
 
     // 启动工作线程
     for (size_t w = 0; w < worker_count; ++w) {
@@ -867,7 +1877,7 @@ int main(int argc, char** argv) {
 
                 if (af == AF_INET && !force_ipv6) {
                     // IPv4 Ping
-                    result = ping_ipv4(target, opts);
+                    result = ping4(target, opts);
                 } else if (af == AF_INET6 && !force_ipv4) {
                     // IPv6 Ping
                     result = ping_ipv6(target, opts);
@@ -877,6 +1887,15 @@ int main(int argc, char** argv) {
                 if (result.success) {
                     stats[idx].recv.fetch_add(1);
                 }
+                if (archive.is_open()) {
+                    archive.record(idx, result.success, (uint32_t)result.rtt_ms * 1000);
+                }
+                if (shared.is_open()) {
+                    shared.record(idx, result.success, false, (uint32_t)result.rtt_ms * 1000);
+                }
+                if (!sketch_path.empty()) {
+                    latency.record(idx, result.success, (uint32_t)result.rtt_ms * 1000);
+                }
 
                 //---------------------------------------------------------
                 // 输出结果
@@ -902,25 +1921,8 @@ int main(int argc, char** argv) {
                                    (unsigned long)result.rtt_ms, (unsigned long)result.reply_ttl);
                         }
 
-                        // 输出记录路由信息
-                        if (!result.route_hops.empty()) {
-                            printf("    路由: ");
-                            for (size_t i = 0; i < result.route_hops.size(); ++i) {
-                                if (i > 0) printf(" -> ");
-                                printf("%s", result.route_hops[i].c_str());
-                            }
-                            printf("\n");
-                        }
-
-                        // 输出时间戳信息
-                        if (!result.timestamps.empty()) {
-                            printf("    时间戳: ");
-                            for (size_t i = 0; i < result.timestamps.size(); ++i) {
-                                if (i > 0) printf(", ");
-                                printf("%ums", result.timestamps[i]);
-                            }
-                            printf("\n");
-                        }
+                        // 输出记录路由和时间戳信息
+                        print_option_results(result);
                     } else {
                         // 请求超时
                         if (!hostname.empty()) {
@@ -973,7 +1975,9 @@ int main(int argc, char** argv) {
 
             show_stats.store(false);
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        shared.heartbeat();
+        bool early_exit = quorum_monitor || selector;
+        std::this_thread::sleep_for(std::chrono::milliseconds(early_exit ? EARLY_EXIT_POLL_MS : 200));
     }
 
     //=========================================================================
@@ -984,57 +1988,102 @@ int main(int argc, char** argv) {
             th.join();
         }
     }
+    if (engine) {
+        engine->join();
+    }
+    if (flood) {
+        auto flood_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - flood_begin).count();
+        flood->print_report((uint64_t)flood_ms);
+    }
+    if (aimd_controller) {
+        auto aimd_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - flood_begin).count();
+        aimd_controller->print_report((uint64_t)aimd_ms);
+    }
+    if (sweep) {
+        sweep->print_report(all_targets);
+    }
+    if (timing) {
+        timing->print_report();
+    }
+    if (flow_monitor) {
+        flow_monitor->print_report(all_targets);
+    }
+    if (discovery) {
+        discovery->print_report(all_targets);
+    }
+    if (quorum_monitor) {
+        quorum_monitor->print_report();
+    }
 
     //=========================================================================
     // 输出最终统计信息
     //=========================================================================
-    printf("\n--- 统计信息 ---\n");
+    uint64_t total_recv = print_statistics(all_targets, stats);
+    if (!cached_targets.empty()) {
+        total_recv += print_cached_results(cached_targets, cached_entries);
+    }
 
-    uint64_t total_sent = 0, total_recv = 0;
-    std::vector<std::string> online_ips;   // 在线设备列表
-    std::vector<std::string> failed_ips;   // 失败设备列表
+    // 本次实际探测过的目标写回存活缓存
+    if (!cache_path.empty()) {
+        uint64_t now_ms = PcapWriter::now_ns() / 1000000;
+        for (size_t i = 0; i < N; ++i) {
+            if (stats[i].sent.load() > 0) {
+                cache.update(all_targets[i], stats[i].recv.load() > 0, now_ms);
+            }
+        }
+        if (cache.save(now_ms)) {
+            printf("\n存活缓存: %s (条目=%zu)\n", cache_path.c_str(), cache.size());
+        }
+    }
 
-    // 收集统计数据并分类设备
-    for (size_t i = 0; i < N; ++i) {
-        uint64_t s = stats[i].sent.load();
-        uint64_t r = stats[i].recv.load();
-        uint64_t lost = (s > r) ? (s - r) : 0;
-        double pct = (s > 0) ? (100.0 * lost / s) : 0.0;
+    // 关闭 pcap 文件并输出记录情况
+    if (pcap_writer.is_open()) {
+        pcap_writer.close();
+        printf("\n抓包文件: %s (数据包=%llu, 丢弃=%llu)\n", pcap_path.c_str(),
+               (unsigned long long)pcap_writer.packet_count(),
+               (unsigned long long)pcap_writer.dropped_count());
+    }
 
-        printf("%s : 已发送=%llu, 已接收=%llu, 丢失=%llu (%.1f%%)\n",
-               all_targets[i].c_str(), (unsigned long long)s,
-               (unsigned long long)r, (unsigned long long)lost, pct);
+    // 共享内存标记为已结束（读取方仍持有映射时可看到最终统计）
+    shared.close();
 
-        total_sent += s;
-        total_recv += r;
+    // 写出最后一个归档分段
+    if (archive.is_open()) {
+        archive.close();
+        printf("\n历史归档: %s (记录=%llu, 分段=%llu)\n", archive_dir.c_str(),
+               (unsigned long long)archive.record_count(),
+               (unsigned long long)archive.segment_count());
+    }
 
-        // 分类：至少收到一个回复为在线，否则为失败
-        if (r > 0) {
-            online_ips.push_back(all_targets[i]);
-        } else {
-            failed_ips.push_back(all_targets[i]);
+    // 写出延迟草图结果文件，供 qping merge 合并
+    if (!sketch_path.empty()) {
+        uint64_t bytes = 0;
+        if (latency.save(sketch_path, bytes)) {
+            printf("\n延迟草图: %s (目标=%zu, 样本=%llu, %.1fKB)\n", sketch_path.c_str(),
+                   latency.size(), (unsigned long long)latency.sample_count(), bytes / 1024.0);
         }
     }
 
-    // 输出汇总统计
-    uint64_t total_lost = (total_sent > total_recv) ? (total_sent - total_recv) : 0;
-    double total_pct = (total_sent > 0) ? (100.0 * total_lost / total_sent) : 0.0;
-
-    printf("\n数据包统计: 发送=%llu, 接收=%llu, 丢失=%llu (%.1f%%)\n",
-           (unsigned long long)total_sent, (unsigned long long)total_recv,
-           (unsigned long long)total_lost, total_pct);
-
-    // 输出在线/失败设备列表（使用范围压缩格式）
-    printf("\n在线设备 (%zu): %s\n",
-           online_ips.size(), compress_ip_ranges(online_ips).c_str());
-    printf("失败设备 (%zu): %s\n",
-           failed_ips.size(), compress_ip_ranges(failed_ips).c_str());
-
     //=========================================================================
     // 清理并退出
     //=========================================================================
     WSACleanup();
 
-    // 返回码：至少有一个响应返回 0，否则返回 1
+    // 结果行放在最后，便于脚本读取
+    if (selector) {
+        auto select_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - flood_begin).count();
+        selector->print_report(all_targets, (uint64_t)select_ms);
+    }
+
+    // 返回码：至少有一个响应（或满足法定数量、选出最优端点）返回 0，否则返回 1
+    if (selector) {
+        return selector->has_winner() ? 0 : 1;
+    }
+    if (quorum_monitor) {
+        return quorum_monitor->met() ? 0 : 1;
+    }
     return (total_recv > 0) ? 0 : 1;
 }
@@ -0,0 +1,689 @@
+/**
+ * @file pcap.cpp
+ * @brief 抓包模块 - pcap 导出与离线回放
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --pcap 选项，包括：
+ * - 根据探测参数合成 IPv4/ICMP 和 IPv6/ICMPv6 Echo 数据包
+ * - 纳秒精度时间戳（系统时间基准 + QueryPerformanceCounter 偏移）
+ * - 专用写入线程和双缓冲批量写入，探测线程不直接进行文件 I/O
+ * - 基于内存映射的 pcap 读取和 --replay-pcap 离线回放
+ *
+ * Windows ICMP API 不提供原始数据包，因此记录的数据包由请求参数和
+ * ICMP_ECHO_REPLY 内容重建，校验和等字段均按协议规范计算。
+ */
+
+#include "qping.h"
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/** @brief pcap 文件头 magic（纳秒精度时间戳） */
+static const uint32_t PCAP_MAGIC_NS = 0xA1B23C4D;
+
+/** @brief 写入线程最长等待间隔，保证数据及时落盘 */
+static const int PCAP_FLUSH_INTERVAL_MS = 100;
+
+/** @brief stdio 文件缓冲区大小 */
+static const size_t PCAP_FILE_BUFFER = 1 << 20;
+
+/**
+ * @brief 以小端序追加 32 位整数（pcap 头部使用写入方的字节序）
+ */
+static void put_le32(std::vector<unsigned char>& buf, uint32_t v) {
+    unsigned char b[4] = {
+        (unsigned char)v, (unsigned char)(v >> 8),
+        (unsigned char)(v >> 16), (unsigned char)(v >> 24)
+    };
+    buf.insert(buf.end(), b, b + 4);
+}
+
+/**
+ * @brief 以网络字节序写入 16 位整数
+ */
+static void put_be16(unsigned char* p, uint16_t v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+/**
+ * @brief 累加 Internet 校验和（RFC 1071），返回未取反的 32 位累加值
+ */
+static uint32_t checksum_add(uint32_t sum, const unsigned char* data, size_t len) {
+    size_t i = 0;
+    for (; i + 1 < len; i += 2) {
+        sum += ((uint32_t)data[i] << 8) | data[i + 1];
+    }
+    if (i < len) {
+        sum += (uint32_t)data[i] << 8;
+    }
+    return sum;
+}
+
+/**
+ * @brief 折叠并取反校验和累加值
+ */
+static uint16_t checksum_finish(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+//=============================================================================
+// 时间戳
+//=============================================================================
+
+/**
+ * @brief 获取当前时间戳
+ *
+ * 首次调用时记录系统时间和性能计数器的对应关系，之后仅读取
+ * QueryPerformanceCounter 并换算偏移，既有纳秒级分辨率又避免每次
+ * 调用系统时间 API（GetSystemTimePreciseAsFileTime 在 Windows 7 上不可用）。
+ *
+ * @return 自 1970-01-01 起的纳秒数
+ */
+uint64_t PcapWriter::now_ns() {
+    struct Base {
+        uint64_t epoch_ns;
+        LONGLONG qpc;
+        LONGLONG freq;
+        Base() {
+            FILETIME ft;
+            GetSystemTimeAsFileTime(&ft);
+            uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+            // FILETIME 为自 1601 年起的 100ns 间隔
+            epoch_ns = (t - 116444736000000000ULL) * 100;
+            LARGE_INTEGER li;
+            QueryPerformanceFrequency(&li);
+            freq = li.QuadPart;
+            QueryPerformanceCounter(&li);
+            qpc = li.QuadPart;
+        }
+    };
+    static const Base base;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    uint64_t delta = (uint64_t)(now.QuadPart - base.qpc);
+    // 拆分整数和余数部分，避免乘法溢出
+    uint64_t secs = delta / (uint64_t)base.freq;
+    uint64_t rem = delta % (uint64_t)base.freq;
+    return base.epoch_ns + secs * 1000000000ULL +
+           rem * 1000000000ULL / (uint64_t)base.freq;
+}
+
+//=============================================================================
+// PcapWriter 实现
+//=============================================================================
+
+/**
+ * @brief 创建 pcap 文件并启动写入线程
+ *
+ * 写入 24 字节全局文件头（纳秒精度、LINKTYPE_RAW），
+ * 并为文件设置 1MB 的 stdio 缓冲区。
+ *
+ * @param path 输出文件路径
+ * @return 成功返回 true，失败返回 false 并输出错误信息
+ */
+bool PcapWriter::open(const std::string& path) {
+    close();
+
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        fprintf(stderr, "无法创建抓包文件: %s\n", path.c_str());
+        return false;
+    }
+    setvbuf(file_, nullptr, _IOFBF, PCAP_FILE_BUFFER);
+
+    // 全局文件头: magic, 版本 2.4, 时区, 精度, snaplen, 链路类型
+    std::vector<unsigned char> header;
+    put_le32(header, PCAP_MAGIC_NS);
+    put_le32(header, 2 | (4u << 16));
+    put_le32(header, 0);
+    put_le32(header, 0);
+    put_le32(header, PCAP_SNAPLEN);
+    put_le32(header, PCAP_LINKTYPE_RAW);
+    fwrite(header.data(), 1, header.size(), file_);
+
+    pending_.reserve(PCAP_FILE_BUFFER);
+    stopping_ = false;
+    packets_.store(0);
+    dropped_.store(0);
+    writer_ = std::thread(&PcapWriter::writer_loop, this);
+    return true;
+}
+
+/**
+ * @brief 刷新剩余数据、停止写入线程并关闭文件
+ */
+void PcapWriter::close() {
+    if (!file_) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+
+    fclose(file_);
+    file_ = nullptr;
+}
+
+/**
+ * @brief 写入线程主循环
+ *
+ * 每次被唤醒（或超时）时与探测线程交换缓冲区，在锁外写入文件。
+ * 交换后的旧缓冲区保留容量，稳定运行时不再分配内存。
+ */
+void PcapWriter::writer_loop() {
+    std::vector<unsigned char> batch;
+    batch.reserve(PCAP_FILE_BUFFER);
+
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait_for(lk, std::chrono::milliseconds(PCAP_FLUSH_INTERVAL_MS),
+                         [this] { return stopping_ || pending_.size() >= PCAP_FILE_BUFFER; });
+            batch.swap(pending_);
+            stopping = stopping_;
+        }
+
+        if (!batch.empty()) {
+            fwrite(batch.data(), 1, batch.size(), file_);
+            batch.clear();
+        }
+        if (stopping) {
+            break;
+        }
+    }
+
+    fflush(file_);
+}
+
+/**
+ * @brief 记录一个 ICMP Echo 请求或回复
+ *
+ * 在栈上合成完整的 IP 数据包（含 IPv4 选项、ICMP 头和负载），
+ * 计算校验和后连同 16 字节记录头一起追加到待写缓冲区；缓冲区达到
+ * PCAP_FILE_BUFFER 时立即唤醒写入线程，而不是等到下一次超时。
+ * 当写入线程跟不上导致积压超过 PCAP_MAX_BACKLOG 时丢弃记录并计数。
+ */
+void PcapWriter::record_echo(int af, bool is_reply, const void* src, const void* dst,
+                             uint16_t seq, int ttl, int tos,
+                             const void* payload, size_t payload_len,
+                             const void* ip_options, size_t options_len,
+                             uint64_t timestamp_ns) {
+    if (!file_) {
+        return;
+    }
+
+    // IP 头（IPv4 最长 60 字节，IPv6 固定 40 字节）+ ICMP 头 8 字节
+    unsigned char hdr[68] = {};
+    size_t ip_len;
+    uint16_t ident = (uint16_t)GetCurrentProcessId();
+
+    if (af == AF_INET6) {
+        ip_len = 40;
+        uint16_t plen = (uint16_t)std::min<size_t>(8 + payload_len, 0xFFFF);
+        hdr[0] = 0x60;                          // 版本 6
+        put_be16(&hdr[4], plen);                // 负载长度
+        hdr[6] = 58;                            // 下一头部：ICMPv6
+        hdr[7] = (unsigned char)ttl;            // 跳数限制
+        if (src) memcpy(&hdr[8], src, 16);
+        if (dst) memcpy(&hdr[24], dst, 16);
+    } else {
+        size_t opt_len = std::min<size_t>(options_len, 40);
+        ip_len = 20 + ((opt_len + 3) & ~(size_t)3);
+        uint16_t total = (uint16_t)std::min<size_t>(ip_len + 8 + payload_len, 0xFFFF);
+        hdr[0] = (unsigned char)(0x40 | (ip_len / 4));  // 版本 4 + 头长度
+        hdr[1] = (unsigned char)tos;
+        put_be16(&hdr[2], total);
+        hdr[8] = (unsigned char)ttl;
+        hdr[9] = 1;                             // 协议：ICMP
+        if (src) memcpy(&hdr[12], src, 4);
+        if (dst) memcpy(&hdr[16], dst, 4);
+        if (opt_len > 0 && ip_options) {
+            memcpy(&hdr[20], ip_options, opt_len);
+        }
+        put_be16(&hdr[10], checksum_finish(checksum_add(0, hdr, ip_len)));
+    }
+
+    // ICMP / ICMPv6 Echo 头
+    unsigned char* icmp = &hdr[ip_len];
+    if (af == AF_INET6) {
+        icmp[0] = is_reply ? 129 : 128;
+    } else {
+        icmp[0] = is_reply ? 0 : 8;
+    }
+    put_be16(&icmp[4], ident);
+    put_be16(&icmp[6], seq);
+
+    uint32_t sum = checksum_add(0, icmp, 8);
+    sum = checksum_add(sum, (const unsigned char*)payload, payload_len);
+    if (af == AF_INET6) {
+        // ICMPv6 校验和包含伪首部：源地址、目标地址、上层长度、下一头部
+        sum = checksum_add(sum, &hdr[8], 32);
+        sum += (uint32_t)(8 + payload_len);
+        sum += 58;
+    }
+    put_be16(&icmp[2], checksum_finish(sum));
+
+    size_t orig_len = ip_len + 8 + payload_len;
+    size_t cap_len = std::min<size_t>(orig_len, PCAP_SNAPLEN);
+    size_t data_len = cap_len - ip_len - 8;
+    bool full;
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (pending_.size() + 16 + cap_len > PCAP_MAX_BACKLOG) {
+            dropped_.fetch_add(1);
+            return;
+        }
+        size_t before = pending_.size();
+        // 记录头: 秒, 纳秒, 捕获长度, 原始长度
+        put_le32(pending_, (uint32_t)(timestamp_ns / 1000000000ULL));
+        put_le32(pending_, (uint32_t)(timestamp_ns % 1000000000ULL));
+        put_le32(pending_, (uint32_t)cap_len);
+        put_le32(pending_, (uint32_t)orig_len);
+        pending_.insert(pending_.end(), hdr, hdr + ip_len + 8);
+        if (data_len > 0) {
+            const unsigned char* p = (const unsigned char*)payload;
+            pending_.insert(pending_.end(), p, p + data_len);
+        }
+        // 只在跨过阈值时唤醒一次，避免高速率下每个包都通知
+        full = before < PCAP_FILE_BUFFER && pending_.size() >= PCAP_FILE_BUFFER;
+    }
+    packets_.fetch_add(1);
+    if (full) {
+        cv_.notify_one();
+    }
+}
+
+//=============================================================================
+// PcapReader 实现
+//=============================================================================
+
+/**
+ * @brief 以小端序读取 32 位整数
+ */
+static uint32_t get_le32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief 以网络字节序读取 16 位整数
+ */
+static uint16_t get_be16(const unsigned char* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief 打开并映射 pcap 文件，校验文件头
+ *
+ * 仅支持小端序写入的文件（x86 上抓包工具的默认格式）。
+ *
+ * @param path 文件路径
+ * @return 成功返回 true，失败返回 false 并输出错误信息
+ */
+bool PcapReader::open(const std::string& path) {
+    close();
+
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "无法打开抓包文件: %s\n", path.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart < 24) {
+        fprintf(stderr, "抓包文件过小或无法读取: %s\n", path.c_str());
+        close();
+        return false;
+    }
+    size_ = (size_t)size.QuadPart;
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+        base_ = (const unsigned char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!base_) {
+        fprintf(stderr, "无法映射抓包文件: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    uint32_t magic = get_le32(base_);
+    if (magic == PCAP_MAGIC_NS) {
+        nanosecond_ = true;
+    } else if (magic == 0xA1B2C3D4) {
+        nanosecond_ = false;
+    } else {
+        fprintf(stderr, "不支持的抓包文件格式（仅支持小端序 pcap）: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    linktype_ = get_le32(base_ + 20) & 0xFFFF;
+    if (linktype_ != PCAP_LINKTYPE_RAW && linktype_ != PCAP_LINKTYPE_IPV4 &&
+        linktype_ != PCAP_LINKTYPE_IPV6 && linktype_ != PCAP_LINKTYPE_ETHERNET) {
+        fprintf(stderr, "不支持的链路类型 %u: %s\n", linktype_, path.c_str());
+        close();
+        return false;
+    }
+
+    rewind();
+    return true;
+}
+
+/**
+ * @brief 解除映射并关闭文件
+ */
+void PcapReader::close() {
+    if (base_) {
+        UnmapViewOfFile(base_);
+        base_ = nullptr;
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    size_ = 0;
+    offset_ = 0;
+}
+
+/**
+ * @brief 读取下一个 IP 数据包
+ *
+ * 以太网帧剥离 14 字节头部（含一层 802.1Q 标签时为 18 字节），
+ * 非 IPv4/IPv6 帧直接跳过。
+ */
+bool PcapReader::next(PcapPacket& pkt) {
+    while (base_ && offset_ + 16 <= size_) {
+        const unsigned char* rec = base_ + offset_;
+        uint32_t cap_len = get_le32(rec + 8);
+        if (offset_ + 16 + cap_len > size_) {
+            return false;  // 记录被截断
+        }
+        offset_ += 16 + cap_len;
+
+        const unsigned char* data = rec + 16;
+        uint32_t len = cap_len;
+        if (linktype_ == PCAP_LINKTYPE_ETHERNET) {
+            if (len < 14) continue;
+            uint16_t ethertype = get_be16(data + 12);
+            size_t hdr = 14;
+            if (ethertype == 0x8100 && len >= 18) {
+                ethertype = get_be16(data + 16);
+                hdr = 18;
+            }
+            if (ethertype != 0x0800 && ethertype != 0x86DD) continue;
+            data += hdr;
+            len -= (uint32_t)hdr;
+        }
+
+        uint64_t secs = get_le32(rec);
+        uint64_t frac = get_le32(rec + 4);
+        pkt.timestamp_ns = secs * 1000000000ULL + (nanosecond_ ? frac : frac * 1000);
+        pkt.data = data;
+        pkt.length = len;
+        return true;
+    }
+    return false;
+}
+
+//=============================================================================
+// 数据包解析
+//=============================================================================
+
+/**
+ * @brief 解析原始 IP 数据包中的 ICMP/ICMPv6 Echo 请求或回复
+ *
+ * IPv4 解析头长度和选项；IPv6 仅处理下一头部直接为 ICMPv6 的数据包。
+ * 不校验校验和，解析结果中的指针均指向输入数据内部。
+ *
+ * @param data IP 头起始位置
+ * @param len 数据长度
+ * @param[out] out 解析结果
+ * @return 是 Echo 请求或回复返回 true，其他数据包返回 false
+ */
+bool parse_echo_packet(const unsigned char* data, size_t len, EchoPacket& out) {
+    if (len < 1) {
+        return false;
+    }
+
+    const unsigned char* icmp;
+    size_t icmp_len;
+    int version = data[0] >> 4;
+
+    if (version == 4) {
+        size_t ihl = (size_t)(data[0] & 0x0F) * 4;
+        if (ihl < 20 || len < ihl + 8 || data[9] != 1) {
+            return false;
+        }
+        // 以 IP 总长度为准，忽略以太网填充
+        size_t total = get_be16(data + 2);
+        if (total >= ihl + 8 && total < len) {
+            len = total;
+        }
+        out.af = AF_INET;
+        out.ttl = data[8];
+        memcpy(out.src, data + 12, 4);
+        memcpy(out.dst, data + 16, 4);
+        out.options = data + 20;
+        out.options_len = ihl - 20;
+        icmp = data + ihl;
+        icmp_len = len - ihl;
+
+        if (icmp[0] == 8) {
+            out.is_reply = false;
+        } else if (icmp[0] == 0) {
+            out.is_reply = true;
+        } else {
+            return false;
+        }
+    } else if (version == 6) {
+        if (len < 48 || data[6] != 58) {
+            return false;
+        }
+        out.af = AF_INET6;
+        out.ttl = data[7];
+        memcpy(out.src, data + 8, 16);
+        memcpy(out.dst, data + 24, 16);
+        out.options = nullptr;
+        out.options_len = 0;
+        icmp = data + 40;
+        icmp_len = len - 40;
+
+        if (icmp[0] == 128) {
+            out.is_reply = false;
+        } else if (icmp[0] == 129) {
+            out.is_reply = true;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    out.ident = get_be16(icmp + 4);
+    out.seq = get_be16(icmp + 6);
+    out.payload = icmp + 8;
+    out.payload_len = icmp_len - 8;
+    return true;
+}
+
+//=============================================================================
+// 离线回放
+//=============================================================================
+
+/**
+ * @struct AddrKey
+ * @brief 地址表的键（IPv4 地址放在低 32 位，高位区分地址族）
+ */
+struct AddrKey {
+    uint64_t hi;
+    uint64_t lo;
+    bool operator==(const AddrKey& o) const { return hi == o.hi && lo == o.lo; }
+};
+
+/**
+ * @struct AddrKeyHash
+ * @brief AddrKey 的哈希函数
+ */
+struct AddrKeyHash {
+    size_t operator()(const AddrKey& k) const {
+        uint64_t h = k.hi * 0x9E3779B97F4A7C15ULL ^ k.lo;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        return (size_t)(h ^ (h >> 32));
+    }
+};
+
+/**
+ * @brief 由地址族和地址字节构造 AddrKey
+ */
+static AddrKey make_addr_key(int af, const unsigned char* addr) {
+    AddrKey k;
+    if (af == AF_INET6) {
+        memcpy(&k.hi, addr, 8);
+        memcpy(&k.lo, addr + 8, 8);
+    } else {
+        uint32_t v;
+        memcpy(&v, addr, 4);
+        k.hi = ~0ULL;
+        k.lo = v;
+    }
+    return k;
+}
+
+/**
+ * @brief 离线回放 pcap 文件
+ *
+ * 第一遍扫描 Echo 请求建立目标表（避免统计表在回放过程中扩容），
+ * 第二遍按时间顺序处理：请求计入 sent 并登记到未决表，
+ * 回复按（目标序号、标识符、序列号）从未决表中取出请求时间戳计算 RTT，
+ * 带 IPv4 选项的回复与实时路径一样经过 parse_reply_options()，再由
+ * record_reply() 按 -w 计入 recv 或 late，统计口径与探测引擎相同。
+ * 第二遍耗时即为回复处理路径的吞吐量基准。
+ *
+ * 配对本身与实时路径不同：引擎由 IcmpSendEcho2 的槽位事件对应请求，
+ * 无法输入抓到的数据包，因此回放按地址、标识符和序列号自行配对。
+ */
+bool replay_pcap(const std::string& path, const PingOptions& opts,
+                 std::vector<std::string>& targets,
+                 std::vector<TargetStat>& stats,
+                 ReplayReport& report) {
+    PcapReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+
+    report = ReplayReport();
+    targets.clear();
+
+    //-------------------------------------------------------------------------
+    // 第一遍：由请求的目标地址建立目标表
+    //-------------------------------------------------------------------------
+    std::unordered_map<AddrKey, size_t, AddrKeyHash> target_index;
+    PcapPacket pkt;
+    EchoPacket echo;
+    while (reader.next(pkt)) {
+        if (!parse_echo_packet(pkt.data, pkt.length, echo) || echo.is_reply) {
+            continue;
+        }
+        AddrKey key = make_addr_key(echo.af, echo.dst);
+        if (target_index.find(key) == target_index.end()) {
+            char buf[INET6_ADDRSTRLEN] = {};
+            InetNtopA(echo.af, echo.dst, buf, sizeof(buf));
+            target_index.emplace(key, targets.size());
+            targets.push_back(buf);
+        }
+    }
+    stats = std::vector<TargetStat>(targets.size());
+
+    //-------------------------------------------------------------------------
+    // 第二遍：按时间顺序配对请求和回复并更新统计
+    //-------------------------------------------------------------------------
+    // 未决请求表：(目标序号 << 32 | 标识符 << 16 | 序列号) -> 请求时间戳
+    std::unordered_map<uint64_t, uint64_t> outstanding;
+    outstanding.reserve(1024);
+    PingResult options_scratch;  // 选项解析结果，跨回复复用容量
+
+    LARGE_INTEGER freq, t0, t1;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t0);
+
+    reader.rewind();
+    while (reader.next(pkt)) {
+        ++report.packets;
+        if (!parse_echo_packet(pkt.data, pkt.length, echo)) {
+            continue;
+        }
+
+        // 请求按目标地址、回复按源地址定位目标
+        auto it = target_index.find(make_addr_key(echo.af, echo.is_reply ? echo.src : echo.dst));
+        if (echo.is_reply) {
+            ++report.replies;
+        } else {
+            ++report.requests;
+        }
+        if (it == target_index.end()) {
+            ++report.unmatched;
+            continue;
+        }
+        size_t idx = it->second;
+        uint64_t demux_key = ((uint64_t)idx << 32) | ((uint64_t)echo.ident << 16) | echo.seq;
+
+        if (!echo.is_reply) {
+            stats[idx].sent.fetch_add(1, std::memory_order_relaxed);
+            outstanding[demux_key] = pkt.timestamp_ns;
+            continue;
+        }
+
+        auto req = outstanding.find(demux_key);
+        if (req == outstanding.end()) {
+            ++report.unmatched;  // 无对应请求或重复回复
+            continue;
+        }
+        uint64_t rtt_ns = pkt.timestamp_ns >= req->second ? pkt.timestamp_ns - req->second : 0;
+        outstanding.erase(req);
+
+        if (record_reply(stats[idx], rtt_ns / 1000, opts.timeout_ms)) {
+            ++report.late;
+            continue;
+        }
+
+        if (echo.options_len > 0) {
+            options_scratch.route_hops.clear();
+            options_scratch.timestamps.clear();
+            parse_reply_options(echo.options, echo.options_len, opts, options_scratch);
+            report.option_entries += options_scratch.route_hops.size() + options_scratch.timestamps.size();
+        }
+        ++report.matched;
+    }
+
+    QueryPerformanceCounter(&t1);
+    report.elapsed_s = (double)(t1.QuadPart - t0.QuadPart) / (double)freq.QuadPart;
+    return true;
+}
+
+} // namespace qping
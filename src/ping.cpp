@@ -10,6 +10,7 @@
  * - IPv4 Ping（使用 IcmpSendEcho API）
  * - IPv6 Ping（使用 Icmp6SendEcho2 API）
  * - 支持记录路由、时间戳、源路由等高级 IP 选项
+ * - 按是否使用 IP 选项特化的 IPv4 探测路径（启动时选择一次）
  * - 反向 DNS 解析
  *
  * 使用 Windows ICMP API，无需管理员权限即可运行。
@@ -39,80 +40,95 @@ static std::string format_route_ip(const unsigned char* data) {
 }
 
 //=============================================================================
-// IPv4 Ping 实现
+// 回复解析
 //=============================================================================
 
 /**
- * @brief 执行 IPv4 ICMP Echo 请求
- *
- * 使用 Windows IcmpSendEcho API 向指定的 IPv4 地址发送 ICMP Echo 请求，
- * 并等待回复。支持多种高级 IP 选项，包括：
- * - TTL（生存时间）和 TOS（服务类型）设置
- * - DF（不分段）标志
- * - 记录路由选项（-r）
- * - 时间戳选项（-s）
- * - 宽松源路由（-j）和严格源路由（-k）
+ * @brief 解析回复中的 IPv4 选项（记录路由、时间戳）
  *
- * @param ip 目标 IPv4 地址字符串（点分十进制格式）
- * @param opts Ping 配置选项，包含超时、负载大小、TTL 等参数
- * @return PingResult 结构，包含操作结果和统计信息
- *
- * @note 源地址选项（-S）在 IcmpSendEcho 中不支持，会显示警告
+ * 实时探测（ICMP_ECHO_REPLY::Options）和 pcap 回放（IP 头选项字段）
+ * 共用此函数，保证两条路径得到相同的 PingResult。
  *
- * @see PingOptions
- * @see PingResult
- *
- * @example
- * @code
- * PingOptions opts;
- * opts.timeout_ms = 1000;
- * opts.payload_size = 32;
- * opts.ttl = 64;
- *
- * PingResult result = ping_ipv4("192.168.1.1", opts);
- * if (result.success) {
- *     printf("RTT: %lu ms, TTL: %lu\n", result.rtt_ms, result.reply_ttl);
- * }
- * @endcode
+ * @param opt_data 选项数据
+ * @param opt_size 选项数据长度（字节）
+ * @param opts Ping 配置选项，决定需要解析哪些选项
+ * @param[out] result 解析结果追加到 route_hops / timestamps
  */
-PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
-    PingResult result;
-
+void parse_reply_options(const unsigned char* opt_data, size_t opt_size,
+                         const PingOptions& opts, PingResult& result) {
     //-------------------------------------------------------------------------
-    // 解析目标地址
+    // 解析记录路由选项返回的数据
     //-------------------------------------------------------------------------
-    IN_ADDR dest;
-    if (InetPtonA(AF_INET, ip.c_str(), &dest) != 1) {
-        return result;  // 地址解析失败
+    if (opts.record_route > 0 && opt_size >= 3 && opt_data[0] == OPT_RR) {
+        int ptr = opt_data[2];          // 指针位置
+        int count = (ptr - 4) / 4;      // 已记录的 IP 数量
+
+        for (int i = 0; i < count && (size_t)(3 + (i + 1) * 4) <= opt_size; ++i) {
+            result.route_hops.push_back(format_route_ip(&opt_data[3 + i * 4]));
+        }
     }
 
     //-------------------------------------------------------------------------
-    // 创建 ICMP 句柄（使用 RAII 自动管理）
+    // 解析时间戳选项返回的数据
     //-------------------------------------------------------------------------
-    IcmpHandle handle(IcmpCreateFile());
-    if (!handle.valid()) {
-        return result;  // 句柄创建失败
+    if (opts.timestamp > 0 && opt_size >= 4 && opt_data[0] == OPT_TS) {
+        int ptr = opt_data[2];          // 指针位置
+        int count = (ptr - 5) / 4;      // 已记录的时间戳数量
+
+        for (int i = 0; i < count && (size_t)(4 + (i + 1) * 4) <= opt_size; ++i) {
+            uint32_t ts;
+            memcpy(&ts, &opt_data[4 + i * 4], 4);
+            result.timestamps.push_back(ntohl(ts));
+        }
     }
+}
 
-    //-------------------------------------------------------------------------
-    // 准备发送数据（负载）
-    //-------------------------------------------------------------------------
-    std::vector<char> payload(opts.payload_size);
+//=============================================================================
+// 请求构造
+//=============================================================================
+
+/**
+ * @brief 生成指定大小的 Echo 负载
+ *
+ * 负载内容为重复的 "QPING_PAYLOAD_" 字符串，便于在抓包中识别。
+ *
+ * @param size 负载大小（字节）
+ * @return 负载数据
+ */
+std::vector<char> build_payload(int size) {
+    std::vector<char> payload(size);
     const char pattern[] = "QPING_PAYLOAD_";
-    for (int i = 0; i < opts.payload_size; ++i) {
+    for (int i = 0; i < size; ++i) {
         payload[i] = pattern[i % (sizeof(pattern) - 1)];
     }
+    return payload;
+}
 
+/**
+ * @brief 根据 Ping 选项构造 IPv4 选项信息
+ *
+ * 设置 TTL、TOS、DF 标志，并按优先级（严格源路由 > 宽松源路由 >
+ * 时间戳 > 记录路由）填充一个 IP 选项。
+ *
+ * @param opts Ping 配置选项
+ * @param[out] options_buffer 选项数据缓冲区，ipopt.OptionsData 指向其内部，
+ *             使用 ipopt 期间必须保持有效
+ * @param[out] ipopt 构造好的 IP 选项信息
+ * @return 成功返回 true，源路由中包含无效地址时返回 false 并输出错误信息
+ */
+bool build_ip_options(const PingOptions& opts,
+                      std::vector<unsigned char>& options_buffer,
+                      IP_OPTION_INFORMATION& ipopt) {
     //-------------------------------------------------------------------------
     // 配置 IP 选项
     //-------------------------------------------------------------------------
-    IP_OPTION_INFORMATION ipopt = {};
+    ipopt = IP_OPTION_INFORMATION();
     ipopt.Ttl = (UCHAR)opts.ttl;      // 生存时间
     ipopt.Tos = (UCHAR)opts.tos;      // 服务类型
     ipopt.Flags = opts.dont_fragment ? 0x2 : 0x0;  // DF 标志
 
     // 选项数据缓冲区
-    std::vector<unsigned char> options_buffer(64, 0);
+    options_buffer.assign(64, 0);
     bool use_options = false;
 
     //-------------------------------------------------------------------------
@@ -132,7 +148,7 @@ PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
             in_addr addr;
             if (InetPtonA(AF_INET, opts.strict_source_route[i].c_str(), &addr) != 1) {
                 fprintf(stderr, "源路由中的无效IP: %s\n", opts.strict_source_route[i].c_str());
-                return result;
+                return false;
             }
             memcpy(&options_buffer[3 + i * 4], &addr.S_un.S_addr, 4);
         }
@@ -158,7 +174,7 @@ PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
             in_addr addr;
             if (InetPtonA(AF_INET, opts.loose_source_route[i].c_str(), &addr) != 1) {
                 fprintf(stderr, "源路由中的无效IP: %s\n", opts.loose_source_route[i].c_str());
-                return result;
+                return false;
             }
             memcpy(&options_buffer[3 + i * 4], &addr.S_un.S_addr, 4);
         }
@@ -207,6 +223,125 @@ PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
         ipopt.OptionsData = nullptr;
     }
 
+    return true;
+}
+
+//=============================================================================
+// IPv4 选项策略
+//=============================================================================
+
+/**
+ * @brief IPv4 探测路径的选项策略：不带 IP 选项（默认路径）
+ *
+ * 只设置 TTL、TOS 和 DF，不分配选项缓冲区，也不解析回复中的选项；
+ * 编译后的探测路径不含任何源路由、时间戳、记录路由相关的分支。
+ */
+struct NoIpOptions {
+    static bool build(const PingOptions& opts, std::vector<unsigned char>&,
+                      IP_OPTION_INFORMATION& ipopt) {
+        ipopt = IP_OPTION_INFORMATION();
+        ipopt.Ttl = (UCHAR)opts.ttl;
+        ipopt.Tos = (UCHAR)opts.tos;
+        ipopt.Flags = opts.dont_fragment ? 0x2 : 0x0;
+        return true;
+    }
+
+    static void parse(const IP_OPTION_INFORMATION&, const PingOptions&, PingResult&) {}
+};
+
+/**
+ * @brief IPv4 探测路径的选项策略：带 -r / -s / -j / -k 选项
+ */
+struct WithIpOptions {
+    static bool build(const PingOptions& opts, std::vector<unsigned char>& options_buffer,
+                      IP_OPTION_INFORMATION& ipopt) {
+        return build_ip_options(opts, options_buffer, ipopt);
+    }
+
+    static void parse(const IP_OPTION_INFORMATION& reply_opts, const PingOptions& opts,
+                      PingResult& result) {
+        if (reply_opts.OptionsSize > 0 && reply_opts.OptionsData) {
+            parse_reply_options(reply_opts.OptionsData, reply_opts.OptionsSize, opts, result);
+        }
+    }
+};
+
+/**
+ * @brief 是否使用了任一 IPv4 选项（-r / -s / -j / -k）
+ */
+bool uses_ip_options(const PingOptions& opts) {
+    return opts.record_route > 0 || opts.timestamp > 0 ||
+           !opts.loose_source_route.empty() || !opts.strict_source_route.empty();
+}
+
+//=============================================================================
+// IPv4 Ping 实现
+//=============================================================================
+
+/**
+ * @brief 执行 IPv4 ICMP Echo 请求（按选项策略特化）
+ *
+ * 使用 Windows IcmpSendEcho API 向指定的 IPv4 地址发送 ICMP Echo 请求，
+ * 并等待回复。支持多种高级 IP 选项，包括：
+ * - TTL（生存时间）和 TOS（服务类型）设置
+ * - DF（不分段）标志
+ * - 记录路由选项（-r）
+ * - 时间戳选项（-s）
+ * - 宽松源路由（-j）和严格源路由（-k）
+ *
+ * @param ip 目标 IPv4 地址字符串（点分十进制格式）
+ * @param opts Ping 配置选项，包含超时、负载大小、TTL 等参数
+ * @return PingResult 结构，包含操作结果和统计信息
+ *
+ * @note 源地址选项（-S）在 IcmpSendEcho 中不支持，会显示警告
+ *
+ * @see PingOptions
+ * @see PingResult
+ *
+ * @example
+ * @code
+ * PingOptions opts;
+ * opts.timeout_ms = 1000;
+ * opts.payload_size = 32;
+ * opts.ttl = 64;
+ *
+ * PingResult result = ping_ipv4("192.168.1.1", opts);
+ * if (result.success) {
+ *     printf("RTT: %lu ms, TTL: %lu\n", result.rtt_ms, result.reply_ttl);
+ * }
+ * @endcode
+ */
+template <class OptionPolicy>
+static PingResult ping_ipv4_impl(const std::string& ip, const PingOptions& opts) {
+    PingResult result;
+
+    //-------------------------------------------------------------------------
+    // 解析目标地址
+    //-------------------------------------------------------------------------
+    IN_ADDR dest;
+    if (InetPtonA(AF_INET, ip.c_str(), &dest) != 1) {
+        return result;  // 地址解析失败
+    }
+
+    //-------------------------------------------------------------------------
+    // 创建 ICMP 句柄（使用 RAII 自动管理）
+    //-------------------------------------------------------------------------
+    IcmpHandle handle(IcmpCreateFile());
+    if (!handle.valid()) {
+        return result;  // 句柄创建失败
+    }
+
+    //-------------------------------------------------------------------------
+    // 准备发送数据（负载）和 IP 选项
+    //-------------------------------------------------------------------------
+    std::vector<char> payload = build_payload(opts.payload_size);
+
+    IP_OPTION_INFORMATION ipopt;
+    std::vector<unsigned char> options_buffer;
+    if (!OptionPolicy::build(opts, options_buffer, ipopt)) {
+        return result;  // 源路由地址无效
+    }
+
     //-------------------------------------------------------------------------
     // 源地址警告（IcmpSendEcho 不支持指定源地址）
     //-------------------------------------------------------------------------
@@ -216,6 +351,22 @@ PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
         source_addr_warned = true;
     }
 
+    //-------------------------------------------------------------------------
+    // 记录发送的请求（--pcap）
+    //-------------------------------------------------------------------------
+    IN_ADDR local = {};
+    uint16_t seq = 0;
+    if (opts.pcap) {
+        if (!opts.source_address.empty()) {
+            InetPtonA(AF_INET, opts.source_address.c_str(), &local);
+        }
+        seq = opts.pcap->next_sequence();
+        opts.pcap->record_echo(AF_INET, false, &local, &dest, seq, opts.ttl, opts.tos,
+                               payload.data(), payload.size(),
+                               ipopt.OptionsData, ipopt.OptionsSize,
+                               PcapWriter::now_ns());
+    }
+
     //-------------------------------------------------------------------------
     // 发送 ICMP Echo 请求并等待回复
     //-------------------------------------------------------------------------
@@ -244,57 +395,44 @@ PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
             result.rtt_ms = reply->RoundTripTime;
             result.reply_ttl = reply->Options.Ttl;
 
-            //------------------------------------------------------------------
-            // 解析记录路由选项返回的数据
-            //------------------------------------------------------------------
-            if (opts.record_route > 0 &&
-                reply->Options.OptionsSize > 0 &&
-                reply->Options.OptionsData) {
-
-                unsigned char* opt_data = reply->Options.OptionsData;
-
-                // 验证选项类型并提取路由信息
-                if (opt_data[0] == OPT_RR && reply->Options.OptionsSize >= 3) {
-                    int ptr = opt_data[2];          // 指针位置
-                    int count = (ptr - 4) / 4;      // 已记录的 IP 数量
-
-                    for (int i = 0; i < count &&
-                         (3 + (i + 1) * 4) <= reply->Options.OptionsSize; ++i) {
-                        result.route_hops.push_back(
-                            format_route_ip(&opt_data[3 + i * 4])
-                        );
-                    }
-                }
+            // 记录收到的回复（--pcap）
+            if (opts.pcap) {
+                opts.pcap->record_echo(AF_INET, true, &reply->Address, &local, seq,
+                                       reply->Options.Ttl, reply->Options.Tos,
+                                       reply->Data, reply->DataSize,
+                                       reply->Options.OptionsData, reply->Options.OptionsSize,
+                                       PcapWriter::now_ns());
             }
 
             //------------------------------------------------------------------
-            // 解析时间戳选项返回的数据
+            // 解析记录路由和时间戳选项返回的数据
             //------------------------------------------------------------------
-            if (opts.timestamp > 0 &&
-                reply->Options.OptionsSize > 0 &&
-                reply->Options.OptionsData) {
-
-                unsigned char* opt_data = reply->Options.OptionsData;
-
-                // 验证选项类型并提取时间戳
-                if (opt_data[0] == OPT_TS && reply->Options.OptionsSize >= 4) {
-                    int ptr = opt_data[2];          // 指针位置
-                    int count = (ptr - 5) / 4;      // 已记录的时间戳数量
-
-                    for (int i = 0; i < count &&
-                         (4 + (i + 1) * 4) <= reply->Options.OptionsSize; ++i) {
-                        uint32_t ts;
-                        memcpy(&ts, &opt_data[4 + i * 4], 4);
-                        result.timestamps.push_back(ntohl(ts));
-                    }
-                }
-            }
+            OptionPolicy::parse(reply->Options, opts, result);
         }
     }
 
     return result;
 }
 
+/**
+ * @brief 按 IPv4 选项选择特化的探测函数
+ *
+ * 在启动时调用一次，之后每次探测直接调用返回的函数，不再逐项检查选项。
+ */
+PingFunc select_ping_ipv4(const PingOptions& opts) {
+    if (uses_ip_options(opts)) {
+        return &ping_ipv4_impl<WithIpOptions>;
+    }
+    return &ping_ipv4_impl<NoIpOptions>;
+}
+
+/**
+ * @brief 执行 IPv4 Ping 操作（每次按选项选择探测路径）
+ */
+PingResult ping_ipv4(const std::string& ip, const PingOptions& opts) {
+    return select_ping_ipv4(opts)(ip, opts);
+}
+
 //=============================================================================
 // IPv6 Ping 实现
 //=============================================================================
@@ -358,11 +496,7 @@ PingResult ping_ipv6(const std::string& ip, const PingOptions& opts) {
     //-------------------------------------------------------------------------
     // 准备发送数据
     //-------------------------------------------------------------------------
-    std::vector<char> payload(opts.payload_size);
-    const char pattern[] = "QPING_PAYLOAD_";
-    for (int i = 0; i < opts.payload_size; ++i) {
-        payload[i] = pattern[i % (sizeof(pattern) - 1)];
-    }
+    std::vector<char> payload = build_payload(opts.payload_size);
 
     //-------------------------------------------------------------------------
     // 配置 IPv6 选项（仅支持 TTL/跳数限制）
@@ -370,6 +504,17 @@ PingResult ping_ipv6(const std::string& ip, const PingOptions& opts) {
     IP_OPTION_INFORMATION ipopt = {};
     ipopt.Ttl = (UCHAR)opts.ttl;
 
+    //-------------------------------------------------------------------------
+    // 记录发送的请求（--pcap）
+    //-------------------------------------------------------------------------
+    uint16_t seq = 0;
+    if (opts.pcap) {
+        seq = opts.pcap->next_sequence();
+        opts.pcap->record_echo(AF_INET6, false, &src_addr.sin6_addr, &dest_addr.sin6_addr,
+                               seq, opts.ttl, 0, payload.data(), payload.size(),
+                               nullptr, 0, PcapWriter::now_ns());
+    }
+
     //-------------------------------------------------------------------------
     // 发送 ICMPv6 Echo 请求
     //-------------------------------------------------------------------------
@@ -395,19 +540,110 @@ PingResult ping_ipv6(const std::string& ip, const PingOptions& opts) {
     // 处理回复
     //-------------------------------------------------------------------------
     if (res != 0) {
-        PICMP_ECHO_REPLY reply = (PICMP_ECHO_REPLY)reply_buf.data();
+        // IPv6 回复使用 ICMPV6_ECHO_REPLY 结构，回显数据紧随其后
+        PICMPV6_ECHO_REPLY reply = (PICMPV6_ECHO_REPLY)reply_buf.data();
 
         if (reply->Status == IP_SUCCESS) {
             result.success = true;
             result.rtt_ms = reply->RoundTripTime;
             // IPv6 回复中没有 TTL 字段，使用请求时的 TTL 值
             result.reply_ttl = (DWORD)opts.ttl;
+
+            // 记录收到的回复（--pcap）
+            if (opts.pcap) {
+                opts.pcap->record_echo(AF_INET6, true, reply->Address.sin6_addr,
+                                       &src_addr.sin6_addr, seq, opts.ttl, 0,
+                                       reply_buf.data() + sizeof(ICMPV6_ECHO_REPLY),
+                                       payload.size(), nullptr, 0,
+                                       PcapWriter::now_ns());
+            }
         }
     }
 
     return result;
 }
 
+//=============================================================================
+// 选项特化基准测试
+//=============================================================================
+
+/**
+ * @brief 测量某个选项策略每次探测的选项构造和回复解析耗时（纳秒）
+ */
+template <class OptionPolicy>
+static double bench_option_work(const PingOptions& opts, const IP_OPTION_INFORMATION& reply_opts) {
+    volatile size_t sink = 0;
+    IP_OPTION_INFORMATION ipopt;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < OPTIONS_BENCH_ITERATIONS; ++i) {
+        std::vector<unsigned char> buffer;
+        OptionPolicy::build(opts, buffer, ipopt);
+        PingResult result;
+        OptionPolicy::parse(reply_opts, opts, result);
+        sink = sink + ipopt.OptionsSize + result.route_hops.size();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / OPTIONS_BENCH_ITERATIONS;
+}
+
+/**
+ * @brief 以某个探测函数逐个探测本机，返回平均每次探测耗时（微秒）
+ */
+static double bench_loopback(PingFunc fn, const PingOptions& opts, std::atomic<bool>& stop_flag) {
+    int done = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (; done < OPTIONS_BENCH_PROBES && !stop_flag.load(); ++done) {
+        fn("127.0.0.1", opts);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return done ? std::chrono::duration<double, std::micro>(end - begin).count() / done : 0.0;
+}
+
+/**
+ * @brief 比较无选项特化路径和通用选项路径的开销
+ *
+ * 第一部分只运行每次探测中与选项相关的工作（构造选项、解析回复选项），
+ * 通用路径分别以不带选项和带 -r 9（回复中含 9 个记录的地址）运行；
+ * 第二部分用两种路径各逐个探测 127.0.0.1，比较端到端的每次探测耗时。
+ */
+void run_options_benchmark(const PingOptions& opts, std::atomic<bool>& stop_flag) {
+    PingOptions plain = opts;
+    plain.record_route = 0;
+    plain.timestamp = 0;
+    plain.loose_source_route.clear();
+    plain.strict_source_route.clear();
+    plain.pcap = nullptr;
+
+    PingOptions rr = plain;
+    rr.record_route = MAX_RECORD_ROUTE;
+
+    // 模拟一个经过 MAX_RECORD_ROUTE 跳、记录已满的记录路由回复
+    unsigned char rr_data[3 + MAX_RECORD_ROUTE * 4] = {};
+    rr_data[0] = OPT_RR;
+    rr_data[1] = (unsigned char)sizeof(rr_data);
+    rr_data[2] = (unsigned char)(4 + MAX_RECORD_ROUTE * 4);
+    for (int i = 0; i < MAX_RECORD_ROUTE; ++i) {
+        rr_data[3 + i * 4] = 10;
+        rr_data[6 + i * 4] = (unsigned char)(i + 1);
+    }
+    IP_OPTION_INFORMATION no_reply_opts = {};
+    IP_OPTION_INFORMATION rr_reply_opts = {};
+    rr_reply_opts.OptionsData = rr_data;
+    rr_reply_opts.OptionsSize = (UCHAR)sizeof(rr_data);
+
+    printf("\n--- 选项处理开销 (每次探测, %d 次平均) ---\n", OPTIONS_BENCH_ITERATIONS);
+    printf("无选项特化路径:    %8.1f ns\n", bench_option_work<NoIpOptions>(plain, no_reply_opts));
+    printf("通用路径(无选项):  %8.1f ns\n", bench_option_work<WithIpOptions>(plain, no_reply_opts));
+    printf("通用路径(-r %d):    %8.1f ns\n", MAX_RECORD_ROUTE,
+           bench_option_work<WithIpOptions>(rr, rr_reply_opts));
+
+    printf("\n--- 本机回环探测 (127.0.0.1, 各 %d 次) ---\n", OPTIONS_BENCH_PROBES);
+    double fast = bench_loopback(&ping_ipv4_impl<NoIpOptions>, plain, stop_flag);
+    double generic = bench_loopback(&ping_ipv4_impl<WithIpOptions>, plain, stop_flag);
+    printf("无选项特化路径:    %8.2f us/次\n", fast);
+    printf("通用路径(无选项):  %8.2f us/次\n", generic);
+}
+
 //=============================================================================
 // 主机名解析
 //=============================================================================
@@ -512,6 +748,70 @@ std::string resolve_hostname(const std::string& ip, int af) {
     return result;
 }
 
+/**
+ * @brief 启动解析线程
+ */
+HostnameResolver::HostnameResolver(const std::vector<std::string>& targets, int threads)
+    : targets_(targets), requested_(targets.size(), 0) {
+    for (int i = 0; i < std::max(threads, 1); ++i) {
+        threads_.emplace_back(&HostnameResolver::run, this);
+    }
+}
+
+/**
+ * @brief 放弃排队中的解析并等待解析线程退出
+ *
+ * 正在进行的查询最多等待 resolve_hostname 的超时时间。
+ */
+HostnameResolver::~HostnameResolver() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& th : threads_) {
+        th.join();
+    }
+}
+
+/**
+ * @brief 取目标的显示标签，收到回复的目标首次出现时排队解析
+ */
+std::string HostnameResolver::label(size_t idx, bool replied) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = labels_.find(idx);
+    if (it != labels_.end()) {
+        return it->second;
+    }
+    if (replied && !requested_[idx]) {
+        requested_[idx] = 1;
+        queue_.push_back(idx);
+        cv_.notify_one();
+    }
+    return targets_[idx];
+}
+
+/**
+ * @brief 解析线程：按排队顺序逐个反向解析，查询期间不持有锁
+ */
+void HostnameResolver::run() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (;;) {
+        cv_.wait(lk, [this] { return stop_ || head_ < queue_.size(); });
+        if (stop_) {
+            return;
+        }
+        size_t idx = queue_[head_++];
+        lk.unlock();
+        const std::string& addr = targets_[idx];
+        std::string name = resolve_hostname(addr, get_address_family(addr));
+        lk.lock();
+        if (!name.empty()) {
+            labels_[idx] = name + " [" + addr + "]";
+        }
+    }
+}
+
 /**
  * @brief 正向 DNS 解析，将主机名解析为单个 IP 地址
  *
@@ -662,142 +962,4 @@ std::vector<std::string> resolve_to_ips(const std::string& hostname, bool prefer
     return resolved_ips;
 }
 
-/**
- * @brief 检查字符串是否为可能的主机名（不是 IP 地址）
- *
- * 启发式方法判断字符串是否可能为主机名而不是 IP 地址：
- * 1. 首先检查是否为有效的 IPv6 地址（包含冒号）
- * 2. 然后检查是否为有效的 IPv4 地址（包含点号）
- * 3. 如果不是有效的 IP 地址，检查是否可能是域名：
- *    - 包含字母（如 google.com）
- *    - 包含连字符（如 example-site.com）
- *    - 包含多个点号但不是有效的 IP 地址（如 sub.domain.com）
- *    - 常见域名后缀（如 .com, .net, .org 等）
- *
- * @param s 要检查的字符串
- * @return 如果是可能的主机名返回 true，否则返回 false
- *
- * @example
- * @code
- * is_possible_hostname("google.com");    // true
- * is_possible_hostname("192.168.1.1");   // false
- * is_possible_hostname("2001:db8::1");   // false
- * is_possible_hostname("localhost");     // true
- * is_possible_hostname("example-site.com"); // true
- * @endcode
- */
-bool is_possible_hostname(const std::string& s) {
-    // 空字符串不是主机名
-    if (s.empty()) {
-        return false;
-    }
-    
-    //-------------------------------------------------------------------------
-    // 检查是否包含逗号（IP范围分隔符，不是主机名特征）
-    //-------------------------------------------------------------------------
-    if (s.find(',') != std::string::npos) {
-        return false;  // 包含逗号，可能是IP范围格式
-    }
-    
-    //-------------------------------------------------------------------------
-    // 检查是否包含斜杠（CIDR格式分隔符，不是主机名特征）
-    //-------------------------------------------------------------------------
-    if (s.find('/') != std::string::npos) {
-        return false;  // 包含斜杠，可能是CIDR格式
-    }
-    
-    //-------------------------------------------------------------------------
-    // 检查是否为有效的 IPv6 地址
-    //-------------------------------------------------------------------------
-    if (s.find(':') != std::string::npos) {
-        in6_addr addr;
-        if (InetPtonA(AF_INET6, s.c_str(), &addr) == 1) {
-            return false;  // 是有效的 IPv6 地址
-        }
-        // 无效的 IPv6 格式，可能是主机名或格式错误的地址
-    }
-    
-    //-------------------------------------------------------------------------
-    // 检查是否为有效的 IPv4 地址
-    //-------------------------------------------------------------------------
-    if (s.find('.') != std::string::npos) {
-        in_addr addr;
-        if (InetPtonA(AF_INET, s.c_str(), &addr) == 1) {
-            return false;  // 是有效的 IPv4 地址
-        }
-        // 无效的 IPv4 格式，可能是主机名
-    }
-    
-    //-------------------------------------------------------------------------
-    // 启发式判断是否为可能的主机名
-    //-------------------------------------------------------------------------
-    
-    // 1. 检查是否包含字母（主机名通常包含字母）
-    bool has_letter = false;
-    for (char c : s) {
-        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
-            has_letter = true;
-            break;
-        }
-    }
-    if (has_letter) {
-        return true;
-    }
-    
-    // 2. 检查是否包含连字符（如 example-site.com）
-    if (s.find('-') != std::string::npos) {
-        // 检查是否是IP范围格式（如 192.168.2.1-6）
-        // IP范围格式特征：包含点号和连字符，没有字母
-        if (s.find('.') != std::string::npos) {
-            // 检查是否没有字母（IP范围通常只有数字、点和连字符）
-            bool has_letter = false;
-            for (char c : s) {
-                if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
-                    has_letter = true;
-                    break;
-                }
-            }
-            if (!has_letter) {
-                // 可能是IP范围格式，不是主机名
-                return false;
-            }
-        }
-        // 否则可能是包含连字符的主机名（如 example-site.com）
-        return true;
-    }
-    
-    // 3. 检查是否包含多个点号（如 sub.domain.com）
-    size_t dot_count = 0;
-    for (char c : s) {
-        if (c == '.') {
-            dot_count++;
-        }
-    }
-    if (dot_count >= 2) {
-        return true;  // 多个点号通常是域名
-    }
-    
-    // 4. 检查常见域名后缀（即使没有字母）
-    static const std::vector<std::string> common_tlds = {
-        ".com", ".net", ".org", ".edu", ".gov", ".mil",
-        ".cn", ".uk", ".jp", ".de", ".fr", ".ru",
-        ".info", ".biz", ".name", ".mobi", ".io", ".ai"
-    };
-    
-    for (const auto& tld : common_tlds) {
-        if (s.size() >= tld.size() && 
-            s.compare(s.size() - tld.size(), tld.size(), tld) == 0) {
-            return true;
-        }
-    }
-    
-    // 5. 检查是否为 "localhost"（特殊域名，没有点号）
-    if (s == "localhost" || s == "LOCALHOST") {
-        return true;
-    }
-    
-    // 不符合任何主机名特征
-    return false;
-}
-
 } // namespace qping
@@ -24,8 +24,10 @@
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
+#include <mmsystem.h>
 #include <iphlpapi.h>
 #include <icmpapi.h>
+#include <intrin.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,11 +36,15 @@
 #include <vector>
 #include <string>
 #include <unordered_set>
+#include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <chrono>
 #include <algorithm>
 #include <exception>
+#include <functional>
+#include <memory>
 
 #ifndef _WIN32
 #error "本程序仅限Windows平台"
@@ -46,6 +52,14 @@
 
 #pragma comment(lib, "iphlpapi.lib")
 #pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "winmm.lib")
+
+// TSC 只存在于 x86/x64，其他架构（如 ARM64）固定使用性能计数器
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define QPING_HAS_TSC 1
+#else
+#define QPING_HAS_TSC 0
+#endif
 
 /**
  * @namespace qping
@@ -67,144 +81,2226 @@ constexpr const char* VERSION = "1.2.0";
 /** @brief 默认并发线程数 */
 constexpr int DEFAULT_CONCURRENCY = 100;
 
-/** @brief 默认超时时间（毫秒） */
-constexpr int DEFAULT_TIMEOUT_MS = 1000;
+/** @brief 默认超时时间（毫秒） */
+constexpr int DEFAULT_TIMEOUT_MS = 1000;
+
+/** @brief 默认发送数据包大小（字节） */
+constexpr int DEFAULT_PAYLOAD_SIZE = 32;
+
+/** @brief 默认 TTL（生存时间）值 */
+constexpr int DEFAULT_TTL = 128;
+
+/** @brief 最大发送数据包大小（字节） */
+constexpr int MAX_PAYLOAD_SIZE = 65500;
+
+/** @brief 默认最大目标主机数限制 */
+constexpr unsigned int MAX_HOSTS_DEFAULT = 65536;
+
+/** @brief 构建目标表时每个展开线程至少处理的地址数 */
+constexpr uint64_t TARGET_EXPAND_CHUNK = 16384;
+
+/** @brief 并行解析主机名的最大线程数 */
+constexpr int TARGET_RESOLVE_THREADS = 16;
+
+/** @brief 引擎模式下 -a 后台反向解析的线程数 */
+constexpr int LABEL_RESOLVE_THREADS = 4;
+
+//=============================================================================
+// 探测引擎常量
+//=============================================================================
+
+/** @brief --window 允许的最大每目标在途探测数 */
+constexpr int MAX_WINDOW = 64;
+
+/** @brief 单个引擎线程的探测槽位上限（WaitForMultipleObjects 一次最多等待的句柄数） */
+constexpr int ENGINE_SLOTS_PER_THREAD = MAXIMUM_WAIT_OBJECTS;
+
+/** @brief 迟到回复的等待倍数：ICMP API 超时设为 -w 的该倍数，期间到达的超时回复计为迟到 */
+constexpr int LATE_REPLY_GRACE_FACTOR = 2;
+
+/** @brief 引擎线程单次等待的最长时间（毫秒），保证及时响应停止标志 */
+constexpr int ENGINE_MAX_WAIT_MS = 50;
+
+/** @brief --quorum / --select-best 时主线程检查停止标志的间隔（毫秒），即结论确定后到返回的额外延迟 */
+constexpr int EARLY_EXIT_POLL_MS = 1;
+
+/** @brief --cpus 可绑定的最大 CPU 编号 + 1（线程亲和性掩码的位数） */
+constexpr int MAX_CPUS = (int)(sizeof(DWORD_PTR) * 8);
+
+/** @brief --scaling 每个线程数级别的测试时间（毫秒） */
+constexpr int SCALING_STEP_MS = 2000;
+
+/** @brief --rtt-floor 每种等待方式的探测次数 */
+constexpr int RTT_FLOOR_PROBES = 2000;
+
+/** @brief --flows 允许的最大每目标流数 */
+constexpr int MAX_FLOWS = 16;
+
+/** @brief 流的丢失率比同一目标其他流的合计高出该值（百分点）时标记为异常 */
+constexpr double FLOW_LOSS_MARGIN = 10.0;
+
+/** @brief 流标记占用的负载字节数（--flows 要求负载不小于该值） */
+constexpr int FLOW_KEY_BYTES = 2;
+
+/** @brief --simulate-ecmp 允许的最大模拟路径数 */
+constexpr int ECMP_SIM_MAX_PATHS = 64;
+
+//=============================================================================
+// 时钟常量
+//=============================================================================
+
+/** @brief 启动时每个 TSC 校准窗口的长度（毫秒） */
+constexpr int CLOCK_CALIBRATE_MS = 10;
+
+/** @brief 运行中重新校准 TSC 换算系数的周期（毫秒） */
+constexpr int CLOCK_RECALIBRATE_MS = 1000;
+
+/** @brief 两个校准窗口的 TSC 速率允许的最大相对偏差，超过则退回性能计数器 */
+constexpr double CLOCK_TSC_MAX_DRIFT = 0.001;
+
+/** @brief 读取一对 TSC / 性能计数器值时的尝试次数（取间隔最短的一次） */
+constexpr int CLOCK_PAIR_TRIES = 5;
+
+//=============================================================================
+// 洪泛模式常量
+//=============================================================================
+
+/** @brief --flood 允许的最大发送速率（每秒请求数），防止误用压垮目标 */
+constexpr int FLOOD_MAX_PPS = 100000;
+
+/** @brief --flood 允许的最大目标数 */
+constexpr int FLOOD_MAX_TARGETS = 16;
+
+/** @brief 洪泛模式速率递增的级数，第 k 级速率为上限的 k/FLOOD_RAMP_STEPS */
+constexpr int FLOOD_RAMP_STEPS = 10;
+
+/** @brief 洪泛模式每级持续时间（毫秒） */
+constexpr int FLOOD_STEP_MS = 1000;
+
+/** @brief 判定开始丢包的丢失率阈值（百分比） */
+constexpr double FLOOD_LOSS_THRESHOLD = 1.0;
+
+//=============================================================================
+// 发送时间分解常量
+//=============================================================================
+
+/** @brief 分解直方图每个 2 的幂区间细分的桶数的对数（3 表示 8 个子桶，精度约 12%） */
+constexpr int SEND_TIMING_SUB_BITS = 3;
+
+/** @brief 分解直方图的桶数，覆盖 0 到 2^32 微秒 */
+constexpr int SEND_TIMING_BUCKETS = (32 - SEND_TIMING_SUB_BITS + 1) << SEND_TIMING_SUB_BITS;
+
+//=============================================================================
+// 最优端点选择常量
+//=============================================================================
+
+/** @brief --select-best 每个候选最多探测次数，用尽时取平均 RTT 最低者 */
+constexpr int SELECT_MAX_PROBES = 20;
+
+/** @brief 开始淘汰前每个候选至少需要的样本数 */
+constexpr int SELECT_MIN_SAMPLES = 3;
+
+/** @brief --select-best 未指定 --interval 时的探测间隔（毫秒） */
+constexpr int SELECT_INTERVAL_MS = 100;
+
+//=============================================================================
+// 广播/组播发现常量
+//=============================================================================
+
+/** @brief --discover 每个请求的回复缓冲区最多容纳的回复数 */
+constexpr int DISCOVER_MAX_REPLIES = 256;
+
+/** @brief --discover 未指定 -n 时每个目标的探测次数 */
+constexpr int DISCOVER_DEFAULT_PROBES = 3;
+
+//=============================================================================
+// 自适应速率常量
+//=============================================================================
+
+/** @brief --aimd 的初始发送速率（每秒请求数） */
+constexpr int AIMD_START_PPS = 100;
+
+/** @brief --aimd 回退的最低速率 */
+constexpr int AIMD_MIN_PPS = 10;
+
+/** @brief 每个评估周期无明显丢失时速率的加性增量 */
+constexpr int AIMD_INCREASE_PPS = 50;
+
+/** @brief --aimd 的初始全局在途上限 */
+constexpr int AIMD_START_WINDOW = 16;
+
+/** @brief 回退的最低在途上限 */
+constexpr int AIMD_MIN_WINDOW = 4;
+
+/** @brief 每个评估周期无明显丢失时在途上限的加性增量 */
+constexpr int AIMD_WINDOW_STEP = 4;
+
+/** @brief --aimd 在途上限的最大值（同时决定引擎的槽位数） */
+constexpr int AIMD_MAX_IN_FLIGHT = 2048;
+
+/** @brief 丢失超过阈值时速率和在途上限的乘性系数 */
+constexpr double AIMD_DECREASE_FACTOR = 0.5;
+
+/** @brief 评估周期（毫秒） */
+constexpr int AIMD_EPOCH_MS = 250;
+
+/** @brief 已知在线目标的丢失率超过该值时回退 */
+constexpr double AIMD_LOSS_THRESHOLD = 0.05;
+
+/** @brief 调整速率所需的最少已知在线样本数，不足时保持不变 */
+constexpr int AIMD_MIN_SAMPLES = 5;
+
+/** @brief 速率日志最多保留的行数，超过时相邻两行合并 */
+constexpr int AIMD_MAX_LOG_ROWS = 40;
+
+/** @brief 全局在途上限已满时引擎线程重新检查的间隔（毫秒） */
+constexpr int AIMD_CAP_POLL_MS = 1;
+
+/** @brief 每个周期重新探测的金丝雀目标数（所有引擎线程合计） */
+constexpr int AIMD_CANARY_TARGETS = 8;
+
+//=============================================================================
+// 前缀限速常量
+//=============================================================================
+
+/** @brief --prefix-rate 默认的 IPv4 前缀长度 */
+constexpr int PREFIX_DEFAULT_LEN = 24;
+
+/** @brief --prefix-rate 对 IPv6 目标使用的前缀长度 */
+constexpr int PREFIX_IPV6_LEN = 64;
+
+/** @brief 每个前缀的令牌桶容量（允许的突发探测数） */
+constexpr int PREFIX_BURST = 2;
+
+/** @brief --prefix-rate 允许的最大值（每秒请求数） */
+constexpr int PREFIX_MAX_PPS = 10000;
+
+//=============================================================================
+// 负载大小扫描常量
+//=============================================================================
+
+/** @brief --size-sweep 允许的最大大小级数 */
+constexpr int MAX_SWEEP_SIZES = 1024;
+
+/** @brief --size-sweep 未指定 --interval 时的默认探测间隔（毫秒） */
+constexpr int SIZE_SWEEP_INTERVAL_MS = 100;
+
+/** @brief 判定某一大小开始丢包的丢失率阈值（百分比） */
+constexpr double SIZE_SWEEP_LOSS_THRESHOLD = 50.0;
+
+/** @brief 目标数不超过该值时输出每个大小的明细表 */
+constexpr size_t SIZE_SWEEP_TABLE_TARGETS = 4;
+
+//=============================================================================
+// 统计抽样常量
+//=============================================================================
+
+/** @brief 抽样模式每批探测的地址数，每批结束后更新估计并检查是否提前停止 */
+constexpr size_t SAMPLE_BATCH_SIZE = 1024;
+
+/** @brief 允许提前停止前的最少抽样数，避免小样本下区间估计失真 */
+constexpr uint64_t SAMPLE_MIN_PROBES = 256;
+
+/** @brief --confidence 未指定 --margin 时的目标区间半宽（在线比例的绝对值） */
+constexpr double SAMPLE_DEFAULT_MARGIN = 0.01;
+
+/** @brief 抽样报告中按估计在线数列出的 /16 前缀数上限 */
+constexpr size_t SAMPLE_REPORT_PREFIXES = 32;
+
+//=============================================================================
+// 历史归档常量
+//=============================================================================
+
+/** @brief 归档分段的时间跨度（毫秒），分段按该跨度对齐切分 */
+constexpr uint64_t ARCHIVE_SEGMENT_MS = 3600ull * 1000;
+
+/** @brief 归档目录中的分段索引文件名 */
+constexpr const char* ARCHIVE_INDEX_FILE = "segments.idx";
+
+//=============================================================================
+// 共享内存统计常量
+//=============================================================================
+
+/** @brief 共享内存区域 magic（"QPSH"） */
+constexpr uint32_t SHM_MAGIC = 0x48535051;
+
+/** @brief 共享内存布局版本，布局不兼容变化时递增 */
+constexpr uint32_t SHM_VERSION = 1;
+
+/** @brief RTT 直方图桶数，第 i 桶为 [2^i, 2^(i+1)) 微秒（第 0 桶含 0） */
+constexpr int SHM_HIST_BUCKETS = 24;
+
+/** @brief 每条记录中目标地址字段的长度（含结尾 0） */
+constexpr size_t SHM_ADDR_LEN = 48;
+
+/** @brief 共享内存状态：运行中 */
+constexpr uint32_t SHM_STATE_RUNNING = 1;
+
+/** @brief 共享内存状态：已结束 */
+constexpr uint32_t SHM_STATE_FINISHED = 2;
+
+//=============================================================================
+// 排除列表常量
+//=============================================================================
+
+/** @brief 排除文件 magic（"QPXF"） */
+constexpr uint32_t EXCLUDE_MAGIC = 0x46585051;
+
+/** @brief 排除文件格式版本 */
+constexpr uint32_t EXCLUDE_VERSION = 1;
+
+/** @brief Bloom 过滤器块大小（字节，一个缓存行），一次查询只访问一个块 */
+constexpr size_t EXCLUDE_BLOCK_BYTES = 64;
+
+/** @brief 每个地址分配的过滤器位数（约 1-2% 误判率，误判由排序数组排除） */
+constexpr uint64_t EXCLUDE_BLOOM_BITS_PER_ENTRY = 10;
+
+/** @brief 每个地址在块内设置的位数 */
+constexpr int EXCLUDE_BLOOM_HASHES = 6;
+
+//=============================================================================
+// 编译目标集常量
+//=============================================================================
+
+/** @brief 目标集文件 magic（"QPTS"） */
+constexpr uint32_t TARGETSET_MAGIC = 0x53545051;
+
+/** @brief 目标集文件格式版本 */
+constexpr uint32_t TARGETSET_VERSION = 1;
+
+/** @brief 目标集中保存的来源描述最大长度（字节） */
+constexpr size_t TARGETSET_SOURCE_MAX = 4096;
+
+//=============================================================================
+// 存活缓存常量
+//=============================================================================
+
+/** @brief 存活缓存文件 magic（"QPLC"） */
+constexpr uint32_t LIVENESS_MAGIC = 0x434C5051;
+
+/** @brief 存活缓存文件格式版本 */
+constexpr uint32_t LIVENESS_VERSION = 1;
+
+/** @brief 缓存条目的保留时间（毫秒），保存时丢弃更早的条目 */
+constexpr uint64_t LIVENESS_RETAIN_MS = 7ull * 24 * 3600 * 1000;
+
+//=============================================================================
+// 延迟草图常量
+//=============================================================================
+
+/** @brief 结果文件 magic（"QPSK"） */
+constexpr uint32_t SKETCH_MAGIC = 0x4B535051;
+
+/** @brief 结果文件格式版本 */
+constexpr uint32_t SKETCH_VERSION = 1;
+
+/** @brief 草图分位数的相对误差上限（桶边界之比为 (1+α)/(1-α)） */
+constexpr double SKETCH_ALPHA = 0.01;
+
+/** @brief 解码时允许的最大桶序号和桶数（1 微秒到 2^32 微秒约需 1100 个桶） */
+constexpr int SKETCH_MAX_BUCKETS = 4096;
+
+//=============================================================================
+// IP 选项常量
+//=============================================================================
+
+/** @brief 记录路由选项最大跳数 */
+constexpr int MAX_RECORD_ROUTE = 9;
+
+/** @brief 时间戳选项最大数量 */
+constexpr int MAX_TIMESTAMP = 4;
+
+/** @brief 源路由选项最大节点数 */
+constexpr int MAX_SOURCE_ROUTE = 9;
+
+/** @brief IP 选项类型：记录路由 (Record Route) */
+constexpr UCHAR OPT_RR = 0x07;
+
+/** @brief IP 选项类型：时间戳 (Timestamp) */
+constexpr UCHAR OPT_TS = 0x44;
+
+/** @brief IP 选项类型：宽松源路由 (Loose Source and Record Route) */
+constexpr UCHAR OPT_LSRR = 0x83;
+
+/** @brief IP 选项类型：严格源路由 (Strict Source and Record Route) */
+constexpr UCHAR OPT_SSRR = 0x89;
+
+/** @brief --bench-options 选项处理微基准的迭代次数 */
+constexpr int OPTIONS_BENCH_ITERATIONS = 1000000;
+
+/** @brief --bench-options 每种路径的本机回环探测次数 */
+constexpr int OPTIONS_BENCH_PROBES = 2000;
+
+//=============================================================================
+// 抓包导出常量
+//=============================================================================
+
+/** @brief pcap 链路类型：原始 IP 数据包（LINKTYPE_RAW，IPv4/IPv6 自动区分） */
+constexpr uint32_t PCAP_LINKTYPE_RAW = 101;
+
+/** @brief pcap 单个数据包最大捕获长度（字节） */
+constexpr uint32_t PCAP_SNAPLEN = 65535;
+
+/** @brief pcap 写入缓冲区积压上限（字节），超过后丢弃新记录以保护探测性能 */
+constexpr size_t PCAP_MAX_BACKLOG = 64 * 1024 * 1024;
+
+/** @brief pcap 链路类型：以太网（回放时剥离 14 字节以太网头） */
+constexpr uint32_t PCAP_LINKTYPE_ETHERNET = 1;
+
+/** @brief pcap 链路类型：IPv4 */
+constexpr uint32_t PCAP_LINKTYPE_IPV4 = 228;
+
+/** @brief pcap 链路类型：IPv6 */
+constexpr uint32_t PCAP_LINKTYPE_IPV6 = 229;
+
+//=============================================================================
+// 类定义
+//=============================================================================
+
+/**
+ * @class IcmpHandle
+ * @brief ICMP 句柄的 RAII 封装类
+ *
+ * 该类使用 RAII（资源获取即初始化）模式管理 Windows ICMP API 句柄，
+ * 确保句柄在对象生命周期结束时自动释放，防止资源泄漏。
+ *
+ * @note 该类禁用了拷贝构造和拷贝赋值，以防止句柄被多次关闭
+ *
+ * @example
+ * @code
+ * IcmpHandle handle(IcmpCreateFile());
+ * if (handle.valid()) {
+ *     // 使用 handle.get() 进行 ICMP 操作
+ * }
+ * // 句柄在作用域结束时自动关闭
+ * @endcode
+ */
+class IcmpHandle {
+public:
+    /**
+     * @brief 构造函数
+     * @param h Windows ICMP 句柄
+     */
+    explicit IcmpHandle(HANDLE h) : handle_(h) {}
+
+    /**
+     * @brief 析构函数，自动关闭有效的 ICMP 句柄
+     */
+    ~IcmpHandle() {
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            IcmpCloseHandle(handle_);
+        }
+    }
+
+    /**
+     * @brief 获取底层句柄
+     * @return ICMP 句柄
+     */
+    HANDLE get() const { return handle_; }
+
+    /**
+     * @brief 提前关闭句柄，挂起的异步请求随之取消
+     */
+    void close() {
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            IcmpCloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    /**
+     * @brief 检查句柄是否有效
+     * @return 如果句柄有效返回 true，否则返回 false
+     */
+    bool valid() const { return handle_ != INVALID_HANDLE_VALUE; }
+
+    // 禁用拷贝
+    IcmpHandle(const IcmpHandle&) = delete;
+    IcmpHandle& operator=(const IcmpHandle&) = delete;
+
+private:
+    HANDLE handle_;  ///< Windows ICMP 句柄
+};
+
+/**
+ * @class PcapWriter
+ * @brief 发送/接收 ICMP 数据包的 pcap 导出器
+ *
+ * 探测线程调用 record_echo() 将合成的 IP/ICMP 数据包序列化到内存缓冲区，
+ * 由专用写入线程批量交换缓冲区并写入文件，探测路径上只有一次短暂加锁和内存拷贝。
+ * 文件使用纳秒精度时间戳格式（magic 0xA1B23C4D）和 LINKTYPE_RAW 链路类型。
+ *
+ * @note Windows ICMP API 不暴露真实的 ICMP 标识符和序列号，
+ *       记录中使用进程 ID 作为标识符、next_sequence() 分配的序号配对请求与回复
+ */
+class PcapWriter {
+public:
+    PcapWriter() = default;
+
+    /**
+     * @brief 析构函数，自动刷新并关闭文件
+     */
+    ~PcapWriter() { close(); }
+
+    /**
+     * @brief 创建 pcap 文件并启动写入线程
+     * @param path 输出文件路径
+     * @return 成功返回 true，失败返回 false
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief 刷新剩余数据、停止写入线程并关闭文件
+     */
+    void close();
+
+    /**
+     * @brief 检查文件是否已打开
+     * @return 已打开返回 true
+     */
+    bool is_open() const { return file_ != nullptr; }
+
+    /**
+     * @brief 分配下一个 ICMP 序列号，用于配对请求和回复
+     * @return 16 位序列号
+     */
+    uint16_t next_sequence() { return (uint16_t)seq_.fetch_add(1); }
+
+    /**
+     * @brief 记录一个 ICMP Echo 请求或回复
+     * @param af 地址族（AF_INET 或 AF_INET6）
+     * @param is_reply true 表示 Echo 回复，false 表示 Echo 请求
+     * @param src 源地址（in_addr 或 in6_addr），可为 nullptr 表示未指定
+     * @param dst 目标地址（in_addr 或 in6_addr），可为 nullptr 表示未指定
+     * @param seq ICMP 序列号
+     * @param ttl IP TTL / IPv6 跳数限制
+     * @param tos IPv4 服务类型（IPv6 忽略）
+     * @param payload ICMP 负载数据
+     * @param payload_len 负载长度
+     * @param ip_options IPv4 选项数据（可为 nullptr）
+     * @param options_len IPv4 选项长度
+     * @param timestamp_ns 时间戳（自 1970 年起的纳秒数，见 now_ns()）
+     */
+    void record_echo(int af, bool is_reply, const void* src, const void* dst,
+                     uint16_t seq, int ttl, int tos,
+                     const void* payload, size_t payload_len,
+                     const void* ip_options, size_t options_len,
+                     uint64_t timestamp_ns);
+
+    /**
+     * @brief 获取已写入的数据包数量
+     * @return 数据包数量
+     */
+    uint64_t packet_count() const { return packets_.load(); }
+
+    /**
+     * @brief 获取因缓冲区积压而丢弃的数据包数量
+     * @return 丢弃数量
+     */
+    uint64_t dropped_count() const { return dropped_.load(); }
+
+    /**
+     * @brief 获取当前时间戳
+     * @return 自 1970 年起的纳秒数（系统时间基准 + 性能计数器偏移）
+     */
+    static uint64_t now_ns();
+
+    // 禁用拷贝
+    PcapWriter(const PcapWriter&) = delete;
+    PcapWriter& operator=(const PcapWriter&) = delete;
+
+private:
+    void writer_loop();
+
+    FILE* file_ = nullptr;                   ///< 输出文件
+    std::thread writer_;                     ///< 写入线程
+    std::mutex mtx_;                         ///< 保护 pending_ 和 stopping_
+    std::condition_variable cv_;             ///< 唤醒写入线程
+    std::vector<unsigned char> pending_;     ///< 待写入的序列化记录
+    bool stopping_ = false;                  ///< 写入线程停止标志
+    std::atomic<uint32_t> seq_{0};           ///< 序列号分配器
+    std::atomic<uint64_t> packets_{0};       ///< 已记录数据包数
+    std::atomic<uint64_t> dropped_{0};       ///< 已丢弃数据包数
+};
+
+/**
+ * @struct PcapPacket
+ * @brief pcap 文件中的一个数据包（指向内存映射区域，不拷贝）
+ */
+struct PcapPacket {
+    uint64_t timestamp_ns = 0;               ///< 时间戳（自 1970 年起的纳秒数）
+    const unsigned char* data = nullptr;     ///< IP 头起始位置（已剥离链路层）
+    uint32_t length = 0;                     ///< 捕获长度（不含链路层）
+};
+
+/**
+ * @class PcapReader
+ * @brief 基于内存映射的 pcap 顺序读取器
+ *
+ * 整个文件映射到内存后逐条返回数据包指针，读取过程中不分配内存、
+ * 不拷贝数据。支持微秒/纳秒精度格式以及原始 IP、IPv4、IPv6 和以太网链路类型。
+ */
+class PcapReader {
+public:
+    PcapReader() = default;
+
+    /**
+     * @brief 析构函数，自动解除映射并关闭文件
+     */
+    ~PcapReader() { close(); }
+
+    /**
+     * @brief 打开并映射 pcap 文件，校验文件头
+     * @param path 文件路径
+     * @return 成功返回 true，失败返回 false 并输出错误信息
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief 解除映射并关闭文件
+     */
+    void close();
+
+    /**
+     * @brief 回到第一个数据包
+     */
+    void rewind() { offset_ = 24; }
+
+    /**
+     * @brief 读取下一个 IP 数据包（跳过非 IP 帧）
+     * @param[out] pkt 数据包信息
+     * @return 读到数据包返回 true，文件结束或记录损坏返回 false
+     */
+    bool next(PcapPacket& pkt);
+
+    // 禁用拷贝
+    PcapReader(const PcapReader&) = delete;
+    PcapReader& operator=(const PcapReader&) = delete;
+
+private:
+    HANDLE file_ = INVALID_HANDLE_VALUE;     ///< 文件句柄
+    HANDLE mapping_ = nullptr;               ///< 文件映射句柄
+    const unsigned char* base_ = nullptr;    ///< 映射基址
+    size_t size_ = 0;                        ///< 文件大小
+    size_t offset_ = 0;                      ///< 当前读取位置
+    bool nanosecond_ = false;                ///< 是否为纳秒精度格式
+    uint32_t linktype_ = 0;                  ///< 链路类型
+};
+
+//=============================================================================
+// 结构体定义
+//=============================================================================
+
+/**
+ * @struct PingResult
+ * @brief Ping 操作的结果数据结构
+ *
+ * 存储单次 Ping 操作的所有结果信息，包括是否成功、
+ * 往返时间、TTL 值，以及可选的路由跟踪和时间戳信息。
+ */
+struct PingResult {
+    bool success = false;                    ///< Ping 是否成功
+    DWORD rtt_ms = 0;                        ///< 往返时间（毫秒）
+    DWORD reply_ttl = 0;                     ///< 回复数据包的 TTL 值
+    std::vector<std::string> route_hops;     ///< 记录路由的跳点 IP 列表
+    std::vector<uint32_t> timestamps;        ///< 时间戳列表（毫秒）
+};
+
+/**
+ * @struct TargetStat
+ * @brief 每个目标的统计数据
+ */
+struct TargetStat {
+    std::atomic<uint64_t> sent{0};           ///< 已发送数据包数
+    std::atomic<uint64_t> recv{0};           ///< 已接收数据包数
+    std::atomic<uint64_t> late{0};           ///< 超过超时时间才到达的回复数（计入丢失）
+};
+
+/**
+ * @struct EchoPacket
+ * @brief 从原始数据包解析出的 ICMP/ICMPv6 Echo 请求或回复
+ *
+ * 地址以网络字节序存放在 16 字节数组中（IPv4 仅使用前 4 字节），
+ * 选项和负载指针指向原始数据包内部。
+ */
+struct EchoPacket {
+    int af = AF_UNSPEC;                      ///< 地址族
+    bool is_reply = false;                   ///< true 为 Echo 回复，false 为 Echo 请求
+    unsigned char src[16] = {};              ///< 源地址
+    unsigned char dst[16] = {};              ///< 目标地址
+    uint16_t ident = 0;                      ///< ICMP 标识符
+    uint16_t seq = 0;                        ///< ICMP 序列号
+    int ttl = 0;                             ///< TTL / 跳数限制
+    const unsigned char* options = nullptr;  ///< IPv4 选项数据
+    size_t options_len = 0;                  ///< IPv4 选项长度
+    const unsigned char* payload = nullptr;  ///< ICMP 负载
+    size_t payload_len = 0;                  ///< ICMP 负载长度
+};
+
+/**
+ * @struct TextView
+ * @brief 不拥有内存的字符串片段
+ *
+ * 指向命令行参数等外部存储，外部存储在使用期间必须保持有效。
+ */
+struct TextView {
+    const char* data = nullptr;              ///< 起始位置
+    size_t size = 0;                         ///< 长度（字节）
+
+    TextView() {}
+    TextView(const char* d, size_t n) : data(d), size(n) {}
+    explicit TextView(const char* s) : data(s), size(strlen(s)) {}
+    explicit TextView(const std::string& s) : data(s.data()), size(s.size()) {}
+
+    bool empty() const { return size == 0; }
+    std::string str() const { return std::string(data, size); }
+};
+
+/** @brief 目标描述的类型 */
+enum TargetKind {
+    TARGET_IPV4_RANGE,                       ///< 连续的 IPv4 地址区间
+    TARGET_IPV6,                             ///< 单个 IPv6 地址
+    TARGET_HOSTNAME                          ///< 需要解析的主机名
+};
+
+/**
+ * @struct TargetSpec
+ * @brief 目标分词器输出的目标描述
+ *
+ * IPv4 目标以区间表示，不展开为地址字符串；IPv6 地址和主机名以指向
+ * 原始参数的片段表示。
+ */
+struct TargetSpec {
+    TargetKind kind = TARGET_IPV4_RANGE;     ///< 类型
+    uint32_t first = 0;                      ///< IPv4 区间起点（主机字节序）
+    uint32_t last = 0;                       ///< IPv4 区间终点（含）
+    TextView text;                           ///< IPv6 地址或主机名原文
+};
+
+/**
+ * @struct ReplayReport
+ * @brief pcap 回放的汇总结果
+ */
+struct ReplayReport {
+    uint64_t packets = 0;                    ///< 读取的 IP 数据包数
+    uint64_t requests = 0;                   ///< Echo 请求数
+    uint64_t replies = 0;                    ///< Echo 回复数
+    uint64_t matched = 0;                    ///< 与请求配对并在超时内的回复数
+    uint64_t late = 0;                       ///< 与请求配对但超过超时时间的回复数
+    uint64_t unmatched = 0;                  ///< 找不到对应请求的回复数（含重复回复）
+    uint64_t option_entries = 0;             ///< 在超时内配对的回复中解析出的记录路由和时间戳条目数
+    double elapsed_s = 0.0;                  ///< 回放处理耗时（秒）
+};
+
+/**
+ * @struct PingOptions
+ * @brief Ping 操作的配置选项
+ *
+ * 包含执行 Ping 操作所需的所有可配置参数，
+ * 如超时时间、数据包大小、TTL、源路由等。
+ */
+struct PingOptions {
+    int timeout_ms = DEFAULT_TIMEOUT_MS;     ///< 超时时间（毫秒）
+    int payload_size = DEFAULT_PAYLOAD_SIZE; ///< 发送数据包大小（字节）
+    int ttl = DEFAULT_TTL;                   ///< TTL（生存时间）值
+    int tos = 0;                             ///< TOS（服务类型）值
+    bool dont_fragment = false;              ///< 是否设置不分段标志
+    int record_route = 0;                    ///< 记录路由跳数（0 表示禁用）
+    int timestamp = 0;                       ///< 时间戳数量（0 表示禁用）
+    std::vector<std::string> loose_source_route;   ///< 宽松源路由节点列表
+    std::vector<std::string> strict_source_route;  ///< 严格源路由节点列表
+    std::string source_address;              ///< 源地址（可选）
+    PcapWriter* pcap = nullptr;              ///< pcap 导出器（可选，--pcap）
+};
+
+//=============================================================================
+// 时钟
+//=============================================================================
+
+/**
+ * @class FastClock
+ * @brief 探测时间戳使用的低开销时钟
+ *
+ * CPU 支持不变 TSC 且启动校准一致时直接读取 TSC，否则退回
+ * QueryPerformanceCounter。时间戳以原始计数保存和相减，只在输出时按
+ * 当前换算系数转换为纳秒；换算系数针对性能计数器校准，并由
+ * maybe_recalibrate 周期性更新。
+ */
+class FastClock {
+public:
+    /**
+     * @brief 检测 TSC 并校准（线程安全，只执行一次，TSC 可用时约耗时 20ms）
+     */
+    static void init();
+
+    /**
+     * @brief 读取当前时刻（原始计数）
+     */
+    static uint64_t now() { return tsc_ ? read_tsc() : qpc(); }
+
+    /**
+     * @brief 将计数差换算为纳秒
+     */
+    static uint64_t to_ns(uint64_t ticks) {
+        return (uint64_t)((double)ticks * ns_per_tick_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief 将计数差换算为微秒
+     */
+    static uint64_t to_us(uint64_t ticks) { return to_ns(ticks) / 1000; }
+
+    /**
+     * @brief 每秒的计数（启动校准时的值，用于调度间隔换算）
+     */
+    static uint64_t frequency() { return frequency_; }
+
+    /**
+     * @brief 是否使用 TSC
+     */
+    static bool using_tsc() { return tsc_; }
+
+    /**
+     * @brief 距上次校准超过 CLOCK_RECALIBRATE_MS 时重新校准
+     * @param now_ticks 当前时刻（now() 的返回值）
+     */
+    static void maybe_recalibrate(uint64_t now_ticks);
+
+private:
+    /** @brief 读取 TSC；非 x86 架构上不会被调用（tsc_ 恒为 false） */
+    static uint64_t read_tsc() {
+#if QPING_HAS_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+    static uint64_t qpc();
+    static void read_pair(uint64_t& tsc, uint64_t& qpc_value);
+    static double rate_between(uint64_t tsc0, uint64_t qpc0, uint64_t tsc1, uint64_t qpc1);
+
+    static bool tsc_;                              ///< 是否使用 TSC
+    static std::atomic<double> ns_per_tick_;       ///< 每个计数对应的纳秒数
+    static uint64_t frequency_;                    ///< 每秒计数
+    static uint64_t qpc_freq_;                     ///< 性能计数器频率
+    static uint64_t anchor_tsc_;                   ///< 校准基线起点（TSC）
+    static uint64_t anchor_qpc_;                   ///< 校准基线起点（性能计数器）
+    static std::atomic<uint64_t> next_calibration_;///< 下一次校准时刻（TSC）
+};
+
+//=============================================================================
+// 探测引擎
+//=============================================================================
+
+/**
+ * @struct ReplySource
+ * @brief 广播/组播请求的一个回复源
+ */
+struct ReplySource {
+    std::string addr;                        ///< 回复源地址
+    DWORD rtt_ms = 0;                        ///< 该回复的往返时间（毫秒）
+};
+
+/**
+ * @struct ProbeEvent
+ * @brief 探测引擎中单个探测的完成事件
+ */
+struct ProbeEvent {
+    size_t target = 0;                       ///< 目标序号
+    uint16_t seq = 0;                        ///< 序列号（每目标独立递增）
+    bool late = false;                       ///< 回复是否在超时之后才到达
+    uint64_t elapsed_us = 0;                 ///< 从发送到完成的实测时间（微秒）
+    uint64_t sent_us = 0;                    ///< 发送时刻，相对引擎启动（微秒）
+    uint64_t send_delay_us = 0;              ///< 从决定发送到发送调用返回的时间（微秒，qping 自身开销）
+    uint64_t wire_us = 0;                    ///< 从发送调用返回到完成的时间（微秒，网络往返）
+    int payload_size = 0;                    ///< 请求负载大小（字节）
+    int flow = 0;                            ///< 流序号（--flows）
+    PingResult result;                       ///< 探测结果（第一个成功的回复）
+    std::vector<ReplySource> sources;        ///< 全部成功回复的来源（仅 max_replies > 1 时填写）
+};
+
+/**
+ * @struct EngineConfig
+ * @brief 探测引擎的调度参数
+ */
+struct EngineConfig {
+    int window = 1;                          ///< 每目标最大在途探测数（--window）
+    int interval_ms = 1000;                  ///< 同一目标相邻两次发送的最小间隔（--interval）
+    int count = 1;                           ///< 每目标探测次数（0 表示无限）
+    int max_in_flight = DEFAULT_CONCURRENCY; ///< 全局最大在途探测数（--concurrency）
+    int rate_pps = 0;                        ///< 全局发送速率上限（0 表示不限，--flood）
+    int ramp_steps = 0;                      ///< 速率递增级数（0 表示直接使用上限）
+    int step_ms = FLOOD_STEP_MS;             ///< 每级持续时间（毫秒）
+    int duration_ms = 0;                     ///< 发送持续时间（0 表示不限）
+    std::vector<int> payload_sizes;          ///< 负载大小序列，按发送次序轮换（空表示使用 -l）
+    std::vector<int> cpus;                   ///< 引擎线程绑定的 CPU 编号（空表示不绑定，--cpus）
+    int threads = 0;                         ///< 引擎线程数（0 表示按槽位数自动计算）
+    bool busy_poll = false;                  ///< 以零超时轮询完成事件代替阻塞等待（--busy-poll）
+    bool cancel_on_stop = false;             ///< 停止时取消在途探测而不是等待其完成（--quorum）
+    bool track_late = true;                  ///< 超时后继续等待迟到回复（否则 API 超时即为 -w）
+    int flows = 1;                           ///< 每目标轮换的流数（--flows），各流负载开头的流标记不同
+    int max_replies = 1;                     ///< 每个请求收集的回复数上限（--discover 的广播/组播目标）
+    int prefix_rate_pps = 0;                 ///< 发往同一前缀的速率上限（0 表示不限，--prefix-rate）
+    int prefix_len = PREFIX_DEFAULT_LEN;     ///< 限速所用的 IPv4 前缀长度（--prefix-len），IPv6 为 /64
+    int ecmp_paths = 0;                      ///< 模拟的等价路径数（0 表示不模拟，--simulate-ecmp）
+    int ecmp_bad_path = 0;                   ///< 模拟的故障路径序号
+    int ecmp_loss_pct = 0;                   ///< 故障路径的丢包率（百分比）
+};
+
+/**
+ * @brief 计算引擎启动后指定时刻的目标发送速率
+ * @param config 调度参数
+ * @param elapsed_ms 距引擎启动的时间（毫秒）
+ * @return 该时刻的速率（每秒请求数），未限速时返回 0
+ */
+int engine_rate_at(const EngineConfig& config, uint64_t elapsed_ms);
+
+/**
+ * @brief 把一次成功回复计入目标统计
+ * @param stat 目标的统计数据
+ * @param elapsed_us 实测往返时间（微秒）
+ * @param timeout_ms 超时时间（-w）
+ * @return 超过超时时间、计为迟到（丢失）时返回 true，否则计入接收并返回 false
+ *
+ * 探测引擎和 --replay-pcap 回放共用，两者的接收和迟到统计口径一致。
+ */
+bool record_reply(TargetStat& stat, uint64_t elapsed_us, int timeout_ms);
+
+/**
+ * @class AimdController
+ * @brief 按已知在线目标的丢失率调整发送速率和在途上限（--aimd）
+ *
+ * 每 AIMD_EPOCH_MS 毫秒评估一次：已知在线目标（本次运行中回复过，或
+ * 存活缓存中记为在线）的丢失率不超过 AIMD_LOSS_THRESHOLD 时速率和在途
+ * 上限加性增长，超过时乘以 AIMD_DECREASE_FACTOR。未知目标不回复是常态，
+ * 不作为拥塞信号；回退之前发出的探测不再计入，同一次拥塞只回退一次。
+ * 周期内已知在线样本少于 AIMD_MIN_SAMPLES 时保持不变。探测次数用完的
+ * 目标不再产生样本，引擎为此每个周期重新探测少量已按时回复的金丝雀
+ * 目标，单遍扫描（-n 1）且没有存活缓存时控制器同样能得到样本。
+ */
+class AimdController {
+public:
+    /**
+     * @brief 构造函数
+     * @param target_count 目标数量
+     * @param max_window 在途上限的最大值
+     * @param known_alive 每个目标是否已知在线（可为空）
+     */
+    AimdController(size_t target_count, int max_window, const std::vector<uint8_t>& known_alive);
+
+    /**
+     * @brief 记录一个探测完成事件（线程安全），到达周期末尾时调整速率
+     * @param ev 完成事件
+     */
+    void record(const ProbeEvent& ev);
+
+    /** @brief 当前速率上限（每秒请求数） */
+    int rate() const { return rate_pps_.load(std::memory_order_relaxed); }
+
+    /** @brief 当前全局在途上限 */
+    int window() const { return window_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 输出速率随时间的变化
+     * @param elapsed_ms 运行时间（毫秒）
+     */
+    void print_report(uint64_t elapsed_ms) const;
+
+private:
+    /** @brief 一个评估周期（或合并后的若干周期）的统计 */
+    struct Epoch {
+        uint64_t begin_ms = 0;               ///< 开始时刻（相对引擎启动）
+        uint64_t span_ms = 0;                ///< 持续时间
+        uint64_t completed = 0;              ///< 完成的探测数
+        uint64_t samples = 0;                ///< 已知在线目标的探测数
+        uint64_t lost = 0;                   ///< 其中丢失或迟到的数量
+        int rate_pps = 0;                    ///< 周期内的速率上限
+        int window = 0;                      ///< 周期内的在途上限
+        int increases = 0;                   ///< 增长次数
+        int decreases = 0;                   ///< 回退次数
+    };
+
+    void close_epoch(uint64_t now_ms);
+
+    const int max_window_;                   ///< 在途上限的最大值
+    std::atomic<int> rate_pps_;              ///< 速率上限（引擎线程读取）
+    std::atomic<int> window_;                ///< 在途上限（引擎线程读取）
+    mutable std::mutex mtx_;                 ///< 保护以下成员
+    std::vector<uint8_t> alive_;             ///< 每个目标是否已知在线
+    uint64_t backoff_us_ = 0;                ///< 最近一次回退的时刻，之前发出的探测不计入样本
+    Epoch cur_;                              ///< 当前周期
+    std::vector<Epoch> log_;                 ///< 已结束的周期
+    int peak_pps_ = 0;                       ///< 达到过的最高速率上限
+    int decreases_ = 0;                      ///< 回退总次数
+};
+
+/**
+ * @class ProbeEngine
+ * @brief 基于 IcmpSendEcho2 异步请求的多在途探测引擎
+ *
+ * 每个引擎线程拥有一组目标和最多 ENGINE_SLOTS_PER_THREAD 个探测槽位，
+ * 每个槽位包含独立的事件句柄和回复缓冲区。同一目标最多同时有
+ * window 个探测在途，按每目标递增的序列号区分；回复在 -w 之后、
+ * LATE_REPLY_GRACE_FACTOR 倍 -w 之前到达的计为迟到（丢失）。
+ *
+ * 目标按连续分段静态分配给线程，目标状态只被所属线程访问，无需加锁。
+ */
+class ProbeEngine {
+public:
+    /** @brief 探测完成回调（在引擎线程中调用） */
+    typedef std::function<void(const ProbeEvent&)> EventCallback;
+
+    /**
+     * @brief 构造函数
+     * @param targets 目标地址列表（引擎运行期间必须保持有效）
+     * @param stats 每个目标的统计数据，与 targets 一一对应
+     * @param opts Ping 配置选项
+     * @param config 调度参数
+     */
+    ProbeEngine(const std::vector<std::string>& targets,
+                std::vector<TargetStat>& stats,
+                const PingOptions& opts,
+                const EngineConfig& config);
+
+    /**
+     * @brief 析构函数，等待引擎线程结束
+     */
+    ~ProbeEngine() { join(); }
+
+    /**
+     * @brief 设置探测完成回调
+     * @param cb 回调函数
+     */
+    void set_callback(EventCallback cb) { callback_ = cb; }
+
+    /**
+     * @brief 启动引擎线程
+     * @param stop_flag 停止标志；所有目标完成后引擎将其置为 true
+     * @return 成功返回 true，IP 选项无效时返回 false
+     */
+    bool start(std::atomic<bool>& stop_flag);
+
+    /**
+     * @brief 等待所有引擎线程结束（停止后会等待在途探测完成）
+     */
+    void join();
+
+    /**
+     * @brief 停止向一个目标发送新的探测（线程安全，在途探测照常完成）
+     * @param target 目标序号
+     */
+    void retire(size_t target) { retired_[target].store(true, std::memory_order_relaxed); }
+
+    /**
+     * @brief 使用自适应速率控制（start 之前调用），代替固定的速率和在途上限
+     * @param controller 速率控制器，生命周期不短于引擎；引擎直接向其记录金丝雀探测
+     */
+    void set_rate_controller(AimdController* controller) { aimd_ = controller; }
+
+    /**
+     * @brief 目标涉及的不同前缀数（未启用 prefix_rate_pps 时为 0）
+     */
+    size_t prefix_count() const { return prefix_tat_.size(); }
+
+    // 禁用拷贝
+    ProbeEngine(const ProbeEngine&) = delete;
+    ProbeEngine& operator=(const ProbeEngine&) = delete;
+
+private:
+    /** @brief 每个目标的调度状态（仅所属线程访问） */
+    struct TargetState {
+        int af = AF_UNSPEC;                  ///< 地址族
+        IN_ADDR addr4 = {};                  ///< IPv4 地址
+        sockaddr_in6 addr6 = {};             ///< IPv6 地址
+        uint16_t next_seq = 0;               ///< 下一个序列号
+        int in_flight = 0;                   ///< 在途探测数
+        uint64_t issued = 0;                 ///< 已发送探测数
+        LONGLONG next_due = 0;               ///< 下一次允许发送的时刻（性能计数器）
+        bool queued = false;                 ///< 是否已在所属线程的就绪队列中
+    };
+
+    /** @brief 就绪队列条目：按到期时刻排序，同一时刻按入队顺序 */
+    struct ReadyEntry {
+        LONGLONG due;                        ///< 到期时刻（性能计数器）
+        uint64_t order;                      ///< 入队序号
+        size_t target;                       ///< 目标序号
+        bool operator>(const ReadyEntry& o) const {
+            return due != o.due ? due > o.due : order > o.order;
+        }
+    };
+
+    /** @brief 在途探测槽位（仅所属线程访问） */
+    struct Slot {
+        HANDLE event = nullptr;              ///< 完成事件（自动重置）
+        std::vector<char> reply;             ///< 回复缓冲区
+        size_t target = 0;                   ///< 目标序号
+        uint16_t seq = 0;                    ///< 序列号
+        LONGLONG queued_at = 0;              ///< 决定发送的时刻（引擎时钟）
+        LONGLONG sent_at = 0;                ///< 调用发送 API 的时刻（引擎时钟）
+        LONGLONG handed_at = 0;              ///< 发送 API 返回的时刻（引擎时钟）
+        int payload_size = 0;                ///< 请求负载大小
+        int flow = 0;                        ///< 流序号
+        bool failed = false;                 ///< 发送是否立即失败
+        bool canary = false;                 ///< 是否为金丝雀探测（只作为速率控制器的样本）
+    };
+
+    void worker(size_t index, size_t thread_count, size_t slot_count);
+    bool take_prefix(size_t idx, LONGLONG now, LONGLONG& retry_at);
+    bool ecmp_drops(const TargetState& t, const char* payload, const Slot& slot) const;
+    void issue(HANDLE h4, HANDLE h6, Slot& slot, size_t idx, LONGLONG now);
+    bool complete(Slot& slot, bool cancelled);
+    LONGLONG ticks_now() const;
+
+    const std::vector<std::string>& targets_;  ///< 目标地址列表
+    std::vector<TargetStat>& stats_;           ///< 统计数据
+    PingOptions opts_;                         ///< Ping 配置选项
+    EngineConfig config_;                      ///< 调度参数
+    std::vector<std::atomic<bool>> retired_;   ///< 已停止发送的目标（retire）
+    EventCallback callback_;                   ///< 完成回调
+    AimdController* aimd_ = nullptr;           ///< 自适应速率控制（--aimd）
+    std::atomic<int> in_flight_{0};            ///< 全局在途探测数（仅 --aimd 使用）
+    std::atomic<int> canary_count_{0};         ///< 已选出的金丝雀目标数（仅 --aimd 使用）
+    std::vector<uint32_t> prefix_of_;          ///< 每个目标所属前缀的令牌桶序号（--prefix-rate）
+    std::vector<std::atomic<LONGLONG>> prefix_tat_; ///< 每个前缀令牌桶的理论到达时刻（GCRA）
+    LONGLONG prefix_interval_ = 0;             ///< 同一前缀相邻两次发送的间隔（引擎时钟）
+    std::vector<TargetState> state_;           ///< 目标调度状态
+    std::vector<char> payload_;                ///< 共享的请求负载（每流一份，按最大大小生成，各大小取前缀）
+    size_t payload_stride_ = 0;                ///< 每流负载的长度
+    std::vector<unsigned char> options_buffer_;///< IP 选项数据
+    IP_OPTION_INFORMATION ipopt_ = {};         ///< IP 选项信息
+    sockaddr_in6 source6_ = {};                ///< IPv6 源地址
+    std::vector<std::thread> threads_;         ///< 引擎线程
+    std::atomic<bool>* stop_ = nullptr;        ///< 停止标志
+    std::atomic<size_t> active_{0};            ///< 运行中的引擎线程数
+    LONGLONG start_ticks_ = 0;                 ///< 引擎启动时刻（性能计数器）
+    LONGLONG freq_ = 1;                        ///< 性能计数器频率
+    bool timer_period_set_ = false;            ///< 是否提高了系统定时器精度
+};
+
+/**
+ * @brief 多核扩展性测试
+ *
+ * 线程数按 1, 2, 4, ... 递增到 CPU 数，每级各线程绑定到前 k 个 CPU，
+ * 以满窗口、不限速的方式探测 SCALING_STEP_MS 毫秒，输出每级的请求和
+ * 回复速率及相对单线程的加速比。目标数少于线程数时重复使用目标，
+ * 使每个线程都有探测对象。
+ *
+ * @param targets 目标地址列表
+ * @param opts Ping 配置选项
+ * @param cpus 使用的 CPU 编号（空表示全部 CPU）
+ * @param stop_flag 停止标志（Ctrl+C）
+ */
+void run_scaling_benchmark(const std::vector<std::string>& targets,
+                           const PingOptions& opts,
+                           std::vector<int> cpus,
+                           std::atomic<bool>& stop_flag);
+
+/**
+ * @brief 测量本机回环 RTT 在阻塞等待和忙轮询两种方式下的分布
+ * @param opts Ping 配置选项
+ * @param cpus 绑定的 CPU（使用第一个，空表示不绑定）
+ * @param stop_flag 停止标志（Ctrl+C）
+ */
+void run_rtt_floor(const PingOptions& opts, const std::vector<int>& cpus,
+                   std::atomic<bool>& stop_flag);
+
+/**
+ * @class FloodMonitor
+ * @brief 洪泛模式的分级统计
+ *
+ * 按探测的发送时刻把完成事件归入速率级别，统计每级实际达到的请求
+ * 和回复速率，并找出丢失率首次超过 FLOOD_LOSS_THRESHOLD 的级别。
+ */
+class FloodMonitor {
+public:
+    /**
+     * @brief 构造函数
+     * @param config 引擎调度参数（用于确定每级的目标速率）
+     */
+    explicit FloodMonitor(const EngineConfig& config) : config_(config) {}
+
+    /**
+     * @brief 记录一个探测完成事件（线程安全）
+     * @param ev 完成事件
+     */
+    void record(const ProbeEvent& ev);
+
+    /**
+     * @brief 输出分级统计和丢包起始点
+     * @param elapsed_ms 实际发送持续时间（毫秒），用于计算最后一级的速率
+     */
+    void print_report(uint64_t elapsed_ms) const;
+
+private:
+    /** @brief 单个速率级别的统计 */
+    struct Step {
+        uint64_t sent = 0;                   ///< 已发送
+        uint64_t recv = 0;                   ///< 按时收到的回复
+        uint64_t late = 0;                   ///< 迟到回复
+        uint64_t rtt_us_sum = 0;             ///< 按时回复的实测往返时间之和（微秒）
+    };
+
+    EngineConfig config_;                    ///< 调度参数
+    mutable std::mutex mtx_;                 ///< 保护 steps_
+    std::vector<Step> steps_;                ///< 各级统计
+};
+
+/**
+ * @class SizeSweepMonitor
+ * @brief 负载大小扫描的统计
+ *
+ * 按目标和负载大小累计发送、接收和往返时间，最后对每个目标做
+ * RTT-大小线性回归：斜率即单位字节的传输时间（带宽的倒数），
+ * 并找出从哪个大小开始持续丢包（常见于 MTU 黑洞）。
+ */
+class SizeSweepMonitor {
+public:
+    /**
+     * @brief 构造函数
+     * @param sizes 扫描的负载大小序列（升序）
+     * @param target_count 目标数量
+     */
+    SizeSweepMonitor(const std::vector<int>& sizes, size_t target_count);
+
+    /**
+     * @brief 记录一个探测完成事件（线程安全）
+     * @param ev 完成事件
+     */
+    void record(const ProbeEvent& ev);
+
+    /**
+     * @brief 输出每个目标的扫描结果
+     * @param targets 目标地址列表
+     */
+    void print_report(const std::vector<std::string>& targets) const;
+
+private:
+    /** @brief 单个目标在单个大小上的统计 */
+    struct Cell {
+        uint64_t sent = 0;                   ///< 已发送
+        uint64_t recv = 0;                   ///< 按时收到的回复
+        uint64_t rtt_us_sum = 0;             ///< 实测往返时间之和（微秒）
+    };
+
+    std::vector<int> sizes_;                 ///< 负载大小序列
+    mutable std::mutex mtx_;                 ///< 保护 cells_
+    std::vector<Cell> cells_;                ///< 统计，下标为 目标 × 大小数 + 大小序号
+};
+
+/**
+ * @class FlowMonitor
+ * @brief 多路径（ECMP）覆盖统计（--flows）
+ *
+ * 按目标 × 流分别统计发送、回复和 RTT。负载均衡把不同的流散列到
+ * 不同的成员链路上，某条链路丢包时只表现为一个流的丢失率偏高，
+ * 而不会被平均掉。
+ */
+class FlowMonitor {
+public:
+    /**
+     * @brief 构造函数
+     * @param flows 每目标流数
+     * @param target_count 目标数量
+     */
+    FlowMonitor(int flows, size_t target_count);
+
+    /**
+     * @brief 记录一个探测完成事件（线程安全）
+     * @param ev 完成事件
+     */
+    void record(const ProbeEvent& ev);
+
+    /**
+     * @brief 输出每个目标各流的统计，标记丢失率明显偏高的流
+     * @param targets 目标地址列表
+     */
+    void print_report(const std::vector<std::string>& targets) const;
+
+private:
+    /** @brief 单个目标在单个流上的统计 */
+    struct Cell {
+        uint64_t sent = 0;                   ///< 已完成
+        uint64_t recv = 0;                   ///< 按时收到的回复
+        uint64_t rtt_us_sum = 0;             ///< 实测往返时间之和（微秒）
+    };
+
+    int flows_;                              ///< 每目标流数
+    mutable std::mutex mtx_;                 ///< 保护 cells_
+    std::vector<Cell> cells_;                ///< 统计，下标为 目标 × 流数 + 流序号
+};
+
+/**
+ * @class SendTimingMonitor
+ * @brief 发送延迟与网络往返的分解统计
+ *
+ * 把每个探测的实测时间拆成两段：从调度循环决定发送到发送 API 返回
+ * （qping 自身的排队、抓包记录和系统调用开销），以及从 API 返回到完成
+ * （网络往返加完成通知）。两段分别累计到对数-线性直方图中，用于判断
+ * 高负载下 RTT 升高来自工具还是网络。
+ */
+class SendTimingMonitor {
+public:
+    /**
+     * @brief 记录一个探测完成事件（线程安全）
+     * @param ev 完成事件；发送延迟总是计入，网络往返只计按时回复
+     */
+    void record(const ProbeEvent& ev);
+
+    /**
+     * @brief 输出两段时间的平均值、分位数和最大值
+     */
+    void print_report() const;
+
+private:
+    /** @brief 一段时间的分布 */
+    struct Series {
+        uint64_t count = 0;                  ///< 样本数
+        uint64_t sum_us = 0;                 ///< 总和（微秒）
+        uint64_t max_us = 0;                 ///< 最大值（微秒）
+        uint64_t hist[SEND_TIMING_BUCKETS] = {};  ///< 对数-线性直方图
+    };
+
+    static void add(Series& s, uint64_t us);
+    static void print_series(const char* label, const Series& s);
+
+    mutable std::mutex mtx_;                 ///< 保护 send_ 和 wire_
+    Series send_;                            ///< 发送延迟
+    Series wire_;                            ///< 网络往返
+};
+
+/**
+ * @class QuorumMonitor
+ * @brief 法定数量健康检查（--quorum / --any / --all）
+ *
+ * 目标收到任一按时回复即为在线，全部探测都失败才为失败。在线数达到
+ * required，或失败数使在线数不可能再达到 required 时结论确定，调用方
+ * 据此停止引擎并取消在途探测；检查耗时约为第 required 快的 RTT。
+ */
+class QuorumMonitor {
+public:
+    /**
+     * @brief 构造函数
+     * @param target_count 探测的目标数
+     * @param required 需要在线的目标数（不超过目标总数）
+     * @param probes_per_target 每目标探测次数（0 表示无限，此时不会判定失败）
+     * @param known_alive 无需探测、已知在线的目标数（如存活缓存命中）
+     * @param known_failed 无需探测、已知失败的目标数
+     *
+     * 仅凭已知结论即可确定时，构造后 decided() 立即为 true。
+     */
+    QuorumMonitor(size_t target_count, size_t required, int probes_per_target,
+                  size_t known_alive = 0, size_t known_failed = 0);
+
+    /**
+     * @brief 记录一个探测完成事件（线程安全，迟到回复不计入）
+     * @param ev 完成事件
+     * @return 本次事件使结论确定时返回 true（只返回一次）
+     */
+    bool record(const ProbeEvent& ev);
+
+    /** @brief 结论是否已确定 */
+    bool decided() const { return outcome_.load() != 0; }
+
+    /** @brief 是否满足法定数量 */
+    bool met() const { return outcome_.load() == 1; }
+
+    /**
+     * @brief 输出结论、在线/失败/未定目标数和作出结论的时刻
+     */
+    void print_report() const;
+
+private:
+    bool check();
+
+    const size_t total_;                     ///< 目标总数（含已知结论的目标）
+    const size_t required_;                  ///< 需要在线的目标数
+    const int probes_;                       ///< 每目标探测次数
+    std::vector<std::atomic<int>> failures_; ///< 每目标失败次数，-1 表示已在线
+    std::atomic<size_t> alive_{0};           ///< 在线目标数
+    std::atomic<size_t> failed_{0};          ///< 失败目标数
+    std::atomic<int> outcome_{0};            ///< 0 未定，1 满足，2 不满足
+    std::atomic<uint64_t> decided_us_{0};    ///< 作出结论的时刻（距引擎启动，微秒）
+};
+
+/**
+ * @class SelectBestMonitor
+ * @brief 最优端点选择（--select-best）
+ *
+ * 所有候选并行探测，超时按 -w 计为一个 RTT 样本。每个在选候选都有
+ * SELECT_MIN_SAMPLES 个样本后，以平均值最低者为领先者，淘汰置信区间
+ * 下界高于领先者上界的候选（逐次淘汰）。只剩一个候选或在选候选都用尽
+ * SELECT_MAX_PROBES 次探测时结论确定。
+ *
+ * 置信区间按 Student t 分布取 99% 双侧分位数，样本少时区间相应放宽。
+ * 99% 是单次比较中单个区间的置信水平：要求两个区间完全不重叠比单个
+ * 区间更保守，但每个新样本都会重新比较所有候选，整次选择中误淘汰
+ * 真正最优者的概率高于 1%，不应当作严格的显著性检验。
+ */
+class SelectBestMonitor {
+public:
+    /**
+     * @brief 构造函数
+     * @param target_count 候选数
+     * @param timeout_ms 超时样本计入的 RTT（毫秒）
+     */
+    SelectBestMonitor(size_t target_count, int timeout_ms);
+
+    /**
+     * @brief 记录一个探测完成事件（线程安全，迟到回复不计入）
+     * @param ev 完成事件
+     * @param[out] eliminated 本次被淘汰的候选，调用方应停止向其发送
+     * @return 本次事件使结论确定时返回 true（只返回一次）
+     */
+    bool record(const ProbeEvent& ev, std::vector<size_t>& eliminated);
+
+    /**
+     * @brief 是否选出了收到过回复的候选
+     */
+    bool has_winner() const;
+
+    /**
+     * @brief 输出各候选的样本和状态，最后一行为机器可读的结果
+     * @param targets 候选地址列表
+     * @param elapsed_ms 选择耗时（毫秒）
+     */
+    void print_report(const std::vector<std::string>& targets, uint64_t elapsed_ms) const;
+
+private:
+    /** @brief 单个候选的 RTT 样本统计 */
+    struct Candidate {
+        uint64_t samples = 0;                ///< 样本数（含超时）
+        uint64_t replies = 0;                ///< 回复数
+        double sum_us = 0;                   ///< 样本之和（微秒）
+        double sum_sq = 0;                   ///< 样本平方和
+        uint64_t retired_after = 0;          ///< 被淘汰时的总探测数（0 表示在选）
+    };
+
+    static double mean(const Candidate& c);
+    static double half_width(const Candidate& c);
+    void eliminate(std::vector<size_t>& eliminated);
+
+    mutable std::mutex mtx_;                 ///< 保护以下成员
+    std::vector<Candidate> cands_;           ///< 候选统计
+    double penalty_us_;                      ///< 超时样本值（微秒）
+    size_t active_;                          ///< 在选候选数
+    uint64_t probes_ = 0;                    ///< 已完成的探测总数
+    bool decided_ = false;                   ///< 结论是否已确定
+    size_t winner_ = SIZE_MAX;               ///< 选出的候选
+};
+
+/**
+ * @class DiscoveryMonitor
+ * @brief 广播/组播发现（--discover）
+ *
+ * 对广播地址或组播地址的一次请求会收到链路上多台主机的回复。每个
+ * 不同的回复源记为一台发现的主机，同一主机的后续回复计为重复，
+ * 用于区分“新主机”和“已知主机再次回复”。
+ */
+class DiscoveryMonitor {
+public:
+    /**
+     * @brief 记录一个探测完成事件（线程安全）
+     * @param ev 完成事件
+     * @param found 输出：本事件中首次出现的回复源
+     */
+    void record(const ProbeEvent& ev, std::vector<ReplySource>& found);
+
+    /**
+     * @brief 输出发现的主机、各自的回复数和最小 RTT，以及重复回复数
+     * @param targets 目标地址列表
+     */
+    void print_report(const std::vector<std::string>& targets) const;
+
+private:
+    /** @brief 单个发现的主机 */
+    struct Host {
+        size_t target = 0;                   ///< 首次发现它的目标（广播/组播地址）
+        uint64_t replies = 0;                ///< 回复数
+        DWORD min_rtt_ms = 0;                ///< 最小 RTT（毫秒）
+    };
+
+    mutable std::mutex mtx_;                 ///< 保护以下成员
+    std::unordered_map<std::string, Host> hosts_; ///< 按地址索引的发现主机
+    uint64_t probes_ = 0;                    ///< 已完成的探测数
+    uint64_t replies_ = 0;                   ///< 收到的回复总数
+    uint64_t duplicates_ = 0;                ///< 来自已发现主机的回复数
+};
+
+//=============================================================================
+// 主机名标签
+//=============================================================================
+
+/**
+ * @class HostnameResolver
+ * @brief 引擎模式 -a 的后台反向解析
+ *
+ * 只为有回复的目标排队反向解析，由少量后台线程完成，不阻塞引擎启动，
+ * 也不在引擎线程上做 DNS 查询。解析完成前输出使用地址本身。
+ */
+class HostnameResolver {
+public:
+    /**
+     * @brief 启动解析线程
+     * @param targets 目标地址列表（须在解析器销毁前保持有效）
+     * @param threads 解析线程数
+     */
+    HostnameResolver(const std::vector<std::string>& targets, int threads);
+
+    /** @brief 放弃排队中的解析并等待解析线程退出 */
+    ~HostnameResolver();
+
+    /**
+     * @brief 取目标的显示标签（线程安全）
+     *
+     * 已解析时返回 "主机名 [地址]"，否则返回地址；replied 为 true 且
+     * 尚未排队时把目标加入解析队列。
+     *
+     * @param idx 目标序号
+     * @param replied 本次探测是否收到回复
+     * @return 显示标签
+     */
+    std::string label(size_t idx, bool replied);
+
+    HostnameResolver(const HostnameResolver&) = delete;
+    HostnameResolver& operator=(const HostnameResolver&) = delete;
+
+private:
+    void run();
+
+    const std::vector<std::string>& targets_; ///< 目标地址列表
+    std::mutex mtx_;                         ///< 保护以下成员
+    std::condition_variable cv_;             ///< 队列非空或停止时通知
+    std::vector<uint8_t> requested_;         ///< 每个目标是否已排队
+    std::unordered_map<size_t, std::string> labels_; ///< 已解析出主机名的目标标签
+    std::vector<size_t> queue_;              ///< 待解析的目标
+    size_t head_ = 0;                        ///< 队列中下一个待解析的位置
+    bool stop_ = false;                      ///< 是否停止
+    std::vector<std::thread> threads_;       ///< 解析线程
+};
+
+//=============================================================================
+// 排除列表
+//=============================================================================
+
+/**
+ * @struct ExcludeFileHeader
+ * @brief 排除文件头部（位于文件开头，占一个过滤器块）
+ *
+ * 文件布局：头部块、block_count 个 Bloom 过滤器块、count 个升序排列的
+ * IPv4 地址（主机字节序，uint32）。
+ */
+struct ExcludeFileHeader {
+    uint32_t magic;                          ///< EXCLUDE_MAGIC
+    uint32_t version;                        ///< EXCLUDE_VERSION
+    uint64_t count;                          ///< 地址数
+    uint32_t block_count;                    ///< 过滤器块数
+    uint32_t hash_count;                     ///< 每个地址设置的位数
+    uint64_t bloom_offset;                   ///< 过滤器起始偏移
+    uint64_t array_offset;                   ///< 地址数组起始偏移
+};
+
+/**
+ * @class ExcludeFilter
+ * @brief 内存映射的大规模排除列表（--exclude-file）
+ *
+ * 先查分块 Bloom 过滤器，可能命中时再在排序数组中二分查找，结果精确。
+ * 排序数组也可直接用于从地址区间中整体扣除。
+ */
+class ExcludeFilter {
+public:
+    ExcludeFilter() = default;
+
+    /**
+     * @brief 析构函数，自动解除映射并关闭文件
+     */
+    ~ExcludeFilter() { close(); }
+
+    /**
+     * @brief 映射排除文件并校验
+     * @param path 由 build_exclude_file 生成的文件
+     * @return 成功返回 true，失败返回 false 并输出错误信息
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief 解除映射并关闭文件
+     */
+    void close();
+
+    /**
+     * @brief 是否已加载
+     */
+    bool is_open() const { return base_ != nullptr; }
+
+    /**
+     * @brief 查询地址是否在排除列表中（线程安全）
+     * @param addr IPv4 地址（主机字节序）
+     */
+    bool contains(uint32_t addr) const;
+
+    /** @brief 升序地址数组起点 */
+    const uint32_t* begin() const { return addrs_; }
+
+    /** @brief 升序地址数组终点 */
+    const uint32_t* end() const { return addrs_ + count_; }
+
+    /** @brief 地址数 */
+    size_t count() const { return count_; }
+
+    // 禁用拷贝
+    ExcludeFilter(const ExcludeFilter&) = delete;
+    ExcludeFilter& operator=(const ExcludeFilter&) = delete;
+
+private:
+    HANDLE file_ = INVALID_HANDLE_VALUE;     ///< 文件句柄
+    HANDLE mapping_ = nullptr;               ///< 文件映射句柄
+    const unsigned char* base_ = nullptr;    ///< 映射基址
+    const uint64_t* bloom_ = nullptr;        ///< 过滤器
+    uint32_t block_count_ = 0;               ///< 过滤器块数
+    const uint32_t* addrs_ = nullptr;        ///< 升序地址数组
+    size_t count_ = 0;                       ///< 地址数
+};
+
+/**
+ * @brief 从文本列表构建排除文件
+ * @param input 文本文件，每行一个 IPv4 目标（地址、范围或 CIDR），# 开始注释
+ * @param output 输出的排除文件
+ * @param[out] count 去重后的地址数
+ * @param[out] bytes 输出文件大小（字节）
+ * @return 成功返回 true，失败返回 false 并输出错误信息
+ */
+bool build_exclude_file(const std::string& input, const std::string& output,
+                        uint64_t& count, uint64_t& bytes);
+
+//=============================================================================
+// 统计抽样
+//=============================================================================
+
+/**
+ * @struct Ipv4Range
+ * @brief 连续的 IPv4 地址区间（主机字节序）
+ */
+struct Ipv4Range {
+    uint32_t first = 0;                      ///< 第一个地址
+    uint64_t count = 0;                      ///< 地址数量
+};
+
+/**
+ * @class IndexPermutation
+ * @brief [0, n) 上的伪随机置换
+ *
+ * 使用带密钥的平衡 Feistel 网络在 2 的幂大小的域上构造双射，再通过
+ * 循环行走（cycle walking）限制到 [0, n)。按 0, 1, 2, ... 依次取值即得到
+ * 不重复的随机抽样顺序，无需生成或打乱完整的目标列表。
+ */
+class IndexPermutation {
+public:
+    /**
+     * @brief 构造函数
+     * @param n 置换的大小
+     * @param seed 随机种子，决定置换顺序
+     */
+    IndexPermutation(uint64_t n, uint64_t seed);
+
+    /**
+     * @brief 返回第 i 个位置上的值
+     * @param i 位置，必须小于 size()
+     * @return [0, n) 中的值，不同的 i 对应不同的值
+     */
+    uint64_t operator()(uint64_t i) const;
+
+    /** @brief 置换的大小 */
+    uint64_t size() const { return n_; }
+
+private:
+    /** @brief Feistel 轮数 */
+    static const int ROUNDS = 4;
+
+    uint64_t encrypt(uint64_t x) const;
+
+    uint64_t n_;                             ///< 置换大小
+    int half_bits_;                          ///< Feistel 半块位数
+    uint64_t half_mask_;                     ///< 半块掩码
+    uint64_t keys_[ROUNDS];                  ///< 轮密钥
+};
+
+/**
+ * @struct SampleConfig
+ * @brief 抽样模式参数
+ */
+struct SampleConfig {
+    double sample_rate = 1.0;                ///< 最多抽样的比例（--sample-rate）
+    double confidence = 0.95;                ///< 置信水平（--confidence）
+    double margin = SAMPLE_DEFAULT_MARGIN;   ///< 提前停止的目标区间半宽（--margin）
+    bool early_stop = false;                 ///< 是否在区间足够窄时提前停止
+    int probes_per_host = 1;                 ///< 每个地址的探测次数，任一回复即判定在线
+    int concurrency = DEFAULT_CONCURRENCY;   ///< 最大在途探测数
+};
+
+/**
+ * @brief 按随机顺序抽样探测地址区间并输出在线比例估计
+ *
+ * 地址按 IndexPermutation 顺序分批交给探测引擎，每批结束后输出进度。
+ * 启用提前停止时，总体在线比例的置信区间半宽不超过 margin 即停止。
+ * 最后输出总体和各 /16 前缀的在线比例、置信区间和估计在线主机数。
+ *
+ * 排除的地址在抽样前从区间中扣除，总体大小和各 /16 前缀的地址数都不含它们。
+ *
+ * @param ranges 抽样的地址区间
+ * @param exclude 排除的地址
+ * @param exclude_filter 排除文件（未加载时不生效）
+ * @param opts Ping 配置选项
+ * @param config 抽样参数
+ * @param stop_flag 停止标志（Ctrl+C）
+ * @param[out] live 抽样中发现的在线地址数
+ * @return 探测引擎无法启动（如源路由地址无效）时返回 false
+ */
+bool run_sampling(std::vector<Ipv4Range> ranges,
+                  const std::unordered_set<std::string>& exclude,
+                  const ExcludeFilter& exclude_filter,
+                  const PingOptions& opts,
+                  const SampleConfig& config,
+                  std::atomic<bool>& stop_flag,
+                  uint64_t& live);
+
+//=============================================================================
+// 编译目标集
+//=============================================================================
+
+/**
+ * @struct TargetInterval
+ * @brief 目标集中的 IPv4 区间（主机字节序，含两端）
+ */
+struct TargetInterval {
+    uint32_t first;                          ///< 起点
+    uint32_t last;                           ///< 终点
+};
+
+/**
+ * @struct TargetSetHeader
+ * @brief 目标集文件头部
+ *
+ * 文件布局：头部、interval_count 个 TargetInterval、singleton_count 个
+ * uint32 单地址、来源描述文本。区间与单地址均升序、互不重叠且互不相邻，
+ * 区间至少包含两个地址。
+ */
+struct TargetSetHeader {
+    uint32_t magic;                          ///< TARGETSET_MAGIC
+    uint32_t version;                        ///< TARGETSET_VERSION
+    uint64_t host_count;                     ///< 地址总数
+    uint64_t interval_count;                 ///< 区间数
+    uint64_t singleton_count;                ///< 单地址数
+    uint64_t created_ms;                     ///< 编译时刻（Unix 毫秒）
+    uint64_t intervals_offset;               ///< 区间数组偏移
+    uint64_t singletons_offset;              ///< 单地址数组偏移
+    uint64_t source_offset;                  ///< 来源描述偏移
+    uint32_t source_len;                     ///< 来源描述长度
+    uint32_t reserved;                       ///< 保留，为 0
+};
+
+/**
+ * @class TargetSet
+ * @brief 内存映射的编译目标集（--target-set）
+ *
+ * 加载只做映射和边界校验，不解析文本；区间和单地址直接转换为目标描述
+ * 或抽样区间。
+ */
+class TargetSet {
+public:
+    TargetSet() = default;
+
+    /**
+     * @brief 析构函数，自动解除映射并关闭文件
+     */
+    ~TargetSet() { close(); }
+
+    /**
+     * @brief 映射目标集文件并校验
+     * @param path 由 compile_target_set 生成的文件
+     * @return 成功返回 true，失败返回 false 并输出错误信息
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief 解除映射并关闭文件
+     */
+    void close();
+
+    /**
+     * @brief 按地址升序追加目标描述（区间与单地址交错合并）
+     */
+    void append_specs(std::vector<TargetSpec>& out) const;
+
+    /**
+     * @brief 按地址升序追加抽样区间
+     */
+    void append_ranges(std::vector<Ipv4Range>& out) const;
+
+    /** @brief 地址总数 */
+    uint64_t host_count() const { return header_ ? header_->host_count : 0; }
+
+    /** @brief 编译时刻（Unix 毫秒） */
+    uint64_t created_ms() const { return header_ ? header_->created_ms : 0; }
+
+    /** @brief 来源描述（编译时的目标参数） */
+    TextView source() const { return source_; }
+
+    // 禁用拷贝
+    TargetSet(const TargetSet&) = delete;
+    TargetSet& operator=(const TargetSet&) = delete;
+
+private:
+    bool check_order() const;
+
+    HANDLE file_ = INVALID_HANDLE_VALUE;     ///< 文件句柄
+    HANDLE mapping_ = nullptr;               ///< 文件映射句柄
+    const TargetSetHeader* header_ = nullptr; ///< 映射基址（头部）
+    const TargetInterval* intervals_ = nullptr; ///< 区间数组
+    const uint32_t* singletons_ = nullptr;   ///< 单地址数组
+    TextView source_;                        ///< 来源描述
+};
+
+/**
+ * @brief 把 IPv4 目标描述规范化并写入目标集文件
+ * @param specs 分词器输出的目标描述（仅限 IPv4）
+ * @param excluded 升序排列的排除地址
+ * @param exclude_filter 排除文件（未加载时不生效）
+ * @param source 来源描述，超过 TARGETSET_SOURCE_MAX 的部分截断
+ * @param output 输出文件
+ * @param[out] hosts 地址总数
+ * @param[out] bytes 输出文件大小（字节）
+ * @return 成功返回 true，失败返回 false 并输出错误信息
+ */
+bool compile_target_set(const std::vector<TargetSpec>& specs,
+                        const std::vector<uint32_t>& excluded,
+                        const ExcludeFilter& exclude_filter,
+                        const std::string& source,
+                        const std::string& output,
+                        uint64_t& hosts, uint64_t& bytes);
+
+//=============================================================================
+// 存活缓存
+//=============================================================================
+
+/**
+ * @struct LivenessEntry
+ * @brief 一个地址最近一次的探测结论
+ */
+struct LivenessEntry {
+    uint64_t time_ms = 0;                    ///< 探测时刻（Unix 毫秒）
+    bool alive = false;                      ///< 是否收到回复
+};
+
+/**
+ * @class LivenessCache
+ * @brief 持久化的存活缓存（--cache / --max-age）
+ *
+ * 保存每个地址最近一次的探测结论和时刻。加载时整体读入内存，结束时
+ * 合并本次结果后写入临时文件再替换，中途中断不会损坏原文件。
+ */
+class LivenessCache {
+public:
+    /**
+     * @brief 读取缓存文件，文件不存在时视为空缓存
+     * @param path 缓存文件路径
+     * @return 成功返回 true，文件损坏或无法读取返回 false 并输出错误信息
+     */
+    bool load(const std::string& path);
+
+    /**
+     * @brief 查询不早于 min_time_ms 的缓存结论
+     * @param addr 目标地址
+     * @param min_time_ms 可接受的最早探测时刻（Unix 毫秒）
+     * @param[out] entry 命中时的缓存结论
+     * @return 命中返回 true
+     */
+    bool lookup(const std::string& addr, uint64_t min_time_ms, LivenessEntry& entry) const;
+
+    /**
+     * @brief 记录一个地址的最新结论
+     */
+    void update(const std::string& addr, bool alive, uint64_t time_ms);
+
+    /**
+     * @brief 丢弃超过保留时间的条目后写回文件
+     * @param now_ms 当前时刻（Unix 毫秒）
+     * @return 成功返回 true，失败返回 false 并输出错误信息
+     */
+    bool save(uint64_t now_ms);
+
+    /** @brief 条目数 */
+    size_t size() const { return entries_.size(); }
+
+private:
+    std::string path_;                       ///< 缓存文件路径
+    std::unordered_map<std::string, LivenessEntry> entries_;  ///< 地址 -> 结论
+};
+
+//=============================================================================
+// 延迟草图
+//=============================================================================
+
+/**
+ * @class LatencySketch
+ * @brief 可合并的 RTT 分位数草图（DDSketch）
+ *
+ * 第 k 个桶覆盖 (γ^(k-1), γ^k] 微秒，γ = (1+α)/(1-α)，任意分位数估计的
+ * 相对误差不超过 SKETCH_ALPHA。两个草图合并只需逐桶相加，合并结果与
+ * 直接记录全部样本完全相同，因此分片结果可以任意顺序、任意层级合并。
+ */
+class LatencySketch {
+public:
+    /**
+     * @brief 记录一个样本
+     * @param us RTT（微秒）
+     */
+    void add(uint64_t us);
+
+    /**
+     * @brief 合并另一个草图
+     */
+    void merge(const LatencySketch& other);
+
+    /** @brief 样本数 */
+    uint64_t count() const { return count_; }
+
+    /**
+     * @brief 估计分位数
+     * @param q 分位点（0-1）
+     * @return RTT（微秒），无样本时为 0
+     */
+    double quantile(double q) const;
+
+    /**
+     * @brief 以 varint 编码追加到 out
+     */
+    void encode(std::string& out) const;
+
+    /**
+     * @brief 从 p 开始解码，成功时 p 移到草图之后
+     * @return 数据截断或不一致时返回 false
+     */
+    bool decode(const unsigned char*& p, const unsigned char* end);
 
-/** @brief 默认发送数据包大小（字节） */
-constexpr int DEFAULT_PAYLOAD_SIZE = 32;
+private:
+    static int index_of(uint64_t us);
 
-/** @brief 默认 TTL（生存时间）值 */
-constexpr int DEFAULT_TTL = 128;
+    uint64_t count_ = 0;                     ///< 样本数
+    uint64_t zero_ = 0;                      ///< 值为 0 的样本数
+    uint64_t min_us_ = 0;                    ///< 最小值（精确）
+    uint64_t max_us_ = 0;                    ///< 最大值（精确）
+    int offset_ = 0;                         ///< counts_[0] 的桶序号
+    std::vector<uint64_t> counts_;           ///< 从 offset_ 起连续各桶的计数
+};
 
-/** @brief 最大发送数据包大小（字节） */
-constexpr int MAX_PAYLOAD_SIZE = 65500;
+/**
+ * @struct SketchFileHeader
+ * @brief 结果文件头部，其后是 target_count 条 varint 编码的目标记录：
+ *        地址长度、地址、已发送、已接收、草图
+ */
+struct SketchFileHeader {
+    uint32_t magic;                          ///< SKETCH_MAGIC
+    uint32_t version;                        ///< SKETCH_VERSION
+    double alpha;                            ///< 草图相对误差参数，合并时必须一致
+    uint64_t target_count;                   ///< 目标记录数
+};
 
-/** @brief 默认最大目标主机数限制 */
-constexpr unsigned int MAX_HOSTS_DEFAULT = 65536;
+/**
+ * @class LatencyResults
+ * @brief 每个目标和全局的延迟草图（--sketch 结果文件与 qping merge）
+ */
+class LatencyResults {
+public:
+    /**
+     * @brief 按目标列表初始化，record 使用其下标
+     */
+    void init(const std::vector<std::string>& targets);
 
-//=============================================================================
-// IP 选项常量
-//=============================================================================
+    /**
+     * @brief 记录一次探测结果（线程安全）
+     * @param target 目标序号
+     * @param success 是否按时收到回复
+     * @param rtt_us 往返时间（微秒）
+     */
+    void record(size_t target, bool success, uint32_t rtt_us);
 
-/** @brief 记录路由选项最大跳数 */
-constexpr int MAX_RECORD_ROUTE = 9;
+    /**
+     * @brief 读取结果文件并按目标地址合并到当前结果
+     * @return 成功返回 true，文件无法读取或格式无效时输出错误并返回 false
+     */
+    bool load(const std::string& path);
 
-/** @brief 时间戳选项最大数量 */
-constexpr int MAX_TIMESTAMP = 4;
+    /**
+     * @brief 写出结果文件
+     * @param path 输出路径
+     * @param[out] bytes 文件大小
+     * @return 成功返回 true
+     */
+    bool save(const std::string& path, uint64_t& bytes) const;
 
-/** @brief 源路由选项最大节点数 */
-constexpr int MAX_SOURCE_ROUTE = 9;
+    /**
+     * @brief 输出每个目标和全局的丢失率与 RTT 分位数
+     */
+    void print_report() const;
 
-/** @brief IP 选项类型：记录路由 (Record Route) */
-constexpr UCHAR OPT_RR = 0x07;
+    /** @brief 目标数 */
+    size_t size() const { return entries_.size(); }
 
-/** @brief IP 选项类型：时间戳 (Timestamp) */
-constexpr UCHAR OPT_TS = 0x44;
+    /** @brief 全局样本数 */
+    uint64_t sample_count() const { return global_.count(); }
 
-/** @brief IP 选项类型：宽松源路由 (Loose Source and Record Route) */
-constexpr UCHAR OPT_LSRR = 0x83;
+private:
+    /** @brief 单个目标的结果 */
+    struct Entry {
+        std::string addr;                    ///< 目标地址
+        uint64_t sent = 0;                   ///< 已完成的探测数
+        uint64_t recv = 0;                   ///< 按时收到的回复数
+        LatencySketch sketch;                ///< RTT 草图
+    };
 
-/** @brief IP 选项类型：严格源路由 (Strict Source and Record Route) */
-constexpr UCHAR OPT_SSRR = 0x89;
+    mutable std::mutex mtx_;                 ///< 保护以下成员
+    std::vector<Entry> entries_;             ///< 各目标结果
+    std::unordered_map<std::string, size_t> index_; ///< 地址 -> entries_ 下标
+    LatencySketch global_;                   ///< 全部目标合并的草图
+};
 
 //=============================================================================
-// 类定义
+// 历史归档
 //=============================================================================
 
 /**
- * @class IcmpHandle
- * @brief ICMP 句柄的 RAII 封装类
- *
- * 该类使用 RAII（资源获取即初始化）模式管理 Windows ICMP API 句柄，
- * 确保句柄在对象生命周期结束时自动释放，防止资源泄漏。
+ * @struct HistorySample
+ * @brief 归档中的单次探测记录
+ */
+struct HistorySample {
+    uint64_t timestamp_ms = 0;               ///< 完成时刻（自 1970-01-01 起的毫秒数）
+    bool success = false;                    ///< 是否收到回复
+    uint32_t rtt_us = 0;                     ///< 往返时间（微秒，仅成功时有效）
+};
+
+/**
+ * @class HistoryArchive
+ * @brief 只追加的列式探测历史归档
  *
- * @note 该类禁用了拷贝构造和拷贝赋值，以防止句柄被多次关闭
+ * 探测结果先在内存中按目标分列编码：时间戳为相对上一条记录的增量
+ * varint，RTT 为 varint（仅成功的探测），成败为位图。时间跨过
+ * ARCHIVE_SEGMENT_MS 对齐边界或关闭归档时，当前数据写成一个不可变
+ * 分段文件，文件尾部带有按目标名排序的块索引，并在目录的
+ * ARCHIVE_INDEX_FILE 中追加一行分段时间范围，供 query_archive 定位。
  *
- * @example
- * @code
- * IcmpHandle handle(IcmpCreateFile());
- * if (handle.valid()) {
- *     // 使用 handle.get() 进行 ICMP 操作
- * }
- * // 句柄在作用域结束时自动关闭
- * @endcode
+ * 分段格式（小端序）：
+ * - 头部："QPSG"、版本、起始毫秒、结束毫秒、目标数
+ * - 每个目标的数据块：时间戳列、成败位图、RTT 列
+ * - 块索引：目标名、首末时间戳、记录数、块偏移和各列长度
+ * - 尾部：块索引偏移、"QPIX"
  */
-class IcmpHandle {
+class HistoryArchive {
 public:
-    /**
-     * @brief 构造函数
-     * @param h Windows ICMP 句柄
-     */
-    explicit IcmpHandle(HANDLE h) : handle_(h) {}
+    HistoryArchive() = default;
+    ~HistoryArchive() { close(); }
 
     /**
-     * @brief 析构函数，自动关闭有效的 ICMP 句柄
+     * @brief 打开（必要时创建）归档目录
+     * @param dir 归档目录
+     * @param targets 目标地址列表，record 使用其下标
+     * @return 成功返回 true，失败时输出错误信息并返回 false
      */
-    ~IcmpHandle() {
-        if (handle_ != INVALID_HANDLE_VALUE) {
-            IcmpCloseHandle(handle_);
-        }
-    }
+    bool open(const std::string& dir, const std::vector<std::string>& targets);
 
     /**
-     * @brief 获取底层句柄
-     * @return ICMP 句柄
+     * @brief 写出当前分段并关闭归档
      */
-    HANDLE get() const { return handle_; }
+    void close();
+
+    /** @brief 归档是否已打开 */
+    bool is_open() const { return open_; }
+
+    /** @brief 已写出的分段数 */
+    uint64_t segment_count() const { return segments_; }
+
+    /** @brief 已记录的探测数 */
+    uint64_t record_count() const { return records_; }
 
     /**
-     * @brief 检查句柄是否有效
-     * @return 如果句柄有效返回 true，否则返回 false
+     * @brief 记录一次探测结果（线程安全），时间戳取调用时刻
+     * @param target 目标序号
+     * @param success 是否收到回复
+     * @param rtt_us 往返时间（微秒）
      */
-    bool valid() const { return handle_ != INVALID_HANDLE_VALUE; }
+    void record(size_t target, bool success, uint32_t rtt_us);
 
     // 禁用拷贝
-    IcmpHandle(const IcmpHandle&) = delete;
-    IcmpHandle& operator=(const IcmpHandle&) = delete;
+    HistoryArchive(const HistoryArchive&) = delete;
+    HistoryArchive& operator=(const HistoryArchive&) = delete;
 
 private:
-    HANDLE handle_;  ///< Windows ICMP 句柄
+    /** @brief 单个目标在当前分段中的列数据 */
+    struct Column {
+        uint64_t first_ts = 0;               ///< 第一条记录的时间戳
+        uint64_t last_ts = 0;                ///< 最后一条记录的时间戳
+        uint32_t count = 0;                  ///< 记录数
+        std::string ts;                      ///< 时间戳增量 varint 列
+        std::string rtt;                     ///< RTT varint 列（仅成功的记录）
+        std::string loss;                    ///< 成败位图（1 表示收到回复）
+    };
+
+    bool flush_segment();
+
+    std::string dir_;                        ///< 归档目录
+    std::vector<std::string> targets_;       ///< 目标地址列表
+    std::vector<Column> columns_;            ///< 各目标的当前分段数据
+    uint64_t segment_start_ = 0;             ///< 当前分段的对齐起始时刻（毫秒）
+    uint64_t segment_first_ = 0;             ///< 当前分段第一条记录的时刻
+    uint64_t segment_last_ = 0;              ///< 当前分段最后一条记录的时刻
+    bool segment_empty_ = true;              ///< 当前分段是否没有记录
+    std::mutex mtx_;                         ///< 保护分段数据
+    uint64_t segments_ = 0;                  ///< 已写出的分段数
+    uint64_t records_ = 0;                   ///< 已记录的探测数
+    bool open_ = false;                      ///< 是否已打开
 };
 
+/**
+ * @brief 从归档中读取一个目标在时间范围内的记录
+ *
+ * 只读取分段索引中与时间范围重叠的分段，每个分段只读取尾部块索引
+ * 和该目标的数据块，不扫描其他目标的数据。
+ *
+ * @param dir 归档目录
+ * @param target 目标地址
+ * @param from_ms 起始时刻（含，毫秒）
+ * @param to_ms 结束时刻（含，毫秒）
+ * @param[out] out 按时间顺序追加的记录
+ * @param[out] segments_read 实际读取的分段数
+ * @return 成功返回 true，归档目录或索引无法读取时返回 false
+ */
+bool query_archive(const std::string& dir, const std::string& target,
+                   uint64_t from_ms, uint64_t to_ms,
+                   std::vector<HistorySample>& out, size_t& segments_read);
+
+/**
+ * @brief 解析查询时间参数
+ * @param s 本地时间 "YYYY-MM-DD[ HH:MM[:SS]]"（日期与时间之间也可用 T），
+ *          或自 1970-01-01 起的秒数
+ * @param[out] ms 自 1970-01-01 起的毫秒数
+ * @return 解析成功返回 true
+ */
+bool parse_time_arg(const std::string& s, uint64_t& ms);
+
+/**
+ * @brief 将毫秒时间戳格式化为本地时间 "YYYY-MM-DD HH:MM:SS.mmm"
+ */
+std::string format_time_ms(uint64_t ms);
+
 //=============================================================================
-// 结构体定义
+// 共享内存统计
 //=============================================================================
 
 /**
- * @struct PingResult
- * @brief Ping 操作的结果数据结构
+ * @struct ShmHeader
+ * @brief 共享内存区域头部
  *
- * 存储单次 Ping 操作的所有结果信息，包括是否成功、
- * 往返时间、TTL 值，以及可选的路由跟踪和时间戳信息。
+ * 区域布局为 ShmHeader 之后紧跟 target_count 条 ShmRecord。读取方应按
+ * header_size 和 record_size 定位记录，以便兼容在末尾追加字段的新版本。
  */
-struct PingResult {
-    bool success = false;                    ///< Ping 是否成功
-    DWORD rtt_ms = 0;                        ///< 往返时间（毫秒）
-    DWORD reply_ttl = 0;                     ///< 回复数据包的 TTL 值
-    std::vector<std::string> route_hops;     ///< 记录路由的跳点 IP 列表
-    std::vector<uint32_t> timestamps;        ///< 时间戳列表（毫秒）
+struct ShmHeader {
+    uint32_t magic;                          ///< SHM_MAGIC
+    uint32_t version;                        ///< SHM_VERSION
+    uint32_t header_size;                    ///< 头部大小（字节）
+    uint32_t record_size;                    ///< 每条记录大小（字节）
+    uint32_t target_count;                   ///< 记录数
+    uint32_t hist_buckets;                   ///< 直方图桶数
+    volatile uint32_t state;                 ///< SHM_STATE_RUNNING / SHM_STATE_FINISHED
+    uint32_t pid;                            ///< 写入进程 ID
+    uint64_t start_ms;                       ///< 启动时刻（自 1970-01-01 起的毫秒数）
+    volatile uint64_t heartbeat_ms;          ///< 主线程最近一次心跳时刻，用于判断写入方是否存活
 };
 
 /**
- * @struct PingOptions
- * @brief Ping 操作的配置选项
+ * @struct ShmRecord
+ * @brief 单个目标的统计记录，由序列锁保护
  *
- * 包含执行 Ping 操作所需的所有可配置参数，
- * 如超时时间、数据包大小、TTL、源路由等。
+ * 写入前把 seq 加一变为奇数，写完再加一变回偶数。读取方先读 seq，
+ * 为奇数则重试；复制记录后再读一次 seq，两次相同才说明复制的内容一致。
  */
-struct PingOptions {
-    int timeout_ms = DEFAULT_TIMEOUT_MS;     ///< 超时时间（毫秒）
-    int payload_size = DEFAULT_PAYLOAD_SIZE; ///< 发送数据包大小（字节）
-    int ttl = DEFAULT_TTL;                   ///< TTL（生存时间）值
-    int tos = 0;                             ///< TOS（服务类型）值
-    bool dont_fragment = false;              ///< 是否设置不分段标志
-    int record_route = 0;                    ///< 记录路由跳数（0 表示禁用）
-    int timestamp = 0;                       ///< 时间戳数量（0 表示禁用）
-    std::vector<std::string> loose_source_route;   ///< 宽松源路由节点列表
-    std::vector<std::string> strict_source_route;  ///< 严格源路由节点列表
-    std::string source_address;              ///< 源地址（可选）
+struct ShmRecord {
+    volatile LONG seq;                       ///< 序列锁计数
+    uint32_t reserved;                       ///< 保留（对齐）
+    char addr[SHM_ADDR_LEN];                 ///< 目标地址
+    uint64_t completed;                      ///< 已完成的探测数
+    uint64_t received;                       ///< 按时收到的回复数
+    uint64_t late;                           ///< 迟到回复数
+    uint64_t last_ms;                        ///< 最近一次完成的时刻（毫秒）
+    uint32_t last_rtt_us;                    ///< 最近一次回复的 RTT（微秒）
+    uint32_t min_rtt_us;                     ///< 最小 RTT（微秒，无回复时为 0）
+    uint32_t max_rtt_us;                     ///< 最大 RTT（微秒）
+    uint32_t reserved2;                      ///< 保留（对齐）
+    uint64_t rtt_sum_us;                     ///< RTT 之和（微秒）
+    uint64_t hist[SHM_HIST_BUCKETS];         ///< RTT 直方图
+};
+
+/**
+ * @class SharedStats
+ * @brief 通过命名共享内存发布实时统计
+ *
+ * 使用页面文件支持的命名文件映射（CreateFileMapping），其他本地进程用
+ * OpenFileMapping 打开同名映射即可直接读取，无需复制或与 qping 通信。
+ * 探测线程更新记录只是内存写入和一次原子交换，不进行系统调用。
+ */
+class SharedStats {
+public:
+    SharedStats() = default;
+    ~SharedStats() { close(); }
+
+    /**
+     * @brief 创建共享内存区域并初始化布局
+     * @param name 映射名（可带 "Local\" 或 "Global\" 前缀）
+     * @param targets 目标地址列表，record 使用其下标
+     * @return 成功返回 true，失败时输出错误信息并返回 false
+     */
+    bool create(const std::string& name, const std::vector<std::string>& targets);
+
+    /**
+     * @brief 标记为已结束并释放映射
+     */
+    void close();
+
+    /** @brief 是否已创建 */
+    bool is_open() const { return header_ != nullptr; }
+
+    /**
+     * @brief 记录一次探测结果（线程安全，无系统调用）
+     * @param target 目标序号
+     * @param success 是否按时收到回复
+     * @param late 是否为迟到回复
+     * @param rtt_us 往返时间（微秒）
+     */
+    void record(size_t target, bool success, bool late, uint32_t rtt_us);
+
+    /**
+     * @brief 更新心跳时刻（由主线程周期调用）
+     */
+    void heartbeat();
+
+    // 禁用拷贝
+    SharedStats(const SharedStats&) = delete;
+    SharedStats& operator=(const SharedStats&) = delete;
+
+private:
+    HANDLE mapping_ = nullptr;               ///< 文件映射句柄
+    ShmHeader* header_ = nullptr;            ///< 映射视图（头部）
+    ShmRecord* records_ = nullptr;           ///< 记录数组
 };
 
+/**
+ * @brief 读取其他 qping 进程发布的共享内存统计快照
+ * @param name 映射名
+ * @param[out] header 头部副本
+ * @param[out] records 各记录的一致副本
+ * @return 成功返回 true，映射不存在或布局不兼容时输出错误并返回 false
+ */
+bool read_shared_stats(const std::string& name, ShmHeader& header,
+                       std::vector<ShmRecord>& records);
+
 //=============================================================================
 // 工具函数声明
 //=============================================================================
@@ -231,6 +2327,83 @@ std::vector<std::string> split(const std::string& s, char delim);
  */
 bool parse_int(const char* str, int& out);
 
+/**
+ * @brief 将字符串解析为浮点数
+ * @param str 要解析的字符串
+ * @param[out] out 解析结果输出
+ * @return 解析成功返回 true，失败返回 false
+ */
+bool parse_double(const char* str, double& out);
+
+/**
+ * @brief 解析负载大小扫描参数
+ * @param spec 形如 "min:max:step" 的字符串
+ * @param[out] sizes 生成的升序大小序列
+ * @return 格式有效、大小在 0..MAX_PAYLOAD_SIZE 内且级数不超过 MAX_SWEEP_SIZES 时返回 true
+ *
+ * @example
+ * @code
+ * parse_size_sweep("64:1500:500", sizes);  // sizes = {64, 564, 1064, 1500}
+ * @endcode
+ */
+bool parse_size_sweep(const std::string& spec, std::vector<int>& sizes);
+
+/**
+ * @brief 解析模拟 ECMP 参数
+ * @param spec 形如 "paths:bad:loss" 的字符串
+ * @param[out] paths 路径数（2..ECMP_SIM_MAX_PATHS）
+ * @param[out] bad 故障路径序号（0..paths-1）
+ * @param[out] loss 故障路径的丢包率（0..100）
+ * @return 格式和取值都有效时返回 true
+ */
+bool parse_ecmp_sim(const std::string& spec, int& paths, int& bad, int& loss);
+
+/**
+ * @brief 解析 CPU 列表
+ * @param spec 逗号分隔的编号或范围（如 "0-3,6"），或 "all" 表示全部 CPU
+ * @param[out] cpus 去重后的 CPU 编号
+ * @return 格式有效且编号均小于 min(CPU 数, MAX_CPUS) 时返回 true
+ */
+bool parse_cpu_list(const std::string& spec, std::vector<int>& cpus);
+
+//=============================================================================
+// 文件工具函数声明
+//=============================================================================
+
+/**
+ * @brief 追加无符号 varint（每字节 7 位，最高位表示后续还有字节）
+ * @param buf 输出缓冲区
+ * @param v 要编码的值
+ */
+void put_varint(std::string& buf, uint64_t v);
+
+/**
+ * @brief 读取无符号 varint
+ * @param p 读取位置，成功时前移到 varint 之后
+ * @param end 数据末尾
+ * @param[out] v 解码的值
+ * @return 成功返回 true，数据截断时返回 false
+ */
+bool get_varint(const unsigned char*& p, const unsigned char* end, uint64_t& v);
+
+/**
+ * @brief 原子地写入文件：先写 path.tmp，完整写入后替换 path
+ * @param path 目标文件路径
+ * @param data 文件内容
+ * @return 成功返回 true；失败时删除临时文件，原文件不变
+ */
+bool atomic_write_file(const std::string& path, const std::string& data);
+
+/**
+ * @brief 检查映射文件中的一段是否完整落在文件内（不会整数回绕）
+ * @param offset 段起始偏移
+ * @param count 元素数
+ * @param elem_size 每个元素的字节数
+ * @param file_size 文件大小
+ * @return 段完整落在文件内返回 true
+ */
+bool section_in_file(uint64_t offset, uint64_t count, uint64_t elem_size, uint64_t file_size);
+
 //=============================================================================
 // IP 地址函数声明
 //=============================================================================
@@ -271,6 +2444,53 @@ int get_address_family(const std::string& s);
  */
 std::string ip_to_string(uint32_t ip);
 
+/**
+ * @brief 单遍扫描一个目标参数，输出目标描述
+ *
+ * 参数按逗号分为若干项，每项只分类一次：
+ * - 含冒号：IPv6 地址
+ * - 含字母：主机名
+ * - a.b.c.d、a.b.c.d-e、a.b.c.d/n：IPv4 地址、最后一段范围、CIDR
+ * - a.b.c-e：第三段范围（每个子网枚举 .1-.254）
+ * - 单独的 d 或 d-e：沿用前一项的 a.b.c（如 192.168.2.1,3,5-7）
+ *
+ * 不创建中间字符串；相邻的 IPv4 区间自动合并。每个以完整地址开头的
+ * 项（连同其后沿用前缀的项）最多生成 max_hosts 个地址，超出部分截断。
+ *
+ * @param arg 目标参数
+ * @param[out] out 追加的目标描述
+ * @param max_hosts 每项的最大地址数
+ * @return 解析成功返回 true，失败返回 false 并输出错误信息
+ */
+bool tokenize_targets(TextView arg, std::vector<TargetSpec>& out, uint64_t max_hosts);
+
+/**
+ * @brief 将 IPv4 区间或 IPv6 目标描述展开为地址字符串
+ * @param spec 目标描述（主机名不展开）
+ * @param[out] out 追加的地址
+ */
+void expand_target_spec(const TargetSpec& spec, std::vector<std::string>& out);
+
+/**
+ * @brief 并行把目标描述展开为目标表
+ *
+ * 主机名并行解析；排除列表中的 IPv4 地址直接从区间中扣除，其余排除项
+ * 按字符串匹配。地址总数按 TARGET_EXPAND_CHUNK 划分给多个线程，各线程
+ * 直接写入预先分配好的目标表中自己的区段。
+ *
+ * @param specs 目标描述（tokenize_targets 的输出）
+ * @param exclude 排除的地址
+ * @param exclude_filter 排除文件（未加载时不生效），其地址同样从区间中扣除
+ * @param resolve_af 主机名解析结果保留的地址族（AF_INET、AF_INET6 或 AF_UNSPEC）
+ * @param[out] out 目标表（被替换）
+ * @return 成功返回 true，有主机名无法解析时返回 false 并输出错误信息
+ */
+bool build_target_list(std::vector<TargetSpec> specs,
+                       const std::unordered_set<std::string>& exclude,
+                       const ExcludeFilter& exclude_filter,
+                       int resolve_af,
+                       std::vector<std::string>& out);
+
 /**
  * @brief 解析目标字符串并枚举所有 IP 地址
  *
@@ -291,6 +2511,30 @@ bool enumerate_targets(const std::string& token,
                        std::vector<std::string>& out,
                        unsigned int max_hosts);
 
+/**
+ * @brief 将 IPv4 目标字符串解析为地址区间，不展开为地址列表
+ * @param tok 目标参数（与 tokenize_targets 相同的格式，仅限 IPv4）
+ * @param[out] out 追加的地址区间
+ * @return 解析成功返回 true，失败返回 false 并输出错误信息
+ *
+ * 区间直接取自分词器的输出，不设地址数上限，因此 /8 这样的大范围
+ * 也只占一个元素。
+ */
+bool parse_ipv4_ranges(TextView tok, std::vector<Ipv4Range>& out);
+
+/**
+ * @brief 从抽样区间中扣除排除列表和排除文件中的地址
+ * @param[in,out] ranges 地址区间，被扣除的地址处拆分
+ * @param exclude 排除的地址（非 IPv4 的项忽略）
+ * @param exclude_filter 排除文件（未加载时不生效）
+ *
+ * 扣除后的区间总长即抽样总体大小，排除的地址既不会被抽到，
+ * 也不计入在线主机数的外推。
+ */
+void subtract_excluded_ranges(std::vector<Ipv4Range>& ranges,
+                              const std::unordered_set<std::string>& exclude,
+                              const ExcludeFilter& exclude_filter);
+
 /**
  * @brief 将 IPv4 地址字符串转换为 32 位整数
  * @param ip IPv4 地址字符串（点分十进制格式）
@@ -316,6 +2560,57 @@ std::string compress_ip_ranges(const std::vector<std::string>& ips);
 // Ping 函数声明
 //=============================================================================
 
+/**
+ * @brief 生成指定大小的 Echo 负载
+ * @param size 负载大小（字节）
+ * @return 负载数据
+ */
+std::vector<char> build_payload(int size);
+
+/**
+ * @brief 根据 Ping 选项构造 IPv4 选项信息
+ * @param opts Ping 配置选项
+ * @param[out] options_buffer 选项数据缓冲区（ipopt 使用期间必须保持有效）
+ * @param[out] ipopt 构造好的 IP 选项信息
+ * @return 成功返回 true，源路由地址无效返回 false
+ */
+bool build_ip_options(const PingOptions& opts,
+                      std::vector<unsigned char>& options_buffer,
+                      IP_OPTION_INFORMATION& ipopt);
+
+/**
+ * @brief 解析回复中的 IPv4 选项（记录路由、时间戳）
+ * @param opt_data 选项数据
+ * @param opt_size 选项数据长度（字节）
+ * @param opts Ping 配置选项，决定需要解析哪些选项
+ * @param[out] result 解析结果
+ */
+void parse_reply_options(const unsigned char* opt_data, size_t opt_size,
+                         const PingOptions& opts, PingResult& result);
+
+/**
+ * @brief 单次探测函数类型
+ */
+typedef PingResult (*PingFunc)(const std::string& ip, const PingOptions& opts);
+
+/**
+ * @brief 是否使用了任一 IPv4 选项（-r / -s / -j / -k）
+ * @param opts Ping 配置选项
+ * @return 使用了选项返回 true
+ */
+bool uses_ip_options(const PingOptions& opts);
+
+/**
+ * @brief 按 IPv4 选项选择特化的探测函数
+ *
+ * 不使用任何选项时返回不含选项构造和解析的特化版本，否则返回通用版本。
+ * 选项在运行期间不变，启动时调用一次即可。
+ *
+ * @param opts Ping 配置选项
+ * @return IPv4 探测函数
+ */
+PingFunc select_ping_ipv4(const PingOptions& opts);
+
 /**
  * @brief 执行 IPv4 Ping 操作
  * @param ip 目标 IPv4 地址
@@ -324,6 +2619,13 @@ std::string compress_ip_ranges(const std::vector<std::string>& ips);
  */
 PingResult ping_ipv4(const std::string& ip, const PingOptions& opts);
 
+/**
+ * @brief 比较无选项特化路径和通用选项路径的每次探测开销
+ * @param opts Ping 配置选项（选项相关字段会被覆盖）
+ * @param stop_flag 停止标志（Ctrl+C）
+ */
+void run_options_benchmark(const PingOptions& opts, std::atomic<bool>& stop_flag);
+
 /**
  * @brief 执行 IPv6 Ping 操作
  * @param ip 目标 IPv6 地址
@@ -356,12 +2658,49 @@ std::string resolve_to_ip(const std::string& hostname, bool prefer_ipv6 = false)
  */
 std::vector<std::string> resolve_to_ips(const std::string& hostname, bool prefer_ipv6 = false);
 
+//=============================================================================
+// 抓包回放函数声明
+//=============================================================================
+
 /**
- * @brief 检查字符串是否为可能的主机名（不是 IP 地址）
- * @param s 要检查的字符串
- * @return 如果是可能的主机名返回 true，否则返回 false
+ * @brief 解析原始 IP 数据包中的 ICMP/ICMPv6 Echo 请求或回复
+ * @param data IP 头起始位置
+ * @param len 数据长度
+ * @param[out] out 解析结果
+ * @return 是 Echo 请求或回复返回 true，其他数据包返回 false
+ */
+bool parse_echo_packet(const unsigned char* data, size_t len, EchoPacket& out);
+
+/**
+ * @brief 离线回放 pcap 文件，经过与实时探测相同的回复解析和统计路径
+ *
+ * 请求的目标地址构成目标表，回复按（目标、标识符、序列号）与请求配对，
+ * RTT 由两者时间戳之差得出，超过 opts.timeout_ms 的回复计为迟到。
+ *
+ * @param path pcap 文件路径
+ * @param opts Ping 配置选项（超时、选项解析）
+ * @param[out] targets 目标地址列表（按首次出现顺序）
+ * @param[out] stats 每个目标的统计数据，与 targets 一一对应
+ * @param[out] report 回放汇总结果
+ * @return 成功返回 true，文件无法读取返回 false
+ */
+bool replay_pcap(const std::string& path, const PingOptions& opts,
+                 std::vector<std::string>& targets,
+                 std::vector<TargetStat>& stats,
+                 ReplayReport& report);
+
+//=============================================================================
+// 统计输出函数声明
+//=============================================================================
+
+/**
+ * @brief 输出每个目标和汇总的统计信息，以及在线/失败设备列表
+ * @param targets 目标地址列表
+ * @param stats 每个目标的统计数据
+ * @return 接收到的回复总数
  */
-bool is_possible_hostname(const std::string& s);
+uint64_t print_statistics(const std::vector<std::string>& targets,
+                          const std::vector<TargetStat>& stats);
 
 //=============================================================================
 // 帮助函数声明
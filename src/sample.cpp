@@ -0,0 +1,364 @@
+/**
+ * @file sample.cpp
+ * @brief 统计抽样模块 - 大范围地址在线比例估计
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --sample-rate / --confidence 抽样模式，包括：
+ * - 基于 Feistel 网络的 [0, n) 伪随机置换，按需生成抽样地址
+ * - 分批交给探测引擎探测，不生成完整的目标列表
+ * - Wilson 置信区间（含有限总体修正）和提前停止
+ * - 总体和各 /16 前缀的在线比例与在线主机数估计
+ */
+
+#include "qping.h"
+
+#include <cmath>
+
+namespace qping {
+
+//=============================================================================
+// 伪随机置换
+//=============================================================================
+
+/**
+ * @brief 64 位混合函数（splitmix64 终结步骤）
+ */
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * @brief 构造函数
+ *
+ * 域大小取不小于 n 的最小偶数位 2 的幂，因此循环行走的期望步数不超过 4。
+ */
+IndexPermutation::IndexPermutation(uint64_t n, uint64_t seed) : n_(n) {
+    int bits = 2;
+    while (bits < 64 && (1ull << bits) < n) {
+        bits++;
+    }
+    bits += bits & 1;
+    half_bits_ = bits / 2;
+    half_mask_ = (1ull << half_bits_) - 1;
+
+    for (int i = 0; i < ROUNDS; ++i) {
+        seed = mix64(seed + 0x9E3779B97F4A7C15ull);
+        keys_[i] = seed;
+    }
+}
+
+/**
+ * @brief 在 2^(2 × half_bits) 的域上做一次 Feistel 加密
+ */
+uint64_t IndexPermutation::encrypt(uint64_t x) const {
+    uint64_t left = x >> half_bits_;
+    uint64_t right = x & half_mask_;
+    for (int i = 0; i < ROUNDS; ++i) {
+        uint64_t next = left ^ (mix64(right ^ keys_[i]) & half_mask_);
+        left = right;
+        right = next;
+    }
+    return (left << half_bits_) | right;
+}
+
+/**
+ * @brief 返回第 i 个位置上的值
+ *
+ * 加密结果落在 [n, 域大小) 时继续加密，直到落入 [0, n)。由于加密是域上的
+ * 双射，这样得到的仍是 [0, n) 上的双射。
+ */
+uint64_t IndexPermutation::operator()(uint64_t i) const {
+    uint64_t x = i;
+    do {
+        x = encrypt(x);
+    } while (x >= n_);
+    return x;
+}
+
+//=============================================================================
+// 区间估计
+//=============================================================================
+
+/**
+ * @brief 计算双侧置信水平对应的标准正态分位数
+ *
+ * 对 erfc 二分求解 P(|Z| > z) = 1 - confidence。
+ */
+static double normal_quantile(double confidence) {
+    double lo = 0.0, hi = 10.0;
+    for (int i = 0; i < 100; ++i) {
+        double mid = (lo + hi) / 2;
+        if (std::erfc(mid / std::sqrt(2.0)) > 1.0 - confidence) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo + hi) / 2;
+}
+
+/**
+ * @brief 比例的置信区间估计
+ */
+struct Estimate {
+    double p = 0;                            ///< 样本在线比例
+    double lo = 0;                           ///< 区间下限
+    double hi = 0;                           ///< 区间上限
+};
+
+/**
+ * @brief 计算在线比例的 Wilson 置信区间
+ *
+ * 区间半宽乘以有限总体修正系数 sqrt((N - n) / (N - 1))，
+ * 抽样覆盖整个总体时区间收缩为点估计。
+ *
+ * @param live 在线数
+ * @param sampled 抽样数
+ * @param population 总体大小
+ * @param z 标准正态分位数
+ */
+static Estimate wilson_interval(uint64_t live, uint64_t sampled, uint64_t population, double z) {
+    Estimate e;
+    if (sampled == 0) {
+        e.hi = 1.0;
+        return e;
+    }
+    double n = (double)sampled;
+    double p = live / n;
+    double z2 = z * z;
+    double center = (p + z2 / (2 * n)) / (1 + z2 / n);
+    double half = z / (1 + z2 / n) * std::sqrt(p * (1 - p) / n + z2 / (4 * n * n));
+    if (population > 1) {
+        half *= std::sqrt(std::max(0.0, (double)(population - sampled) / (population - 1)));
+    }
+    e.p = p;
+    e.lo = std::max(0.0, center - half);
+    e.hi = std::min(1.0, center + half);
+    if (sampled >= population) {
+        e.lo = e.hi = p;
+    }
+    return e;
+}
+
+//=============================================================================
+// 抽样探测
+//=============================================================================
+
+/**
+ * @brief 单个 /16 前缀的抽样统计
+ */
+struct PrefixSample {
+    uint64_t population = 0;                 ///< 该前缀内属于抽样范围的地址数
+    uint64_t sampled = 0;                    ///< 已抽样
+    uint64_t live = 0;                       ///< 在线
+};
+
+/**
+ * @brief 用探测引擎探测一批地址，返回每个地址是否在线
+ * @return 引擎启动失败（如源路由地址无效）时返回 false
+ */
+static bool probe_batch(const std::vector<std::string>& batch,
+                        const PingOptions& opts,
+                        const SampleConfig& config,
+                        std::atomic<bool>& stop_flag,
+                        std::vector<bool>& live) {
+    std::vector<TargetStat> stats(batch.size());
+
+    EngineConfig engine_cfg;
+    engine_cfg.window = 1;
+    engine_cfg.interval_ms = 0;
+    engine_cfg.count = config.probes_per_host;
+    engine_cfg.max_in_flight = config.concurrency;
+
+    std::atomic<bool> done{false};
+    ProbeEngine engine(batch, stats, opts, engine_cfg);
+    if (!engine.start(done)) {
+        return false;
+    }
+    while (!done.load()) {
+        if (stop_flag.load()) {
+            done.store(true);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ENGINE_MAX_WAIT_MS));
+    }
+    engine.join();
+
+    live.assign(batch.size(), false);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        live[i] = stats[i].recv.load() > 0;
+    }
+    return true;
+}
+
+/**
+ * @brief 按随机顺序抽样探测地址区间并输出在线比例估计
+ */
+bool run_sampling(std::vector<Ipv4Range> ranges,
+                  const std::unordered_set<std::string>& exclude,
+                  const ExcludeFilter& exclude_filter,
+                  const PingOptions& opts,
+                  const SampleConfig& config,
+                  std::atomic<bool>& stop_flag,
+                  uint64_t& live) {
+    live = 0;
+
+    //-------------------------------------------------------------------------
+    // 排除的地址先从区间中扣除，不计入总体，抽样覆盖全部时区间收缩为点
+    //-------------------------------------------------------------------------
+    uint64_t requested = 0;
+    for (const auto& r : ranges) {
+        requested += r.count;
+    }
+    subtract_excluded_ranges(ranges, exclude, exclude_filter);
+
+    //-------------------------------------------------------------------------
+    // 区间前缀和，用于把置换下标映射回地址
+    //-------------------------------------------------------------------------
+    std::vector<uint64_t> offsets;
+    uint64_t total = 0;
+    for (const auto& r : ranges) {
+        offsets.push_back(total);
+        total += r.count;
+    }
+    if (total == 0) {
+        fprintf(stderr, "抽样范围为空\n");
+        return true;
+    }
+
+    // 各 /16 前缀内属于抽样范围的地址数
+    std::unordered_map<uint32_t, PrefixSample> prefixes;
+    for (const auto& r : ranges) {
+        uint64_t cur = r.first;
+        uint64_t end = (uint64_t)r.first + r.count;
+        while (cur < end) {
+            uint64_t block_end = std::min(end, ((cur >> 16) + 1) << 16);
+            prefixes[(uint32_t)(cur >> 16)].population += block_end - cur;
+            cur = block_end;
+        }
+    }
+
+    uint64_t limit = (uint64_t)std::ceil(total * std::min(1.0, config.sample_rate));
+    limit = std::max<uint64_t>(1, std::min(limit, total));
+    const double z = normal_quantile(config.confidence);
+
+    LARGE_INTEGER seed;
+    QueryPerformanceCounter(&seed);
+    IndexPermutation perm(total, (uint64_t)seed.QuadPart ^ GetCurrentProcessId());
+
+    printf("抽样范围: %llu 个地址", (unsigned long long)total);
+    if (requested > total) {
+        printf(" (已排除 %llu 个)", (unsigned long long)(requested - total));
+    }
+    printf(", 最多抽样 %llu 个 (%.4g%%), 置信水平 %.1f%%",
+           (unsigned long long)limit, 100.0 * limit / total, config.confidence * 100);
+    if (config.early_stop) {
+        printf(", 区间半宽不超过 %.4g%% 时停止", config.margin * 100);
+    }
+    printf("\n");
+
+    //-------------------------------------------------------------------------
+    // 分批抽样
+    //-------------------------------------------------------------------------
+    uint64_t next = 0, sampled = 0;
+    std::vector<std::string> batch;
+    std::vector<uint32_t> batch_addrs;
+    std::vector<bool> batch_live;
+    bool converged = false;
+
+    while (next < limit && !stop_flag.load() && !converged) {
+        batch.clear();
+        batch_addrs.clear();
+        while (batch.size() < SAMPLE_BATCH_SIZE && next < limit) {
+            uint64_t idx = perm(next++);
+            size_t r = (size_t)(std::upper_bound(offsets.begin(), offsets.end(), idx) - offsets.begin()) - 1;
+            uint32_t addr = (uint32_t)(ranges[r].first + (idx - offsets[r]));
+            batch.push_back(ip_to_string(addr));
+            batch_addrs.push_back(addr);
+        }
+
+        if (!probe_batch(batch, opts, config, stop_flag, batch_live)) {
+            return false;
+        }
+        if (stop_flag.load()) {
+            break;  // 中断的批次结果不完整，不计入估计
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            PrefixSample& ps = prefixes[batch_addrs[i] >> 16];
+            ps.sampled++;
+            sampled++;
+            if (batch_live[i]) {
+                ps.live++;
+                live++;
+            }
+        }
+
+        Estimate e = wilson_interval(live, sampled, total, z);
+        double half = (e.hi - e.lo) / 2;
+        printf("已抽样 %llu, 在线 %llu, 在线比例 %.3f%% [%.3f%%, %.3f%%]\n",
+               (unsigned long long)sampled, (unsigned long long)live,
+               e.p * 100, e.lo * 100, e.hi * 100);
+        if (config.early_stop && sampled >= SAMPLE_MIN_PROBES && half <= config.margin) {
+            converged = true;
+        }
+    }
+
+    //-------------------------------------------------------------------------
+    // 输出估计结果
+    //-------------------------------------------------------------------------
+    Estimate e = wilson_interval(live, sampled, total, z);
+    printf("\n--- 抽样估计 ---\n");
+    printf("抽样=%llu/%llu, 在线=%llu%s\n", (unsigned long long)sampled,
+           (unsigned long long)total, (unsigned long long)live,
+           converged ? " (区间已收敛，提前停止)" : "");
+    printf("在线比例: %.3f%% [%.3f%%, %.3f%%]\n", e.p * 100, e.lo * 100, e.hi * 100);
+    printf("估计在线主机: %.0f [%.0f, %.0f]\n", e.p * total, e.lo * total, e.hi * total);
+
+    // 按估计在线数排序输出各 /16 前缀
+    std::vector<std::pair<uint32_t, Estimate>> rows;
+    size_t silent = 0;
+    for (const auto& kv : prefixes) {
+        const PrefixSample& ps = kv.second;
+        if (ps.sampled == 0) {
+            continue;
+        }
+        if (ps.live == 0) {
+            silent++;
+            continue;
+        }
+        rows.emplace_back(kv.first, wilson_interval(ps.live, ps.sampled, ps.population, z));
+    }
+    std::sort(rows.begin(), rows.end(), [&](const std::pair<uint32_t, Estimate>& a,
+                                            const std::pair<uint32_t, Estimate>& b) {
+        return a.second.p * prefixes[a.first].population > b.second.p * prefixes[b.first].population;
+    });
+
+    if (!rows.empty()) {
+        printf("\n%-18s %8s %8s %10s %22s %10s\n", "前缀", "抽样", "在线", "在线比例", "置信区间", "估计在线");
+    }
+    for (size_t i = 0; i < rows.size() && i < SAMPLE_REPORT_PREFIXES; ++i) {
+        const PrefixSample& ps = prefixes[rows[i].first];
+        const Estimate& pe = rows[i].second;
+        std::string prefix = ip_to_string(rows[i].first << 16) + "/16";
+        printf("%-18s %8llu %8llu %9.3f%% [%8.3f%%, %8.3f%%] %10.0f\n", prefix.c_str(),
+               (unsigned long long)ps.sampled, (unsigned long long)ps.live,
+               pe.p * 100, pe.lo * 100, pe.hi * 100, pe.p * ps.population);
+    }
+    if (rows.size() > SAMPLE_REPORT_PREFIXES) {
+        printf("... 另有 %zu 个有在线主机的前缀未列出\n", rows.size() - SAMPLE_REPORT_PREFIXES);
+    }
+    printf("未发现在线主机的已抽样 /16 前缀: %zu\n", silent);
+
+    return true;
+}
+
+} // namespace qping
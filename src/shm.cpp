@@ -0,0 +1,222 @@
+/**
+ * @file shm.cpp
+ * @brief 共享内存统计模块 - 供外部进程读取的实时统计
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --shm 选项和 qping shm 子命令，包括：
+ * - 命名文件映射中的版本化布局（ShmHeader + ShmRecord 数组）
+ * - 每条记录独立的序列锁，写入方之间用比较交换互斥
+ * - 对数分桶的 RTT 直方图
+ * - 读取方的一致快照复制
+ */
+
+#include "qping.h"
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/** @brief 读取方在放弃前重试一条记录的次数 */
+static const int SHM_READ_RETRIES = 1000;
+
+/**
+ * @brief RTT 所属的直方图桶：floor(log2(rtt_us))，超出范围归入最后一桶
+ */
+static int hist_bucket(uint32_t rtt_us) {
+    int b = 0;
+    while (rtt_us > 1 && b < SHM_HIST_BUCKETS - 1) {
+        rtt_us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/**
+ * @brief 当前时刻（自 1970-01-01 起的毫秒数）
+ */
+static uint64_t shm_now_ms() {
+    return PcapWriter::now_ns() / 1000000;
+}
+
+//=============================================================================
+// 写入方
+//=============================================================================
+
+/**
+ * @brief 创建共享内存区域并初始化布局
+ *
+ * 映射由页面文件支持，初始内容为零；头部在所有记录初始化之后才写入
+ * magic，读取方看到 magic 即可认为布局完整。
+ */
+bool SharedStats::create(const std::string& name, const std::vector<std::string>& targets) {
+    uint64_t size = sizeof(ShmHeader) + (uint64_t)sizeof(ShmRecord) * targets.size();
+    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                  (DWORD)(size >> 32), (DWORD)size, name.c_str());
+    if (!mapping_) {
+        fprintf(stderr, "无法创建共享内存: %s\n", name.c_str());
+        return false;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        fprintf(stderr, "共享内存已存在（可能有其他 qping 正在使用）: %s\n", name.c_str());
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size);
+    if (!view) {
+        fprintf(stderr, "无法映射共享内存: %s\n", name.c_str());
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+        return false;
+    }
+
+    header_ = (ShmHeader*)view;
+    records_ = (ShmRecord*)((char*)view + sizeof(ShmHeader));
+    for (size_t i = 0; i < targets.size(); ++i) {
+        strncpy(records_[i].addr, targets[i].c_str(), SHM_ADDR_LEN - 1);
+    }
+
+    header_->version = SHM_VERSION;
+    header_->header_size = sizeof(ShmHeader);
+    header_->record_size = sizeof(ShmRecord);
+    header_->target_count = (uint32_t)targets.size();
+    header_->hist_buckets = SHM_HIST_BUCKETS;
+    header_->pid = GetCurrentProcessId();
+    header_->start_ms = shm_now_ms();
+    header_->heartbeat_ms = header_->start_ms;
+    header_->state = SHM_STATE_RUNNING;
+    MemoryBarrier();
+    header_->magic = SHM_MAGIC;
+    return true;
+}
+
+/**
+ * @brief 标记为已结束并释放映射
+ *
+ * 映射在最后一个读取方关闭句柄前仍然存在，读取方可以看到最终统计。
+ */
+void SharedStats::close() {
+    if (header_) {
+        header_->heartbeat_ms = shm_now_ms();
+        MemoryBarrier();
+        header_->state = SHM_STATE_FINISHED;
+        UnmapViewOfFile(header_);
+        header_ = nullptr;
+        records_ = nullptr;
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+}
+
+/**
+ * @brief 记录一次探测结果
+ *
+ * 传统模式下多个工作线程可能同时更新同一目标，因此写入方先用比较交换
+ * 把偶数 seq 改为奇数以获得独占，写完后原子地改为下一个偶数。
+ */
+void SharedStats::record(size_t target, bool success, bool late, uint32_t rtt_us) {
+    if (!header_ || target >= header_->target_count) {
+        return;
+    }
+    ShmRecord& r = records_[target];
+
+    LONG seq;
+    for (;;) {
+        seq = r.seq;
+        if (!(seq & 1) && InterlockedCompareExchange(&r.seq, seq + 1, seq) == seq) {
+            break;
+        }
+        YieldProcessor();
+    }
+
+    r.completed++;
+    r.last_ms = shm_now_ms();
+    if (late) {
+        r.late++;
+    } else if (success) {
+        r.received++;
+        r.last_rtt_us = rtt_us;
+        r.min_rtt_us = (r.received == 1) ? rtt_us : std::min(r.min_rtt_us, rtt_us);
+        r.max_rtt_us = std::max(r.max_rtt_us, rtt_us);
+        r.rtt_sum_us += rtt_us;
+        r.hist[hist_bucket(rtt_us)]++;
+    }
+
+    // InterlockedExchange 是完整屏障，保证数据写入先于 seq 变回偶数
+    InterlockedExchange(&r.seq, seq + 2);
+}
+
+/**
+ * @brief 更新心跳时刻
+ */
+void SharedStats::heartbeat() {
+    if (header_) {
+        header_->heartbeat_ms = shm_now_ms();
+    }
+}
+
+//=============================================================================
+// 读取方
+//=============================================================================
+
+/**
+ * @brief 读取其他 qping 进程发布的共享内存统计快照
+ */
+bool read_shared_stats(const std::string& name, ShmHeader& header,
+                       std::vector<ShmRecord>& records) {
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (!mapping) {
+        fprintf(stderr, "共享内存不存在: %s\n", name.c_str());
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        fprintf(stderr, "无法映射共享内存: %s\n", name.c_str());
+        CloseHandle(mapping);
+        return false;
+    }
+
+    const ShmHeader* h = (const ShmHeader*)view;
+    bool ok = h->magic == SHM_MAGIC && h->version == SHM_VERSION &&
+              h->header_size >= sizeof(ShmHeader) && h->record_size >= sizeof(ShmRecord);
+    if (!ok) {
+        fprintf(stderr, "共享内存布局不兼容: %s\n", name.c_str());
+    } else {
+        memcpy(&header, (const void*)h, sizeof(ShmHeader));
+        records.resize(header.target_count);
+        const char* base = (const char*)view + header.header_size;
+        for (uint32_t i = 0; i < header.target_count && ok; ++i) {
+            const ShmRecord* src = (const ShmRecord*)(base + (size_t)i * header.record_size);
+            int tries = 0;
+            for (;; ++tries) {
+                LONG before = src->seq;
+                MemoryBarrier();
+                memcpy((void*)&records[i], (const void*)src, sizeof(ShmRecord));
+                MemoryBarrier();
+                if (!(before & 1) && src->seq == before) {
+                    break;
+                }
+                if (tries >= SHM_READ_RETRIES) {
+                    fprintf(stderr, "读取共享内存记录超时: %u\n", i);
+                    ok = false;
+                    break;
+                }
+                YieldProcessor();
+            }
+        }
+    }
+
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    return ok;
+}
+
+} // namespace qping
@@ -0,0 +1,362 @@
+/**
+ * @file sketch.cpp
+ * @brief 延迟草图模块 - 可合并的 RTT 分位数摘要
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 --sketch 选项和 qping merge 子命令，包括：
+ * - DDSketch：按对数间隔分桶，任意分位数的相对误差不超过 SKETCH_ALPHA
+ * - 每个目标一个草图（全局草图由其合并得到），结束时以 varint 紧凑编码写入结果文件
+ * - 多个分片的结果文件按目标地址逐桶相加，合并后误差界不变
+ *
+ * 扫描拆分到多个进程或主机时，各分片的 P99 无法直接合并；草图的桶
+ * 计数可以相加，全网 P99 只需几 KB 的结果文件而不是全部原始样本。
+ */
+
+#include "qping.h"
+#include <cmath>
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/**
+ * @brief 相邻桶边界之比 γ = (1 + α) / (1 - α)
+ */
+static double sketch_gamma() {
+    return (1.0 + SKETCH_ALPHA) / (1.0 - SKETCH_ALPHA);
+}
+
+/**
+ * @brief 以毫秒输出分位数（无样本时为 "-"）
+ */
+static std::string format_quantile_ms(const LatencySketch& s, double q) {
+    if (s.count() == 0) {
+        return "-";
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f", s.quantile(q) / 1000.0);
+    return buf;
+}
+
+//=============================================================================
+// 草图
+//=============================================================================
+
+/**
+ * @brief 值所在的桶序号：ceil(log_γ(us))，1 微秒为第 0 桶
+ */
+int LatencySketch::index_of(uint64_t us) {
+    static const double log_gamma = std::log(sketch_gamma());
+    return (int)std::ceil(std::log((double)us) / log_gamma - 1e-9);
+}
+
+/**
+ * @brief 记录一个样本
+ *
+ * 桶数组只覆盖出现过的最小到最大桶序号，同一目标的 RTT 通常集中在
+ * 很窄的范围内，只需几十个桶。
+ */
+void LatencySketch::add(uint64_t us) {
+    count_++;
+    min_us_ = (count_ == 1) ? us : std::min(min_us_, us);
+    max_us_ = std::max(max_us_, us);
+    if (us == 0) {
+        zero_++;
+        return;
+    }
+    int k = index_of(us);
+    if (counts_.empty()) {
+        offset_ = k;
+        counts_.push_back(0);
+    } else if (k < offset_) {
+        counts_.insert(counts_.begin(), (size_t)(offset_ - k), 0);
+        offset_ = k;
+    } else if (k >= offset_ + (int)counts_.size()) {
+        counts_.resize((size_t)(k - offset_ + 1), 0);
+    }
+    counts_[(size_t)(k - offset_)]++;
+}
+
+/**
+ * @brief 合并另一个草图：对应桶的计数相加
+ */
+void LatencySketch::merge(const LatencySketch& other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    min_us_ = (count_ == 0) ? other.min_us_ : std::min(min_us_, other.min_us_);
+    max_us_ = std::max(max_us_, other.max_us_);
+    count_ += other.count_;
+    zero_ += other.zero_;
+    if (other.counts_.empty()) {
+        return;
+    }
+    if (counts_.empty()) {
+        offset_ = other.offset_;
+        counts_ = other.counts_;
+        return;
+    }
+    int lo = std::min(offset_, other.offset_);
+    int hi = std::max(offset_ + (int)counts_.size(), other.offset_ + (int)other.counts_.size());
+    if (lo < offset_) {
+        counts_.insert(counts_.begin(), (size_t)(offset_ - lo), 0);
+        offset_ = lo;
+    }
+    counts_.resize((size_t)(hi - offset_), 0);
+    for (size_t i = 0; i < other.counts_.size(); ++i) {
+        counts_[(size_t)(other.offset_ - offset_) + i] += other.counts_[i];
+    }
+}
+
+/**
+ * @brief 估计分位数（微秒）
+ *
+ * 找到累计计数超过 q × (n - 1) 的桶，返回桶内相对误差最小的代表值
+ * 2γ^k / (γ + 1)，并限制在实际最小值和最大值之间；q 为 0 和 1 时
+ * 直接返回精确的最小值和最大值。
+ */
+double LatencySketch::quantile(double q) const {
+    if (count_ == 0) {
+        return 0.0;
+    }
+    if (q <= 0.0) {
+        return (double)min_us_;
+    }
+    if (q >= 1.0) {
+        return (double)max_us_;
+    }
+    double rank = q * (double)(count_ - 1);
+    uint64_t seen = zero_;
+    if ((double)seen > rank) {
+        return 0.0;
+    }
+    const double gamma = sketch_gamma();
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if ((double)seen > rank) {
+            double value = 2.0 * std::pow(gamma, offset_ + (int)i) / (gamma + 1.0);
+            return std::max((double)min_us_, std::min((double)max_us_, value));
+        }
+    }
+    return (double)max_us_;
+}
+
+/**
+ * @brief 以 varint 追加编码：样本数、零值数、最小值、最大值、起始桶序号、
+ *        桶数和各桶计数
+ */
+void LatencySketch::encode(std::string& out) const {
+    put_varint(out, count_);
+    put_varint(out, zero_);
+    put_varint(out, min_us_);
+    put_varint(out, max_us_);
+    put_varint(out, (uint64_t)std::max(0, offset_));
+    put_varint(out, counts_.size());
+    for (uint64_t c : counts_) {
+        put_varint(out, c);
+    }
+}
+
+/**
+ * @brief 解码 encode 写出的草图，并校验各桶计数之和
+ */
+bool LatencySketch::decode(const unsigned char*& p, const unsigned char* end) {
+    uint64_t offset, buckets;
+    if (!get_varint(p, end, count_) || !get_varint(p, end, zero_) ||
+        !get_varint(p, end, min_us_) || !get_varint(p, end, max_us_) ||
+        !get_varint(p, end, offset) || !get_varint(p, end, buckets) ||
+        offset > (uint64_t)SKETCH_MAX_BUCKETS || buckets > (uint64_t)SKETCH_MAX_BUCKETS ||
+        buckets > (uint64_t)(end - p)) {
+        return false;
+    }
+    offset_ = (int)offset;
+    counts_.assign((size_t)buckets, 0);
+    uint64_t total = zero_;
+    for (auto& c : counts_) {
+        if (!get_varint(p, end, c)) {
+            return false;
+        }
+        total += c;
+    }
+    return total == count_;
+}
+
+//=============================================================================
+// 结果文件
+//=============================================================================
+
+/**
+ * @brief 按目标列表初始化（--sketch）
+ */
+void LatencyResults::init(const std::vector<std::string>& targets) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    entries_.clear();
+    index_.clear();
+    global_ = LatencySketch();
+    entries_.resize(targets.size());
+    for (size_t i = 0; i < targets.size(); ++i) {
+        entries_[i].addr = targets[i];
+        index_[targets[i]] = i;
+    }
+}
+
+/**
+ * @brief 记录一次探测结果
+ */
+void LatencyResults::record(size_t target, bool success, uint32_t rtt_us) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (target >= entries_.size()) {
+        return;
+    }
+    Entry& e = entries_[target];
+    e.sent++;
+    if (success) {
+        e.recv++;
+        e.sketch.add(rtt_us);
+        global_.add(rtt_us);
+    }
+}
+
+/**
+ * @brief 读取结果文件并合并到当前结果
+ *
+ * 相同地址的目标计数和草图相加，新地址追加在末尾；相对误差参数不同的
+ * 文件桶边界不一致，不能合并。
+ */
+bool LatencyResults::load(const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+        fprintf(stderr, "无法打开结果文件: %s\n", path.c_str());
+        return false;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+
+    SketchFileHeader header;
+    if (data.size() < sizeof(header)) {
+        fprintf(stderr, "结果文件格式无效: %s\n", path.c_str());
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != SKETCH_MAGIC || header.version != SKETCH_VERSION) {
+        fprintf(stderr, "结果文件格式无效: %s\n", path.c_str());
+        return false;
+    }
+    if (header.alpha != SKETCH_ALPHA) {
+        fprintf(stderr, "结果文件的相对误差参数(%g)与当前版本(%g)不同: %s\n",
+                header.alpha, SKETCH_ALPHA, path.c_str());
+        return false;
+    }
+
+    // 先完整解析，全部有效后再合并，损坏的文件不留下部分结果
+    const unsigned char* p = data.data() + sizeof(header);
+    const unsigned char* end = data.data() + data.size();
+    std::vector<Entry> loaded;
+    loaded.reserve((size_t)std::min<uint64_t>(header.target_count, data.size()));
+    bool ok = true;
+    for (uint64_t i = 0; ok && i < header.target_count; ++i) {
+        Entry e;
+        uint64_t len;
+        ok = get_varint(p, end, len) && len <= (uint64_t)(end - p);
+        if (ok) {
+            e.addr.assign((const char*)p, (size_t)len);
+            p += len;
+            ok = get_varint(p, end, e.sent) && get_varint(p, end, e.recv) &&
+                 e.sketch.decode(p, end) && e.sketch.count() == e.recv;
+        }
+        if (ok) {
+            loaded.push_back(std::move(e));
+        }
+    }
+    if (!ok || p != end) {
+        fprintf(stderr, "结果文件格式无效: %s\n", path.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    for (auto& e : loaded) {
+        auto ins = index_.emplace(e.addr, entries_.size());
+        if (ins.second) {
+            entries_.push_back(Entry());
+            entries_.back().addr = e.addr;
+        }
+        Entry& dst = entries_[ins.first->second];
+        dst.sent += e.sent;
+        dst.recv += e.recv;
+        dst.sketch.merge(e.sketch);
+        global_.merge(e.sketch);
+    }
+    return true;
+}
+
+/**
+ * @brief 写出结果文件
+ *
+ * 头部之后依次是每个目标的地址、已发送、已接收和草图，均为 varint
+ * 编码。全局草图可由各目标草图合并得到，不单独保存。写入临时文件后
+ * 替换目标文件。
+ */
+bool LatencyResults::save(const std::string& path, uint64_t& bytes) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    SketchFileHeader header = {};
+    header.magic = SKETCH_MAGIC;
+    header.version = SKETCH_VERSION;
+    header.alpha = SKETCH_ALPHA;
+    header.target_count = entries_.size();
+
+    std::string data((const char*)&header, sizeof(header));
+    for (const auto& e : entries_) {
+        put_varint(data, e.addr.size());
+        data += e.addr;
+        put_varint(data, e.sent);
+        put_varint(data, e.recv);
+        e.sketch.encode(data);
+    }
+    bytes = data.size();
+
+    if (!atomic_write_file(path, data)) {
+        fprintf(stderr, "无法写入结果文件: %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 输出每个目标和全局的丢失率与 RTT 分位数
+ */
+void LatencyResults::print_report() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    printf("%-40s %8s %8s %7s %9s %9s %9s %9s\n", "目标", "已发送", "已接收", "丢失率",
+           "P50(ms)", "P90(ms)", "P99(ms)", "最大(ms)");
+    uint64_t sent = 0, recv = 0;
+    for (const auto& e : entries_) {
+        sent += e.sent;
+        recv += e.recv;
+        printf("%-40s %8llu %8llu %6.1f%% %9s %9s %9s %9s\n", e.addr.c_str(),
+               (unsigned long long)e.sent, (unsigned long long)e.recv,
+               e.sent ? 100.0 * (e.sent - e.recv) / e.sent : 0.0,
+               format_quantile_ms(e.sketch, 0.5).c_str(), format_quantile_ms(e.sketch, 0.9).c_str(),
+               format_quantile_ms(e.sketch, 0.99).c_str(),
+               format_quantile_ms(e.sketch, 1.0).c_str());
+    }
+
+    printf("\n全局 (%zu 个目标): 已发送=%llu, 已接收=%llu, 丢失=%.1f%%\n", entries_.size(),
+           (unsigned long long)sent, (unsigned long long)recv,
+           sent ? 100.0 * (sent - recv) / sent : 0.0);
+    printf("RTT(ms, 相对误差 ≤%.0f%%): P50=%s P90=%s P99=%s P99.9=%s 最大=%s\n", SKETCH_ALPHA * 100,
+           format_quantile_ms(global_, 0.5).c_str(), format_quantile_ms(global_, 0.9).c_str(),
+           format_quantile_ms(global_, 0.99).c_str(), format_quantile_ms(global_, 0.999).c_str(),
+           format_quantile_ms(global_, 1.0).c_str());
+}
+
+} // namespace qping
@@ -10,6 +10,9 @@
  * - 单个 IPv4/IPv6 地址
  * - CIDR 表示法（如 192.168.1.0/24）
  * - IP 范围表示法（如 192.168.1.1-10 或 192.168.1-3）
+ * - 逗号列表（如 192.168.2.1,3,5 或 10.0.0.1,example.com）
+ *
+ * 目标参数由单遍分词器直接转换为地址区间描述，最后才展开为地址字符串。
  *
  * 还包含字符串处理和 IP 地址验证的工具函数。
  */
@@ -94,6 +97,131 @@ bool parse_int(const char* str, int& out) {
     return true;
 }
 
+/**
+ * @brief 解析 CPU 列表
+ *
+ * CPU 数取自 GetSystemInfo，并受线程亲和性掩码位数 MAX_CPUS 限制。
+ *
+ * @param spec CPU 列表字符串
+ * @param[out] cpus 按出现顺序去重的 CPU 编号
+ * @return 解析成功返回 true，失败返回 false
+ */
+bool parse_cpu_list(const std::string& spec, std::vector<int>& cpus) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int ncpu = std::min<int>((int)si.dwNumberOfProcessors, MAX_CPUS);
+
+    cpus.clear();
+    if (spec == "all") {
+        for (int i = 0; i < ncpu; ++i) {
+            cpus.push_back(i);
+        }
+        return !cpus.empty();
+    }
+
+    for (const auto& part : split(spec, ',')) {
+        int lo, hi;
+        auto dash = part.find('-');
+        if (dash == std::string::npos) {
+            if (!parse_int(part.c_str(), lo)) {
+                return false;
+            }
+            hi = lo;
+        } else if (!parse_int(part.substr(0, dash).c_str(), lo) ||
+                   !parse_int(part.substr(dash + 1).c_str(), hi)) {
+            return false;
+        }
+        if (lo < 0 || hi < lo || hi >= ncpu) {
+            return false;
+        }
+        for (int c = lo; c <= hi; ++c) {
+            if (std::find(cpus.begin(), cpus.end(), c) == cpus.end()) {
+                cpus.push_back(c);
+            }
+        }
+    }
+    return !cpus.empty();
+}
+
+/**
+ * @brief 将字符串解析为浮点数
+ *
+ * 与 parse_int 相同，要求整个字符串都被解析。
+ *
+ * @param str 要解析的字符串（必须以 null 结尾）
+ * @param[out] out 解析成功时存储结果
+ * @return 解析成功返回 true，失败返回 false
+ */
+bool parse_double(const char* str, double& out) {
+    char* end;
+    double v = strtod(str, &end);
+    if (end == str || *end != '\0') {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+/**
+ * @brief 解析负载大小扫描参数
+ *
+ * 从 min 开始按 step 递增，最后一级不足一个步长时补上 max，
+ * 保证扫描覆盖到指定的最大大小。
+ *
+ * @param spec 形如 "min:max:step" 的字符串
+ * @param[out] sizes 生成的升序大小序列
+ * @return 解析成功返回 true，失败返回 false
+ */
+bool parse_size_sweep(const std::string& spec, std::vector<int>& sizes) {
+    auto parts = split(spec, ':');
+    int lo, hi, step;
+    if (parts.size() != 3 ||
+        !parse_int(parts[0].c_str(), lo) ||
+        !parse_int(parts[1].c_str(), hi) ||
+        !parse_int(parts[2].c_str(), step)) {
+        return false;
+    }
+    if (lo < 0 || hi > MAX_PAYLOAD_SIZE || lo > hi || step <= 0) {
+        return false;
+    }
+    if ((hi - lo) / step + 2 > MAX_SWEEP_SIZES) {
+        return false;
+    }
+
+    sizes.clear();
+    for (int v = lo; v <= hi; v += step) {
+        sizes.push_back(v);
+        if (v > hi - step) {
+            break;  // 防止 v + step 溢出
+        }
+    }
+    if (sizes.back() != hi) {
+        sizes.push_back(hi);
+    }
+    return true;
+}
+
+/**
+ * @brief 解析模拟 ECMP 参数
+ *
+ * @param spec 形如 "paths:bad:loss" 的字符串，如 "4:1:30"
+ * @param[out] paths 路径数
+ * @param[out] bad 故障路径序号
+ * @param[out] loss 故障路径的丢包率（百分比）
+ * @return 解析成功返回 true，失败返回 false
+ */
+bool parse_ecmp_sim(const std::string& spec, int& paths, int& bad, int& loss) {
+    auto parts = split(spec, ':');
+    if (parts.size() != 3 ||
+        !parse_int(parts[0].c_str(), paths) ||
+        !parse_int(parts[1].c_str(), bad) ||
+        !parse_int(parts[2].c_str(), loss)) {
+        return false;
+    }
+    return paths >= 2 && paths <= ECMP_SIM_MAX_PATHS && bad >= 0 && bad < paths &&
+           loss >= 0 && loss <= 100;
+}
+
 //=============================================================================
 // IP 地址验证函数
 //=============================================================================
@@ -199,6 +327,408 @@ std::string ip_to_string(uint32_t ip) {
     return buf;
 }
 
+//=============================================================================
+// 目标分词
+//=============================================================================
+
+/**
+ * @brief 扫描一个不超过 max 的十进制数，成功时 p 移到数字之后
+ */
+static bool scan_number(const char*& p, const char* end, uint32_t max, uint32_t& out) {
+    const char* start = p;
+    uint32_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (uint32_t)(*p - '0');
+        if (v > max) {
+            return false;
+        }
+        ++p;
+    }
+    out = v;
+    return p > start;
+}
+
+/**
+ * @brief 追加一个 IPv4 区间，受剩余地址数限制，与前一个区间相邻时合并
+ */
+static void emit_range(std::vector<TargetSpec>& out, uint32_t first, uint32_t last,
+                       uint64_t& budget) {
+    if (budget == 0) {
+        return;
+    }
+    uint64_t n = (uint64_t)last - first + 1;
+    if (n > budget) {
+        n = budget;
+        last = first + (uint32_t)(n - 1);
+    }
+    budget -= n;
+
+    if (!out.empty() && out.back().kind == TARGET_IPV4_RANGE &&
+        out.back().last != UINT32_MAX && out.back().last + 1 == first) {
+        out.back().last = last;
+        return;
+    }
+    TargetSpec spec;
+    spec.first = first;
+    spec.last = last;
+    out.push_back(spec);
+}
+
+/**
+ * @brief 单遍扫描一个目标参数，输出目标描述
+ *
+ * 逐项扫描：先用一次遍历判断是否含冒号或字母，数字项再按
+ * “八位组 ('.' 八位组)* ['-' 数] ['/' 前缀]” 的文法解析。上一项为
+ * 完整 IPv4 地址（或最后一段范围）时记住其前三段，供其后的单独数字项
+ * 沿用。
+ */
+bool tokenize_targets(TextView arg, std::vector<TargetSpec>& out, uint64_t max_hosts) {
+    const char* next = arg.data;
+    const char* end = arg.data + arg.size;
+    uint32_t base = 0;           // 可沿用的前三段（低 8 位为 0）
+    bool has_base = false;
+    uint64_t budget = max_hosts;
+
+    for (bool more = true; more;) {
+        const char* item = next;
+        const char* item_end = item;
+        while (item_end < end && *item_end != ',') {
+            ++item_end;
+        }
+        more = item_end < end;
+        next = more ? item_end + 1 : end;
+        if (item == item_end) {
+            continue;
+        }
+        const int len = (int)(item_end - item);
+
+        bool has_colon = false, has_alpha = false, has_slash = false;
+        for (const char* c = item; c < item_end; ++c) {
+            has_colon |= (*c == ':');
+            has_slash |= (*c == '/');
+            has_alpha |= ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z'));
+        }
+
+        //---------------------------------------------------------------------
+        // IPv6 地址（单个地址）
+        //---------------------------------------------------------------------
+        if (has_colon) {
+            char buf[INET6_ADDRSTRLEN + 16];
+            in6_addr addr;
+            if ((size_t)len >= sizeof(buf)) {
+                fprintf(stderr, "无效的IPv6地址: %.*s\n", len, item);
+                return false;
+            }
+            memcpy(buf, item, (size_t)len);
+            buf[len] = 0;
+            if (InetPtonA(AF_INET6, buf, &addr) != 1) {
+                fprintf(stderr, "无效的IPv6地址: %.*s\n", len, item);
+                return false;
+            }
+            TargetSpec spec;
+            spec.kind = TARGET_IPV6;
+            spec.text = TextView(item, (size_t)len);
+            out.push_back(spec);
+            has_base = false;
+            continue;
+        }
+
+        //---------------------------------------------------------------------
+        // 主机名
+        //---------------------------------------------------------------------
+        if (has_alpha && !has_slash) {
+            TargetSpec spec;
+            spec.kind = TARGET_HOSTNAME;
+            spec.text = TextView(item, (size_t)len);
+            out.push_back(spec);
+            has_base = false;
+            continue;
+        }
+
+        //---------------------------------------------------------------------
+        // IPv4 文法
+        //---------------------------------------------------------------------
+        uint32_t oct[4] = {};
+        int n = 0;
+        uint32_t hi = 0, prefix = 32;
+        bool range = false, cidr = false;
+        const char* q = item;
+        bool ok = true;
+        while (ok) {
+            ok = scan_number(q, item_end, 255, oct[n]);
+            n++;
+            if (ok && n < 4 && q < item_end && *q == '.') {
+                ++q;
+                continue;
+            }
+            break;
+        }
+        if (ok && q < item_end && *q == '-') {
+            ++q;
+            ok = scan_number(q, item_end, 255, hi);
+            range = true;
+        }
+        if (ok && !range && n == 4 && q < item_end && *q == '/') {
+            ++q;
+            ok = scan_number(q, item_end, 32, prefix);
+            cidr = true;
+        }
+        if (!ok || q != item_end) {
+            fprintf(stderr, "无效的IP或目标格式: %.*s\n", len, item);
+            return false;
+        }
+
+        uint32_t lo = oct[n - 1];
+        if (range && hi < lo) {
+            std::swap(lo, hi);
+        } else if (!range) {
+            hi = lo;
+        }
+
+        if (n == 4 && cidr) {
+            // CIDR：/31 以下排除网络地址和广播地址
+            budget = max_hosts;
+            uint32_t ip = (oct[0] << 24) | (oct[1] << 16) | (oct[2] << 8) | oct[3];
+            uint32_t mask = (prefix == 0) ? 0 : (~0u << (32 - prefix));
+            uint32_t network = ip & mask;
+            uint32_t broadcast = network | ~mask;
+            if (prefix == 32) {
+                emit_range(out, ip, ip, budget);
+            } else if (prefix == 31) {
+                emit_range(out, network, broadcast, budget);
+            } else {
+                emit_range(out, network + 1, broadcast - 1, budget);
+            }
+            has_base = false;
+        } else if (n == 4) {
+            // 单个地址或最后一段范围
+            budget = max_hosts;
+            base = (oct[0] << 24) | (oct[1] << 16) | (oct[2] << 8);
+            has_base = true;
+            emit_range(out, base | lo, base | hi, budget);
+        } else if (n == 3 && range) {
+            // 第三段范围：每个子网 .1-.254
+            budget = max_hosts;
+            uint32_t prefix16 = (oct[0] << 24) | (oct[1] << 16);
+            for (uint32_t c = lo; c <= hi; ++c) {
+                emit_range(out, prefix16 | (c << 8) | 1, prefix16 | (c << 8) | 254, budget);
+            }
+            has_base = false;
+        } else if (n == 1 && has_base) {
+            // 沿用前一项的前三段
+            emit_range(out, base | lo, base | hi, budget);
+        } else {
+            fprintf(stderr, "无效的IP或目标格式: %.*s\n", len, item);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 将 IPv4 区间或 IPv6 目标描述展开为地址字符串
+ */
+void expand_target_spec(const TargetSpec& spec, std::vector<std::string>& out) {
+    if (spec.kind == TARGET_IPV6) {
+        out.push_back(spec.text.str());
+    } else if (spec.kind == TARGET_IPV4_RANGE) {
+        for (uint64_t v = spec.first; v <= spec.last; ++v) {
+            out.push_back(ip_to_string((uint32_t)v));
+        }
+    }
+}
+
+//=============================================================================
+// 目标表构建
+//=============================================================================
+
+/**
+ * @brief 取出排除列表中的 IPv4 地址（已排序去重）
+ * @param exclude 排除的地址
+ * @param[out] has_others 排除列表中是否还有非 IPv4 的项（可为 nullptr）
+ */
+static std::vector<uint32_t> excluded_ipv4(const std::unordered_set<std::string>& exclude,
+                                           bool* has_others) {
+    std::vector<uint32_t> excluded4;
+    for (const auto& e : exclude) {
+        in_addr addr;
+        if (InetPtonA(AF_INET, e.c_str(), &addr) == 1) {
+            excluded4.push_back(ntohl(addr.S_un.S_addr));
+        } else if (has_others) {
+            *has_others = true;
+        }
+    }
+    std::sort(excluded4.begin(), excluded4.end());
+    excluded4.erase(std::unique(excluded4.begin(), excluded4.end()), excluded4.end());
+    return excluded4;
+}
+
+/**
+ * @brief 从 IPv4 区间中扣除排除的地址（已排序去重），区间按需拆分
+ */
+static void subtract_excluded(std::vector<TargetSpec>& specs,
+                              const uint32_t* excluded_begin, const uint32_t* excluded_end) {
+    if (excluded_begin == excluded_end) {
+        return;
+    }
+    std::vector<TargetSpec> result;
+    result.reserve(specs.size());
+    for (const auto& spec : specs) {
+        if (spec.kind != TARGET_IPV4_RANGE) {
+            result.push_back(spec);
+            continue;
+        }
+        uint64_t cur = spec.first;
+        const uint32_t* it = std::lower_bound(excluded_begin, excluded_end, spec.first);
+        for (; it != excluded_end && *it <= spec.last; ++it) {
+            if (*it > cur) {
+                TargetSpec part = spec;
+                part.first = (uint32_t)cur;
+                part.last = *it - 1;
+                result.push_back(part);
+            }
+            cur = (uint64_t)*it + 1;
+        }
+        if (cur <= spec.last) {
+            TargetSpec part = spec;
+            part.first = (uint32_t)cur;
+            result.push_back(part);
+        }
+    }
+    specs.swap(result);
+}
+
+/**
+ * @brief 并行解析所有主机名，结果按描述序号存放
+ */
+static bool resolve_hostnames(const std::vector<TargetSpec>& specs, int resolve_af,
+                              std::vector<std::vector<std::string>>& resolved) {
+    std::vector<size_t> names;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (specs[i].kind == TARGET_HOSTNAME) {
+            names.push_back(i);
+        }
+    }
+    resolved.assign(specs.size(), std::vector<std::string>());
+    if (names.empty()) {
+        return true;
+    }
+
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t k; (k = next.fetch_add(1)) < names.size();) {
+            size_t i = names[k];
+            std::vector<std::string> ips = resolve_to_ips(specs[i].text.str(), resolve_af == AF_INET6);
+            for (auto& ip : ips) {
+                bool v6 = ip.find(':') != std::string::npos;
+                if ((resolve_af == AF_INET6 && !v6) || (resolve_af == AF_INET && v6)) {
+                    continue;
+                }
+                resolved[i].push_back(std::move(ip));
+            }
+        }
+    };
+    size_t thread_count = std::min(names.size(), (size_t)TARGET_RESOLVE_THREADS);
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    for (size_t i : names) {
+        if (resolved[i].empty()) {
+            fprintf(stderr, "无法解析域名: %.*s\n", (int)specs[i].text.size, specs[i].text.data);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 并行把目标描述展开为目标表
+ *
+ * 先按描述计算每项在目标表中的起始位置，再把 [0, 总数) 等分给各线程；
+ * 线程从自己区段的起点所在的描述开始，依次生成地址字符串。按字符串
+ * 排除的地址留下空位，最后统一压缩。
+ */
+bool build_target_list(std::vector<TargetSpec> specs,
+                       const std::unordered_set<std::string>& exclude,
+                       const ExcludeFilter& exclude_filter,
+                       int resolve_af,
+                       std::vector<std::string>& out) {
+    // IPv4 排除项转换为数值，直接从区间中扣除
+    bool string_excludes = false;
+    std::vector<uint32_t> excluded4 = excluded_ipv4(exclude, &string_excludes);
+    subtract_excluded(specs, excluded4.data(), excluded4.data() + excluded4.size());
+    subtract_excluded(specs, exclude_filter.begin(), exclude_filter.end());
+
+    std::vector<std::vector<std::string>> resolved;
+    if (!resolve_hostnames(specs, resolve_af, resolved)) {
+        return false;
+    }
+    // 解析得到的 IPv4 地址只能按字符串排除
+    bool has_names = std::any_of(specs.begin(), specs.end(),
+                                 [](const TargetSpec& spec) { return spec.kind == TARGET_HOSTNAME; });
+    string_excludes = string_excludes || (!excluded4.empty() && has_names);
+    // 解析得到的 IPv4 地址逐个查询排除文件
+    const bool filter_names = has_names && exclude_filter.is_open();
+
+    std::vector<uint64_t> offset(specs.size() + 1, 0);
+    for (size_t i = 0; i < specs.size(); ++i) {
+        const TargetSpec& spec = specs[i];
+        uint64_t n = (spec.kind == TARGET_IPV4_RANGE) ? (uint64_t)spec.last - spec.first + 1
+                   : (spec.kind == TARGET_IPV6) ? 1 : resolved[i].size();
+        offset[i + 1] = offset[i] + n;
+    }
+    const uint64_t total = offset.back();
+
+    std::vector<std::string> table((size_t)total);
+    auto fill = [&](uint64_t begin, uint64_t end) {
+        size_t i = (size_t)(std::upper_bound(offset.begin(), offset.end(), begin) - offset.begin()) - 1;
+        for (uint64_t pos = begin; pos < end; ++i) {
+            const TargetSpec& spec = specs[i];
+            uint64_t stop = std::min(end, offset[i + 1]);
+            for (; pos < stop; ++pos) {
+                uint64_t k = pos - offset[i];
+                std::string& slot = table[(size_t)pos];
+                if (spec.kind == TARGET_IPV4_RANGE) {
+                    slot = ip_to_string((uint32_t)(spec.first + k));
+                    continue;
+                }
+                slot = (spec.kind == TARGET_IPV6) ? spec.text.str() : resolved[i][(size_t)k];
+                if (string_excludes && exclude.find(slot) != exclude.end()) {
+                    slot.clear();
+                } else if (filter_names && spec.kind == TARGET_HOSTNAME &&
+                           exclude_filter.contains(ip_to_uint32(slot))) {
+                    slot.clear();
+                }
+            }
+        }
+    };
+
+    size_t thread_count = (size_t)std::max<uint64_t>(1, total / TARGET_EXPAND_CHUNK);
+    thread_count = std::min<size_t>(thread_count, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; ++t) {
+        threads.emplace_back(fill, total * t / thread_count, total * (t + 1) / thread_count);
+    }
+    fill(0, total / thread_count);
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    if (string_excludes || filter_names) {
+        table.erase(std::remove_if(table.begin(), table.end(),
+                                   [](const std::string& ip) { return ip.empty(); }),
+                    table.end());
+    }
+    out = std::move(table);
+    return true;
+}
+
 //=============================================================================
 // 目标枚举函数
 //=============================================================================
@@ -206,7 +736,7 @@ std::string ip_to_string(uint32_t ip) {
 /**
  * @brief 解析目标字符串并枚举所有 IP 地址
  *
- * 这是目标解析的核心函数，支持多种输入格式：
+ * 支持的格式与 tokenize_targets 相同（主机名除外）：
  *
  * 1. **单个 IPv4 地址**: `192.168.1.1`
  * 2. **单个 IPv6 地址**: `2001:db8::1`
@@ -242,262 +772,96 @@ std::string ip_to_string(uint32_t ip) {
 bool enumerate_targets(const std::string& tok,
                        std::vector<std::string>& out,
                        unsigned int max_hosts) {
-
-    //-------------------------------------------------------------------------
-    // 处理 IPv6 地址（仅支持单个地址）
-    //-------------------------------------------------------------------------
-    if (is_ipv6_address(tok)) {
-        if (is_valid_ipv6_address(tok)) {
-            out.push_back(tok);
-            return true;
-        }
-        fprintf(stderr, "无效的IPv6地址: %s\n", tok.c_str());
+    std::vector<TargetSpec> specs;
+    if (!tokenize_targets(TextView(tok), specs, max_hosts)) {
         return false;
     }
-
-    //-------------------------------------------------------------------------
-    // 处理 CIDR 表示法: a.b.c.d/prefix
-    //-------------------------------------------------------------------------
-    auto slash_pos = tok.find('/');
-    if (slash_pos != std::string::npos) {
-        std::string ip_part = tok.substr(0, slash_pos);
-        std::string pref_part = tok.substr(slash_pos + 1);
-
-        // 解析并验证前缀长度
-        int prefix;
-        if (!parse_int(pref_part.c_str(), prefix) || prefix < 0 || prefix > 32) {
-            fprintf(stderr, "无效的CIDR前缀: %s\n", tok.c_str());
+    for (const auto& spec : specs) {
+        if (spec.kind == TARGET_HOSTNAME) {
+            fprintf(stderr, "无效的IP或目标格式: %s\n", tok.c_str());
             return false;
         }
+        expand_target_spec(spec, out);
+    }
+    return true;
+}
 
-        // 验证 IP 地址部分
-        in_addr addr;
-        if (InetPtonA(AF_INET, ip_part.c_str(), &addr) != 1) {
-            fprintf(stderr, "CIDR中的无效IP: %s\n", ip_part.c_str());
+/**
+ * @brief 将 IPv4 目标参数解析为地址区间，不展开为地址列表
+ *
+ * @param tok 目标参数
+ * @param[out] out 追加的地址区间
+ * @return 解析成功返回 true，失败返回 false 并输出错误信息
+ */
+bool parse_ipv4_ranges(TextView tok, std::vector<Ipv4Range>& out) {
+    std::vector<TargetSpec> specs;
+    if (!tokenize_targets(tok, specs, UINT64_MAX)) {
+        return false;
+    }
+    for (const auto& spec : specs) {
+        if (spec.kind != TARGET_IPV4_RANGE) {
+            fprintf(stderr, "抽样模式仅支持IPv4目标: %.*s\n", (int)spec.text.size, spec.text.data);
             return false;
         }
-        uint32_t ip = ntohl(addr.S_un.S_addr);
-
-        // /32 表示单个主机
-        if (prefix == 32) {
-            out.push_back(ip_part);
-            return true;
-        }
-
-        // 计算网络掩码、网络地址和广播地址
-        uint32_t mask = (prefix == 0) ? 0 : (~0u << (32 - prefix));
-        uint32_t network = ip & mask;           // 网络地址
-        uint32_t broadcast = network | (~mask); // 广播地址
-
-        // 确定可用主机范围
-        uint32_t start, end;
-        if (prefix >= 31) {
-            // /31 点对点链路，没有网络/广播地址概念
-            start = network;
-            end = broadcast;
+        uint64_t count = (uint64_t)spec.last - spec.first + 1;
+        if (!out.empty() && out.back().first + out.back().count == spec.first) {
+            out.back().count += count;
         } else {
-            // 排除网络地址（第一个）和广播地址（最后一个）
-            start = network + 1;
-            end = broadcast - 1;
-        }
-
-        // 枚举所有主机地址
-        unsigned int added = 0;
-        for (uint32_t cur = start; cur <= end && added < max_hosts; ++cur, ++added) {
-            out.push_back(ip_to_string(cur));
+            Ipv4Range r;
+            r.first = spec.first;
+            r.count = count;
+            out.push_back(r);
         }
-        return true;
     }
+    return true;
+}
 
-    //-------------------------------------------------------------------------
-    // 处理范围表示法（但不处理包含逗号的格式，那由后面的代码处理）
-    //-------------------------------------------------------------------------
-    auto dashpos = tok.find('-');
-    if (dashpos != std::string::npos && tok.find(',') == std::string::npos) {
-        auto parts = split(tok, '.');
-
-        //---------------------------------------------------------------------
-        // 格式: a.b.c.d-e（最后一段范围）
-        //---------------------------------------------------------------------
-        if (parts.size() == 4) {
-            const std::string& last = parts[3];
-            auto dashpos2 = last.find('-');
-
-            if (dashpos2 != std::string::npos) {
-                // 解析范围的起始和结束值
-                std::string left = last.substr(0, dashpos2);
-                std::string right = last.substr(dashpos2 + 1);
-                int d_start, d_end;
-
-                if (!parse_int(left.c_str(), d_start) ||
-                    !parse_int(right.c_str(), d_end) ||
-                    d_start < 0 || d_start > 255 ||
-                    d_end < 0 || d_end > 255) {
-                    fprintf(stderr, "最后一段范围无效: %s\n", tok.c_str());
-                    return false;
-                }
-
-                // 确保 start <= end
-                if (d_start > d_end) {
-                    std::swap(d_start, d_end);
-                }
-
-                // 解析前三个八位组
-                int a, b, c;
-                if (!parse_int(parts[0].c_str(), a) ||
-                    !parse_int(parts[1].c_str(), b) ||
-                    !parse_int(parts[2].c_str(), c) ||
-                    a < 0 || a > 255 ||
-                    b < 0 || b > 255 ||
-                    c < 0 || c > 255) {
-                    fprintf(stderr, "IP八位组无效: %s\n", tok.c_str());
-                    return false;
-                }
-
-                // 枚举范围内的所有 IP
-                unsigned int added = 0;
-                for (int d = d_start; d <= d_end && added < max_hosts; ++d, ++added) {
-                    char buf[16];
-                    snprintf(buf, sizeof(buf), "%d.%d.%d.%d", a, b, c, d);
-                    out.push_back(buf);
-                }
-                return true;
-            }
-        }
-        //---------------------------------------------------------------------
-        // 格式: a.b.c-e（第三段范围，第四段枚举 1-254）
-        //---------------------------------------------------------------------
-        else if (parts.size() == 3) {
-            auto dash = parts[2].find('-');
-
-            if (dash != std::string::npos) {
-                // 解析第三段的范围
-                std::string left = parts[2].substr(0, dash);
-                std::string right = parts[2].substr(dash + 1);
-                int c_start, c_end;
-
-                if (!parse_int(left.c_str(), c_start) ||
-                    !parse_int(right.c_str(), c_end) ||
-                    c_start < 0 || c_start > 255 ||
-                    c_end < 0 || c_end > 255) {
-                    fprintf(stderr, "第三段范围无效: %s\n", tok.c_str());
-                    return false;
-                }
-
-                // 确保 start <= end
-                if (c_start > c_end) {
-                    std::swap(c_start, c_end);
-                }
-
-                // 解析前两个八位组
-                int oct1, oct2;
-                if (!parse_int(parts[0].c_str(), oct1) ||
-                    !parse_int(parts[1].c_str(), oct2) ||
-                    oct1 < 0 || oct1 > 255 ||
-                    oct2 < 0 || oct2 > 255) {
-                    fprintf(stderr, "IP八位组无效: %s\n", tok.c_str());
-                    return false;
-                }
-
-                // 枚举所有子网的可用主机（1-254，排除 0 和 255）
-                unsigned int added = 0;
-                for (int c = c_start; c <= c_end && added < max_hosts; ++c) {
-                    for (int d = 1; d <= 254 && added < max_hosts; ++d, ++added) {
-                        char buf[16];
-                        snprintf(buf, sizeof(buf), "%d.%d.%d.%d", oct1, oct2, c, d);
-                        out.push_back(buf);
-                    }
-                }
-                return true;
-            }
-        }
+/**
+ * @brief 从地址区间中扣除排除的地址（已排序去重），区间按需拆分
+ */
+static void subtract_excluded(std::vector<Ipv4Range>& ranges,
+                              const uint32_t* excluded_begin, const uint32_t* excluded_end) {
+    if (excluded_begin == excluded_end) {
+        return;
     }
-
-    //-------------------------------------------------------------------------
-    // 处理逗号分隔的最后一段格式: a.b.c.d1,d2,d3
-    // 例如: 192.168.2.1,3,5 展开为 192.168.2.1, 192.168.2.3, 192.168.2.5
-    //-------------------------------------------------------------------------
-    {
-        auto parts = split(tok, '.');
-        if (parts.size() == 4) {
-            // 检查最后一段是否包含逗号
-            const std::string& last = parts[3];
-            if (last.find(',') != std::string::npos) {
-                // 解析前三个八位组
-                int a, b, c;
-                if (!parse_int(parts[0].c_str(), a) ||
-                    !parse_int(parts[1].c_str(), b) ||
-                    !parse_int(parts[2].c_str(), c) ||
-                    a < 0 || a > 255 ||
-                    b < 0 || b > 255 ||
-                    c < 0 || c > 255) {
-                    fprintf(stderr, "IP八位组无效: %s\n", tok.c_str());
-                    return false;
-                }
-
-                // 解析逗号分隔的最后一段
-                auto d_parts = split(last, ',');
-                unsigned int added = 0;
-
-                for (const auto& d_str : d_parts) {
-                    if (d_str.empty()) continue;
-
-                    // 检查是否是范围格式 (如 1-5)
-                    auto dash_pos = d_str.find('-');
-                    if (dash_pos != std::string::npos) {
-                        // 范围格式: d1-d2
-                        std::string left = d_str.substr(0, dash_pos);
-                        std::string right = d_str.substr(dash_pos + 1);
-                        int d_start, d_end;
-
-                        if (!parse_int(left.c_str(), d_start) ||
-                            !parse_int(right.c_str(), d_end) ||
-                            d_start < 0 || d_start > 255 ||
-                            d_end < 0 || d_end > 255) {
-                            fprintf(stderr, "最后一段范围无效: %s\n", d_str.c_str());
-                            return false;
-                        }
-
-                        if (d_start > d_end) std::swap(d_start, d_end);
-
-                        for (int d = d_start; d <= d_end && added < max_hosts; ++d, ++added) {
-                            char buf[16];
-                            snprintf(buf, sizeof(buf), "%d.%d.%d.%d", a, b, c, d);
-                            out.push_back(buf);
-                        }
-                    } else {
-                        // 单个数字
-                        int d;
-                        if (!parse_int(d_str.c_str(), d) || d < 0 || d > 255) {
-                            fprintf(stderr, "最后一段数值无效: %s\n", d_str.c_str());
-                            return false;
-                        }
-
-                        if (added < max_hosts) {
-                            char buf[16];
-                            snprintf(buf, sizeof(buf), "%d.%d.%d.%d", a, b, c, d);
-                            out.push_back(buf);
-                            ++added;
-                        }
-                    }
-                }
-
-                return true;
+    std::vector<Ipv4Range> result;
+    result.reserve(ranges.size());
+    for (const auto& r : ranges) {
+        uint64_t cur = r.first;
+        uint64_t end = (uint64_t)r.first + r.count;
+        const uint32_t* it = std::lower_bound(excluded_begin, excluded_end, r.first);
+        for (; it != excluded_end && *it < end; ++it) {
+            if (*it > cur) {
+                Ipv4Range part;
+                part.first = (uint32_t)cur;
+                part.count = *it - cur;
+                result.push_back(part);
             }
+            cur = (uint64_t)*it + 1;
+        }
+        if (cur < end) {
+            Ipv4Range part;
+            part.first = (uint32_t)cur;
+            part.count = end - cur;
+            result.push_back(part);
         }
     }
+    ranges.swap(result);
+}
 
-    //-------------------------------------------------------------------------
-    // 处理单个 IPv4 地址
-    //-------------------------------------------------------------------------
-    if (is_valid_ipv4_address(tok)) {
-        out.push_back(tok);
-        return true;
-    }
-
-    // 无法识别的格式
-    fprintf(stderr, "无效的IP或目标格式: %s\n", tok.c_str());
-    return false;
+/**
+ * @brief 从抽样区间中扣除排除列表和排除文件中的地址
+ *
+ * @param[in,out] ranges 地址区间，被扣除的地址处拆分
+ * @param exclude 排除的地址（非 IPv4 的项忽略）
+ * @param exclude_filter 排除文件（未加载时不生效）
+ */
+void subtract_excluded_ranges(std::vector<Ipv4Range>& ranges,
+                              const std::unordered_set<std::string>& exclude,
+                              const ExcludeFilter& exclude_filter) {
+    std::vector<uint32_t> excluded4 = excluded_ipv4(exclude, nullptr);
+    subtract_excluded(ranges, excluded4.data(), excluded4.data() + excluded4.size());
+    subtract_excluded(ranges, exclude_filter.begin(), exclude_filter.end());
 }
 
 //=============================================================================
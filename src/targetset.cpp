@@ -0,0 +1,291 @@
+/**
+ * @file targetset.cpp
+ * @brief 编译目标集模块 - 预先规范化的二进制目标范围
+ * @author mrchzh <gmrchzh@gmail.com>
+ * @version 1.2.0
+ * @date 2026
+ * @copyright MIT License
+ *
+ * 本模块实现了 qping compile-targets 子命令和 --target-set 选项，包括：
+ * - 合并重叠和相邻的区间，扣除排除地址
+ * - 区间与单地址分开存放，附带地址总数、编译时刻和来源描述
+ * - 以内存映射方式只读加载，直接转换为目标描述
+ *
+ * 常用的目标范围（例如“所有机房管理网段减去排除项”）只需编译一次，
+ * 之后每次运行加载百万级地址也只是一次映射，没有文本解析。
+ */
+
+#include "qping.h"
+
+namespace qping {
+
+//=============================================================================
+// 内部辅助函数
+//=============================================================================
+
+/**
+ * @brief 从升序区间中扣除一组升序地址
+ */
+static void subtract_sorted(std::vector<TargetInterval>& ranges,
+                            const uint32_t* excluded_begin, const uint32_t* excluded_end) {
+    if (excluded_begin == excluded_end) {
+        return;
+    }
+    std::vector<TargetInterval> result;
+    result.reserve(ranges.size());
+    const uint32_t* it = excluded_begin;
+    for (const auto& r : ranges) {
+        uint64_t start = r.first;
+        it = std::lower_bound(it, excluded_end, r.first);
+        for (; it != excluded_end && *it <= r.last; ++it) {
+            if (*it > start) {
+                result.push_back({(uint32_t)start, *it - 1});
+            }
+            start = (uint64_t)*it + 1;
+        }
+        if (start <= r.last) {
+            result.push_back({(uint32_t)start, r.last});
+        }
+    }
+    ranges.swap(result);
+}
+
+//=============================================================================
+// 编译
+//=============================================================================
+
+/**
+ * @brief 把 IPv4 目标描述规范化并写入目标集文件
+ *
+ * 区间按起点排序后合并重叠和相邻的部分，再依次扣除 --exclude 和排除
+ * 文件中的地址；只剩一个地址的区间存入单地址数组。写入临时文件后
+ * 替换目标文件。
+ */
+bool compile_target_set(const std::vector<TargetSpec>& specs,
+                        const std::vector<uint32_t>& excluded,
+                        const ExcludeFilter& exclude_filter,
+                        const std::string& source,
+                        const std::string& output,
+                        uint64_t& hosts, uint64_t& bytes) {
+    std::vector<TargetInterval> ranges;
+    ranges.reserve(specs.size());
+    for (const auto& spec : specs) {
+        if (spec.kind != TARGET_IPV4_RANGE) {
+            fprintf(stderr, "目标集仅支持IPv4地址: %.*s\n", (int)spec.text.size, spec.text.data);
+            return false;
+        }
+        ranges.push_back({spec.first, spec.last});
+    }
+
+    std::sort(ranges.begin(), ranges.end(),
+              [](const TargetInterval& a, const TargetInterval& b) { return a.first < b.first; });
+    size_t merged = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        if (merged > 0 && (uint64_t)ranges[i].first <= (uint64_t)ranges[merged - 1].last + 1) {
+            ranges[merged - 1].last = std::max(ranges[merged - 1].last, ranges[i].last);
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
+    ranges.resize(merged);
+
+    subtract_sorted(ranges, excluded.data(), excluded.data() + excluded.size());
+    subtract_sorted(ranges, exclude_filter.begin(), exclude_filter.end());
+
+    std::vector<TargetInterval> intervals;
+    std::vector<uint32_t> singletons;
+    hosts = 0;
+    for (const auto& r : ranges) {
+        if (r.first == r.last) {
+            singletons.push_back(r.first);
+        } else {
+            intervals.push_back(r);
+        }
+        hosts += (uint64_t)r.last - r.first + 1;
+    }
+
+    std::string text = source.substr(0, TARGETSET_SOURCE_MAX);
+    TargetSetHeader header = {};
+    header.magic = TARGETSET_MAGIC;
+    header.version = TARGETSET_VERSION;
+    header.host_count = hosts;
+    header.interval_count = intervals.size();
+    header.singleton_count = singletons.size();
+    header.created_ms = PcapWriter::now_ns() / 1000000;
+    header.intervals_offset = sizeof(TargetSetHeader);
+    header.singletons_offset = header.intervals_offset + intervals.size() * sizeof(TargetInterval);
+    header.source_offset = header.singletons_offset + singletons.size() * sizeof(uint32_t);
+    header.source_len = (uint32_t)text.size();
+    bytes = header.source_offset + text.size();
+
+    std::string data((const char*)&header, sizeof(header));
+    data.reserve((size_t)bytes);
+    data.append((const char*)intervals.data(), intervals.size() * sizeof(TargetInterval));
+    data.append((const char*)singletons.data(), singletons.size() * sizeof(uint32_t));
+    data += text;
+    if (!atomic_write_file(output, data)) {
+        fprintf(stderr, "无法写入目标集: %s\n", output.c_str());
+        return false;
+    }
+    return true;
+}
+
+//=============================================================================
+// 加载
+//=============================================================================
+
+/**
+ * @brief 映射目标集文件并校验头部和各段边界
+ */
+bool TargetSet::open(const std::string& path) {
+    close();
+
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "无法打开目标集: %s\n", path.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart < (LONGLONG)sizeof(TargetSetHeader)) {
+        fprintf(stderr, "目标集过小或无法读取: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+        header_ = (const TargetSetHeader*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    }
+    if (!header_) {
+        fprintf(stderr, "无法映射目标集: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    // 区间表、单点表和来源文本依次紧接，每段的起点必须等于上一段的终点，
+    // 区间表还要 4 字节对齐，映射后才能直接按 uint32 读取
+    const TargetSetHeader& h = *header_;
+    uint64_t file_size = (uint64_t)size.QuadPart;
+    bool valid = h.magic == TARGETSET_MAGIC && h.version == TARGETSET_VERSION &&
+                 h.intervals_offset >= sizeof(TargetSetHeader) && h.intervals_offset % 4 == 0 &&
+                 section_in_file(h.intervals_offset, h.interval_count, sizeof(TargetInterval), file_size) &&
+                 h.singletons_offset == h.intervals_offset + h.interval_count * sizeof(TargetInterval) &&
+                 section_in_file(h.singletons_offset, h.singleton_count, sizeof(uint32_t), file_size) &&
+                 h.source_offset == h.singletons_offset + h.singleton_count * sizeof(uint32_t) &&
+                 section_in_file(h.source_offset, h.source_len, 1, file_size);
+
+    const char* base = (const char*)header_;
+    if (valid) {
+        intervals_ = (const TargetInterval*)(base + h.intervals_offset);
+        singletons_ = (const uint32_t*)(base + h.singletons_offset);
+        valid = check_order();
+    }
+    if (!valid) {
+        fprintf(stderr, "目标集格式无效: %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    source_ = TextView(base + h.source_offset, h.source_len);
+    return true;
+}
+
+/**
+ * @brief 校验区间和单地址数组的有序性
+ *
+ * 区间至少包含两个地址，两个数组各自严格升序且互不重叠，地址总数与
+ * 头部一致。展开目标表时按区间长度分配内存，一个首尾颠倒的区间就会
+ * 变成约 2^32 个地址，因此加载时逐项检查而不是信任编译器的输出。
+ */
+bool TargetSet::check_order() const {
+    const size_t ni = (size_t)header_->interval_count, ns = (size_t)header_->singleton_count;
+    uint64_t hosts = 0;
+    for (size_t i = 0; i < ni; ++i) {
+        if (intervals_[i].first >= intervals_[i].last ||
+            (i > 0 && intervals_[i].first <= intervals_[i - 1].last)) {
+            return false;
+        }
+        hosts += (uint64_t)intervals_[i].last - intervals_[i].first + 1;
+    }
+    for (size_t s = 0; s < ns; ++s) {
+        if (s > 0 && singletons_[s] <= singletons_[s - 1]) {
+            return false;
+        }
+    }
+    // 单地址不能落在任何区间内
+    size_t i = 0;
+    for (size_t s = 0; s < ns; ++s) {
+        while (i < ni && intervals_[i].last < singletons_[s]) {
+            i++;
+        }
+        if (i < ni && intervals_[i].first <= singletons_[s]) {
+            return false;
+        }
+    }
+    return hosts + ns == header_->host_count;
+}
+
+/**
+ * @brief 解除映射并关闭文件
+ */
+void TargetSet::close() {
+    if (header_) {
+        UnmapViewOfFile(header_);
+        header_ = nullptr;
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+        mapping_ = nullptr;
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    intervals_ = nullptr;
+    singletons_ = nullptr;
+    source_ = TextView();
+}
+
+/**
+ * @brief 按地址升序追加目标描述
+ *
+ * 区间数组和单地址数组各自有序，归并后目标表与编译前展开的顺序一致。
+ */
+void TargetSet::append_specs(std::vector<TargetSpec>& out) const {
+    if (!header_) {
+        return;
+    }
+    size_t i = 0, s = 0;
+    const size_t ni = (size_t)header_->interval_count, ns = (size_t)header_->singleton_count;
+    out.reserve(out.size() + ni + ns);
+    while (i < ni || s < ns) {
+        TargetSpec spec;
+        if (s >= ns || (i < ni && intervals_[i].first < singletons_[s])) {
+            spec.first = intervals_[i].first;
+            spec.last = intervals_[i].last;
+            i++;
+        } else {
+            spec.first = spec.last = singletons_[s++];
+        }
+        out.push_back(spec);
+    }
+}
+
+/**
+ * @brief 按地址升序追加抽样区间
+ */
+void TargetSet::append_ranges(std::vector<Ipv4Range>& out) const {
+    std::vector<TargetSpec> specs;
+    append_specs(specs);
+    out.reserve(out.size() + specs.size());
+    for (const auto& spec : specs) {
+        Ipv4Range r;
+        r.first = spec.first;
+        r.count = (uint64_t)spec.last - spec.first + 1;
+        out.push_back(r);
+    }
+}
+
+} // namespace qping